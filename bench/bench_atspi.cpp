@@ -0,0 +1,299 @@
+// bench/bench_atspi.cpp
+//
+// Capture and replace through AccessibilityHelper against bench_atspi_app,
+// for documents from 1 KB to 10 MB, with and without a selection. Needs an
+// AT-SPI bus and a display; bench/run_atspi_bench.sh provides private ones:
+//
+//   bench/run_atspi_bench.sh build/bench --output atspi.json
+//
+// For every case it reports capture and replace latency (min/median/max over
+// --repeat runs) and, when built with libdbus and dbus-monitor is installed,
+// the number of D-Bus method calls each operation made on the AT-SPI bus,
+// and per focus change. The results are written as JSON.
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QProcess>
+#include <QTextStream>
+#include <QTimer>
+#include <QVector>
+
+#include <algorithm>
+
+#include <atspi/atspi.h>
+#ifdef HAVE_DBUS1
+#include <dbus/dbus.h>
+#endif
+
+#include "AccessibilityHelper.h"
+
+namespace {
+
+void spin(int ms)
+{
+    QEventLoop loop;
+    QTimer::singleShot(ms, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+// The test application, one command line and one answer line at a time.
+class TestApp
+{
+public:
+    bool start(const QString& program)
+    {
+        m_proc.setProgram(program);
+        m_proc.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        m_proc.start();
+        return m_proc.waitForStarted() && readLine(30000).startsWith(QLatin1String("ready"));
+    }
+    QString command(const QString& cmd, int timeoutMs = 120000)
+    {
+        m_proc.write(cmd.toLatin1() + '\n');
+        return readLine(timeoutMs);
+    }
+    void stop()
+    {
+        command(QStringLiteral("quit"), 2000);
+        if (!m_proc.waitForFinished(2000))
+            m_proc.kill();
+    }
+
+private:
+    QString readLine(int timeoutMs)
+    {
+        const QDeadlineTimer deadline(timeoutMs);
+        while (!m_proc.canReadLine()) {
+            if (deadline.hasExpired() || !m_proc.waitForReadyRead(int(deadline.remainingTime())))
+                return QString();
+        }
+        return QString::fromLatin1(m_proc.readLine()).trimmed();
+    }
+    QProcess m_proc;
+};
+
+// Counts method calls made by this process on the AT-SPI bus, from the
+// output of `dbus-monitor --profile`. Each one is a blocking round trip.
+class CallCounter
+{
+public:
+    bool start()
+    {
+#ifdef HAVE_DBUS1
+        const QByteArray address = qgetenv("AT_SPI_BUS_ADDRESS");
+        DBusConnection* bus = atspi_get_a11y_bus();
+        if (address.isEmpty() || !bus)
+            return false;
+        m_self = QString::fromLatin1(dbus_bus_get_unique_name(bus));
+        m_proc.start(QStringLiteral("dbus-monitor"),
+                     {QStringLiteral("--address"), QString::fromLatin1(address), QStringLiteral("--profile")});
+        if (!m_proc.waitForStarted(3000))
+            return false;
+        spin(300);
+        m_proc.readAll();
+        return m_proc.state() == QProcess::Running;
+#else
+        return false;
+#endif
+    }
+    void stop()
+    {
+        m_proc.kill();
+        m_proc.waitForFinished(1000);
+    }
+
+    // Calls stamped between `from` and shortly after `to` (seconds since
+    // the epoch; the monitor stamps a call when it sees it). Nothing else
+    // runs meanwhile, as the wait lets the monitor catch up.
+    int count(double from, double to)
+    {
+        to += 0.2;
+        spin(250);
+        int n = 0;
+        const QList<QByteArray> lines = m_proc.readAll().split('\n');
+        for (const QByteArray& line : lines) {
+            const QList<QByteArray> f = line.split('\t');
+            if (f.size() < 4 || f[0] != "mc" || QString::fromLatin1(f[3]) != m_self)
+                continue;
+            const double ts = f[1].toDouble();
+            if (ts >= from && ts <= to)
+                ++n;
+        }
+        return n;
+    }
+
+private:
+    QProcess m_proc;
+    QString  m_self;
+};
+
+double now()
+{
+    return QDateTime::currentMSecsSinceEpoch() / 1000.0;
+}
+
+QJsonObject timing(QVector<double> ms)
+{
+    std::sort(ms.begin(), ms.end());
+    if (ms.isEmpty())
+        return {};
+    return {{u"min"_qs, ms.first()}, {u"median"_qs, ms[ms.size() / 2]}, {u"max"_qs, ms.last()}};
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QLoggingCategory::setFilterRules(QStringLiteral("*.debug=false\n*.info=false"));
+
+    QCommandLineParser p;
+    p.addHelpOption();
+    p.addOptions({
+            {QStringLiteral("app"),    QStringLiteral("Test application."), QStringLiteral("path"),
+                                       QCoreApplication::applicationDirPath() + QStringLiteral("/bench_atspi_app")},
+            {QStringLiteral("sizes"),  QStringLiteral("Document sizes in bytes, comma separated."), QStringLiteral("list"),
+                                       QStringLiteral("1024,10240,102400,1048576,10485760")},
+            {QStringLiteral("repeat"), QStringLiteral("Runs per case."), QStringLiteral("n"), QStringLiteral("5")},
+            {QStringLiteral("selection-chars"), QStringLiteral("Size of the selection in the selection case."),
+                                       QStringLiteral("n"), QStringLiteral("1000")},
+            {QStringLiteral("output"), QStringLiteral("JSON file (default: stdout)."), QStringLiteral("file")},
+    });
+    p.process(app);
+
+    const int repeat = qMax(1, p.value(QStringLiteral("repeat")).toInt());
+    const int selChars = qMax(1, p.value(QStringLiteral("selection-chars")).toInt());
+
+    AccessibilityHelper helper;
+    if (!helper.initialize()) {
+        QTextStream(stderr) << "AT-SPI is not available\n";
+        return 1;
+    }
+    TestApp target;
+    if (!target.start(p.value(QStringLiteral("app")))) {
+        QTextStream(stderr) << "cannot start " << p.value(QStringLiteral("app")) << '\n';
+        return 1;
+    }
+
+    // The helper learns the focused element from focus events only.
+    target.command(QStringLiteral("load 16"));
+    bool focused = false;
+    for (int i = 0; i < 50 && !focused; ++i) {
+        target.command(QStringLiteral("refocus"));
+        spin(200);
+        focused = helper.getFocusedElementInfo().isValid;
+    }
+    if (!focused) {
+        QTextStream(stderr) << "no focus event from the test application\n";
+        target.stop();
+        return 1;
+    }
+
+    CallCounter calls;
+    const bool counting = calls.start();
+    if (!counting)
+        QTextStream(stderr) << "D-Bus call counting unavailable (needs libdbus and dbus-monitor)\n";
+
+    // Focus tracking alone: each refocus sends two focus events (button, edit).
+    QJsonValue focusCalls;
+    if (counting) {
+        constexpr int kChanges = 10;
+        const double t0 = now();
+        for (int i = 0; i < kChanges; ++i) {
+            target.command(QStringLiteral("refocus"));
+            spin(100);
+        }
+        focusCalls = double(calls.count(t0, now())) / (2 * kChanges);
+    }
+
+    QJsonArray results;
+    for (const QString& sizeText : p.value(QStringLiteral("sizes")).split(QLatin1Char(','))) {
+        const qint64 size = sizeText.toLongLong();
+        if (size <= 0)
+            continue;
+        for (const bool selection : {false, true}) {
+            QVector<double> captureMs, replaceMs;
+            int captureCalls = -1, replaceCalls = -1;
+            qsizetype captured = 0;
+            bool ok = true;
+
+            for (int run = 0; run < repeat && ok; ++run) {
+                target.command(QStringLiteral("load %1").arg(size));
+                if (selection) {
+                    const qint64 start = qMax<qint64>(0, size / 2 - selChars / 2);
+                    target.command(QStringLiteral("select %1 %2").arg(start).arg(qMin(size, start + selChars)));
+                } else {
+                    target.command(QStringLiteral("noselect"));
+                }
+                spin(50);
+                const bool countThis = counting && run == 0;
+
+                double t0 = now();
+                QElapsedTimer t;
+                t.start();
+                const ElementInfo info = helper.getFocusedElementInfo();
+                captureMs << t.nsecsElapsed() / 1e6;
+                if (countThis)
+                    captureCalls = calls.count(t0, now());
+                if (!info.isValid || info.wasSelection != selection) {
+                    ok = false;
+                    break;
+                }
+                captured = info.text.size();
+
+                const QString replacement = info.text.toUpper();
+                t0 = now();
+                t.restart();
+                ok = helper.replaceTextInElement(info, replacement);
+                replaceMs << t.nsecsElapsed() / 1e6;
+                if (countThis)
+                    replaceCalls = calls.count(t0, now());
+            }
+
+            QJsonObject r{
+                    {u"size_bytes"_qs,   size},
+                    {u"selection"_qs,    selection},
+                    {u"captured_chars"_qs, qint64(captured)},
+                    {u"capture_ms"_qs,   timing(captureMs)},
+                    {u"replace_ms"_qs,   timing(replaceMs)},
+                    {u"ok"_qs,           ok},
+            };
+            r.insert(u"capture_round_trips"_qs, captureCalls >= 0 ? QJsonValue(captureCalls) : QJsonValue());
+            r.insert(u"replace_round_trips"_qs, replaceCalls >= 0 ? QJsonValue(replaceCalls) : QJsonValue());
+            results.append(r);
+            QTextStream(stderr) << size << " bytes, " << (selection ? "selection" : "whole text")
+                                << (ok ? "" : "  FAILED") << '\n';
+        }
+    }
+    calls.stop();
+    target.stop();
+
+    const QJsonObject doc{
+            {u"benchmark"_qs, u"atspi"_qs},
+            {u"platform"_qs,  QString::fromLocal8Bit(qgetenv("QT_QPA_PLATFORM"))},
+            {u"repeat"_qs,    repeat},
+            {u"focus_change_round_trips"_qs, focusCalls},
+            {u"results"_qs,   results},
+    };
+    const QByteArray json = QJsonDocument(doc).toJson();
+    if (p.isSet(QStringLiteral("output"))) {
+        QFile f(p.value(QStringLiteral("output")));
+        if (!f.open(QIODevice::WriteOnly)) {
+            QTextStream(stderr) << "cannot write " << f.fileName() << '\n';
+            return 1;
+        }
+        f.write(json);
+    } else {
+        QTextStream(stdout) << json;
+    }
+    return 0;
+}
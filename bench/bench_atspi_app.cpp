@@ -0,0 +1,115 @@
+// bench/bench_atspi_app.cpp
+//
+// Test application for bench_atspi: one accessible QTextEdit, driven by
+// line commands on stdin. Every command is answered with one line.
+// An optional argument sets the application name (for telling several
+// instances apart over AT-SPI).
+//
+//   load <bytes>       replace the document with generated ASCII text
+//   select <s> <e>     select characters [s, e)
+//   noselect           clear the selection
+//   length             report the document length in characters
+//   refocus            move focus away and back (sends a focus event)
+//   quit
+
+#include <QApplication>
+#include <QPushButton>
+#include <QSocketNotifier>
+#include <QTextCursor>
+#include <QTextEdit>
+#include <QTextStream>
+#include <QVBoxLayout>
+#include <QWidget>
+
+#include <cstdio>
+
+namespace {
+
+QString generate(qsizetype bytes)
+{
+    static const char* const words[] = {
+            "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "while",
+            "accessible", "editor", "reports", "every", "change", "to", "bus" };
+    QString out;
+    out.reserve(bytes + 16);
+    quint32 seed = 12345;
+    int column = 0;
+    while (out.size() < bytes) {
+        seed = seed * 1103515245u + 12345u;
+        const QLatin1String w(words[(seed >> 16) % (sizeof(words) / sizeof(*words))]);
+        out += w;
+        column += int(w.size()) + 1;
+        if (column > 72) {
+            out += QLatin1Char('\n');
+            column = 0;
+        } else {
+            out += QLatin1Char(' ');
+        }
+    }
+    out.truncate(bytes);
+    return out;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QApplication app(argc, argv);
+    const QStringList args = QApplication::arguments();
+    QApplication::setApplicationName(args.size() > 1 ? args[1] : QStringLiteral("bench_atspi_app"));
+
+    QWidget window;
+    auto* layout = new QVBoxLayout(&window);
+    auto* button = new QPushButton(QStringLiteral("Elsewhere"), &window);
+    auto* edit = new QTextEdit(&window);
+    edit->setAcceptRichText(false);
+    layout->addWidget(button);
+    layout->addWidget(edit);
+    window.resize(640, 480);
+    window.show();
+    window.activateWindow();
+    edit->setFocus();
+
+    QTextStream out(stdout);
+    auto reply = [&out](const QString& line) { out << line << Qt::endl; };
+
+    QSocketNotifier input(fileno(stdin), QSocketNotifier::Read);
+    QObject::connect(&input, &QSocketNotifier::activated, &app, [&] {
+        char buf[256];
+        if (!fgets(buf, sizeof buf, stdin)) {
+            app.quit();
+            return;
+        }
+        const QStringList cmd = QString::fromLatin1(buf).simplified().split(QLatin1Char(' '));
+        const QString& name = cmd.first();
+        if (name == QLatin1String("load") && cmd.size() == 2) {
+            edit->setPlainText(generate(cmd[1].toLongLong()));
+            edit->moveCursor(QTextCursor::Start);
+            reply(QStringLiteral("loaded %1").arg(edit->document()->characterCount() - 1));
+        } else if (name == QLatin1String("select") && cmd.size() == 3) {
+            QTextCursor c(edit->document());
+            c.setPosition(cmd[1].toInt());
+            c.setPosition(cmd[2].toInt(), QTextCursor::KeepAnchor);
+            edit->setTextCursor(c);
+            reply(QStringLiteral("selected %1").arg(c.selectedText().size()));
+        } else if (name == QLatin1String("noselect")) {
+            edit->moveCursor(QTextCursor::Start);
+            reply(QStringLiteral("ok"));
+        } else if (name == QLatin1String("length")) {
+            reply(QStringLiteral("length %1").arg(edit->document()->characterCount() - 1));
+        } else if (name == QLatin1String("refocus")) {
+            window.activateWindow();
+            button->setFocus();
+            edit->setFocus();
+            reply(QStringLiteral("ok"));
+        } else if (name == QLatin1String("quit")) {
+            reply(QStringLiteral("bye"));
+            app.quit();
+        } else {
+            reply(QStringLiteral("error unknown command"));
+        }
+    });
+
+    reply(QStringLiteral("ready"));
+    return app.exec();
+}
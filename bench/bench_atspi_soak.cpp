@@ -0,0 +1,216 @@
+// bench/bench_atspi_soak.cpp
+//
+// Memory of a long session: AccessibilityHelper follows focus through a
+// pool of bench_atspi_app instances that keep being closed and restarted,
+// capturing and replacing text in each, for a simulated working day. Time
+// is compressed (--minute-ms), and the cache policy's sweep and idle times
+// with it. The RSS of this process, which plays the Knowbridge daemon, is
+// sampled every simulated hour.
+//
+//   KB_BENCH=bench_atspi_soak bench/run_atspi_bench.sh build/bench --hours 8
+//   KB_BENCH=bench_atspi_soak bench/run_atspi_bench.sh build/bench --no-cache-policy
+//
+// Prints JSON: one sample per hour with RSS and tracked applications.
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QProcess>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <QTimer>
+#include <QVector>
+
+#include <memory>
+
+#include "AccessibilityHelper.h"
+
+namespace {
+
+void spin(int ms)
+{
+    QEventLoop loop;
+    QTimer::singleShot(ms, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+qint64 rssKb()
+{
+    QFile f(QStringLiteral("/proc/self/status"));
+    if (!f.open(QIODevice::ReadOnly))
+        return -1;
+    for (const QByteArray& line : f.readAll().split('\n'))
+        if (line.startsWith("VmRSS:"))
+            return line.mid(6).trimmed().split(' ').first().toLongLong();
+    return -1;
+}
+
+// One instance of the test application (see bench_atspi_app.cpp).
+class App
+{
+public:
+    App(const QString& program, const QString& name) : m_name(name)
+    {
+        m_proc.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        m_proc.start(program, {name});
+        m_ok = m_proc.waitForStarted() && readLine(30000).startsWith(QLatin1String("ready"));
+    }
+    ~App()
+    {
+        command(QStringLiteral("quit"), 2000);
+        if (!m_proc.waitForFinished(2000))
+            m_proc.kill();
+    }
+    bool ok() const { return m_ok; }
+    const QString& name() const { return m_name; }
+    QString command(const QString& cmd, int timeoutMs = 30000)
+    {
+        m_proc.write(cmd.toLatin1() + '\n');
+        return readLine(timeoutMs);
+    }
+
+private:
+    QString readLine(int timeoutMs)
+    {
+        const QDeadlineTimer deadline(timeoutMs);
+        while (!m_proc.canReadLine()) {
+            if (deadline.hasExpired() || !m_proc.waitForReadyRead(int(deadline.remainingTime())))
+                return QString();
+        }
+        return QString::fromLatin1(m_proc.readLine()).trimmed();
+    }
+    QProcess m_proc;
+    QString  m_name;
+    bool     m_ok = false;
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QLoggingCategory::setFilterRules(QStringLiteral("*.debug=false\n*.info=false"));
+
+    QCommandLineParser p;
+    p.addHelpOption();
+    p.addOptions({
+            {QStringLiteral("app"),        QStringLiteral("Test application."), QStringLiteral("path"),
+                                           QCoreApplication::applicationDirPath() + QStringLiteral("/bench_atspi_app")},
+            {QStringLiteral("hours"),      QStringLiteral("Simulated hours."), QStringLiteral("n"), QStringLiteral("8")},
+            {QStringLiteral("minute-ms"),  QStringLiteral("Real milliseconds per simulated minute."), QStringLiteral("ms"), QStringLiteral("100")},
+            {QStringLiteral("edits"),      QStringLiteral("Edits per simulated hour."), QStringLiteral("n"), QStringLiteral("30")},
+            {QStringLiteral("apps"),       QStringLiteral("Applications open at once."), QStringLiteral("n"), QStringLiteral("6")},
+            {QStringLiteral("restart"),    QStringLiteral("Chance that an edit goes to a freshly started app."), QStringLiteral("p"), QStringLiteral("0.2")},
+            {QStringLiteral("doc-bytes"),  QStringLiteral("Document size in each app."), QStringLiteral("n"), QStringLiteral("20000")},
+            {QStringLiteral("no-cache-policy"), QStringLiteral("Leave libatspi caching as it is.")},
+            {QStringLiteral("output"),     QStringLiteral("JSON file (default: stdout)."), QStringLiteral("file")},
+    });
+    p.process(app);
+
+    const int hours    = qMax(1, p.value(QStringLiteral("hours")).toInt());
+    const int minuteMs = qMax(1, p.value(QStringLiteral("minute-ms")).toInt());
+    const int edits    = qMax(1, p.value(QStringLiteral("edits")).toInt());
+    const int slots    = qMax(1, p.value(QStringLiteral("apps")).toInt());
+    const double restart = p.value(QStringLiteral("restart")).toDouble();
+    const QString program = p.value(QStringLiteral("app"));
+    const bool policy = !p.isSet(QStringLiteral("no-cache-policy"));
+
+    AccessibilityHelper helper;
+    AccessibilityHelper::CachePolicy cp;
+    if (policy) {
+        cp.sweepMs = minuteMs / 2;          // every 30 simulated seconds
+        cp.idleMs  = 10 * minuteMs;
+    } else {
+        cp.restrictMask = false;
+        cp.sweepMs = 0;
+    }
+    helper.setCachePolicy(cp);
+    if (!helper.initialize()) {
+        QTextStream(stderr) << "AT-SPI is not available\n";
+        return 1;
+    }
+
+    QRandomGenerator rng(42);
+    std::vector<std::unique_ptr<App>> pool(size_t(slots));
+    int started = 0, done = 0, failed = 0;
+    auto launch = [&](size_t slot) {
+        pool[slot] = std::make_unique<App>(program, QStringLiteral("soak_app_%1").arg(++started));
+        if (pool[slot]->ok())
+            pool[slot]->command(QStringLiteral("load %1").arg(p.value(QStringLiteral("doc-bytes"))));
+    };
+
+    QJsonArray samples;
+    auto sample = [&](int hour) {
+        samples.append(QJsonObject{
+                {u"hour"_qs,        hour},
+                {u"rss_kb"_qs,      rssKb()},
+                {u"tracked_apps"_qs, helper.trackedApplications()},
+                {u"apps_started"_qs, started},
+                {u"edits"_qs,       done},
+                {u"failed_edits"_qs, failed},
+        });
+        QTextStream(stderr) << "hour " << hour << ": RSS " << rssKb() << " kB, "
+                            << helper.trackedApplications() << " apps tracked\n";
+    };
+    sample(0);
+
+    const int gapMs = 60 * minuteMs / edits;
+    for (int hour = 1; hour <= hours; ++hour) {
+        for (int e = 0; e < edits; ++e) {
+            const size_t slot = size_t(rng.bounded(slots));
+            if (!pool[slot] || rng.generateDouble() < restart)
+                launch(slot);
+            App& target = *pool[slot];
+
+            QElapsedTimer t;
+            t.start();
+            bool ok = false;
+            if (target.ok()) {
+                // Wait for the focus event of this instance.
+                for (int i = 0; i < 20 && !ok; ++i) {
+                    target.command(QStringLiteral("refocus"));
+                    spin(50);
+                    const ElementInfo info = helper.getFocusedElementInfo();
+                    if (info.isValid && info.appName == target.name()) {
+                        target.command(QStringLiteral("select 100 600"));
+                        const ElementInfo sel = helper.getFocusedElementInfo();
+                        ok = sel.isValid && helper.replaceTextInElement(sel, sel.text.toUpper());
+                        break;
+                    }
+                }
+            }
+            ok ? ++done : ++failed;
+            spin(qMax<int>(0, gapMs - int(t.elapsed())));
+        }
+        sample(hour);
+    }
+    pool.clear();
+    spin(minuteMs);                         // one more sweep after the apps quit
+    sample(hours + 1);
+
+    const QJsonObject doc{
+            {u"benchmark"_qs,    u"atspi_soak"_qs},
+            {u"cache_policy"_qs, policy},
+            {u"hours"_qs,        hours},
+            {u"samples"_qs,      samples},
+    };
+    const QByteArray json = QJsonDocument(doc).toJson();
+    if (p.isSet(QStringLiteral("output"))) {
+        QFile f(p.value(QStringLiteral("output")));
+        if (!f.open(QIODevice::WriteOnly)) {
+            QTextStream(stderr) << "cannot write " << f.fileName() << '\n';
+            return 1;
+        }
+        f.write(json);
+    } else {
+        QTextStream(stdout) << json;
+    }
+    return 0;
+}
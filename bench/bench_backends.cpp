@@ -0,0 +1,138 @@
+// bench/bench_backends.cpp
+//
+// Compares the HTTP path (ApiClient -> local llama-server) with the embedded
+// llama.cpp backend (LlamaClient) on the same GGUF model and the same prompt.
+//
+//   llama-server -m model.gguf --port 8080 &
+//   bench_backends --gguf model.gguf --endpoint http://127.0.0.1:8080/v1/chat/completions
+//
+// Reports time to first chunk and total latency per backend. The first run
+// of each backend is reported separately as the cold run.
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QTextStream>
+#include <QVector>
+
+#include <algorithm>
+
+#include "ApiClient.h"
+#include "LlamaClient.h"
+
+namespace {
+
+struct Sample { qint64 firstChunkMs = -1; qint64 totalMs = -1; bool ok = false; };
+
+Sample runOnce(TextBackend* backend, const QString& text, const QString& prompt)
+{
+    Sample s;
+    QEventLoop loop;
+    QElapsedTimer t;
+    quint64 id = 0;
+
+    auto c1 = QObject::connect(backend, &TextBackend::partialResult, &loop,
+                               [&](quint64 rid, const QString&) {
+                                   if (rid == id && s.firstChunkMs < 0)
+                                       s.firstChunkMs = t.elapsed();
+                               });
+    auto c2 = QObject::connect(backend, &TextBackend::processingFinished, &loop,
+                               [&](quint64 rid, const QString&) {
+                                   if (rid != id) return;
+                                   s.totalMs = t.elapsed();
+                                   s.ok = true;
+                                   loop.quit();
+                               });
+    auto c3 = QObject::connect(backend, &TextBackend::processingError, &loop,
+                               [&](quint64 rid, const QString& err) {
+                                   if (rid != id) return;
+                                   QTextStream(stderr) << "error: " << err << '\n';
+                                   loop.quit();
+                               });
+    t.start();
+    id = backend->processText(text, prompt);
+    loop.exec();
+    QObject::disconnect(c1);
+    QObject::disconnect(c2);
+    QObject::disconnect(c3);
+    if (s.ok && s.firstChunkMs < 0)         // non-streaming path
+        s.firstChunkMs = s.totalMs;
+    return s;
+}
+
+qint64 median(QVector<qint64> v)
+{
+    if (v.isEmpty()) return -1;
+    std::sort(v.begin(), v.end());
+    return v[v.size() / 2];
+}
+
+void report(const QString& label, TextBackend* backend, int runs,
+            const QString& text, const QString& prompt)
+{
+    QTextStream out(stdout);
+    const Sample cold = runOnce(backend, text, prompt);
+    QVector<qint64> first, total;
+    for (int i = 0; i < runs; ++i) {
+        const Sample s = runOnce(backend, text, prompt);
+        if (!s.ok) continue;
+        first << s.firstChunkMs;
+        total << s.totalMs;
+    }
+    out << qSetFieldWidth(10) << Qt::left << label << qSetFieldWidth(0)
+        << " cold " << cold.totalMs << " ms"
+        << " | warm median: first chunk " << median(first) << " ms"
+        << ", total " << median(total) << " ms"
+        << " (" << total.size() << '/' << runs << " ok)\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser p;
+    p.addHelpOption();
+    p.addOptions({
+            {QStringLiteral("gguf"),     QStringLiteral("GGUF model for the embedded backend."), QStringLiteral("path")},
+            {QStringLiteral("endpoint"), QStringLiteral("Chat-completions URL serving the same model."), QStringLiteral("url")},
+            {QStringLiteral("model"),    QStringLiteral("Model name sent to the endpoint."), QStringLiteral("name"), QStringLiteral("local")},
+            {QStringLiteral("api-key"),  QStringLiteral("API key for the endpoint."), QStringLiteral("key"), QStringLiteral("none")},
+            {QStringLiteral("input"),    QStringLiteral("Text file to rewrite (default: built-in sample)."), QStringLiteral("file")},
+            {QStringLiteral("threads"),  QStringLiteral("CPU threads for the embedded backend."), QStringLiteral("n"), QStringLiteral("0")},
+            {QStringLiteral("runs"),     QStringLiteral("Warm runs per backend."), QStringLiteral("n"), QStringLiteral("10")},
+    });
+    p.process(app);
+
+    QString text = QStringLiteral("Their is a few mistake in this sentense, "
+                                  "and it need to be fixed before we sends it.");
+    if (p.isSet(QStringLiteral("input"))) {
+        QFile f(p.value(QStringLiteral("input")));
+        if (!f.open(QIODevice::ReadOnly)) {
+            QTextStream(stderr) << "cannot read " << f.fileName() << '\n';
+            return 1;
+        }
+        text = QString::fromUtf8(f.readAll());
+    }
+    const QString prompt = QStringLiteral("Correct typos, punctuation, grammar and capitalization.");
+    const int runs = qMax(1, p.value(QStringLiteral("runs")).toInt());
+
+    if (p.isSet(QStringLiteral("endpoint"))) {
+        ApiClient http(p.value(QStringLiteral("api-key")), p.value(QStringLiteral("endpoint")),
+                       p.value(QStringLiteral("model")), QString());
+        report(QStringLiteral("http"), &http, runs, text, prompt);
+    }
+    if (p.isSet(QStringLiteral("gguf"))) {
+        if (!LlamaClient::isAvailable()) {
+            QTextStream(stderr) << "built without llama.cpp, skipping embedded backend\n";
+            return 0;
+        }
+        LlamaClient local(p.value(QStringLiteral("gguf")), QString(),
+                          p.value(QStringLiteral("threads")).toInt(), 4096);
+        report(QStringLiteral("embedded"), &local, runs, text, prompt);
+    }
+    return 0;
+}
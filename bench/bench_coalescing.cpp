@@ -0,0 +1,152 @@
+// bench/bench_coalescing.cpp
+//
+// Runs one instruction over many short segments (list items, table cells)
+// in two ways against the same endpoint:
+//   individual  - one request per segment, all sent at once
+//   coalesced   - packed by RequestCoalescer into BatchPrompt requests
+//
+//   python3 bench/mock_server.py --port 8080 &
+//   bench_coalescing --endpoint http://127.0.0.1:8080/v1/chat/completions
+//
+// Reports wall time, requests/s, segments/s and output tokens/s. Tokens are
+// estimated as four characters, the same rule the mock server uses.
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QSet>
+#include <QStringList>
+#include <QTextStream>
+
+#include "ApiClient.h"
+#include "RequestCoalescer.h"
+
+namespace {
+
+struct Result { qint64 ms = 0; int requests = 0; int fallbacks = 0; qint64 outChars = 0; bool ok = false; };
+
+Result runIndividual(ApiClient* api, const QStringList& segments, const QString& prompt)
+{
+    Result r;
+    QEventLoop loop;
+    QSet<quint64> open;
+    auto c1 = QObject::connect(api, &TextBackend::processingFinished, &loop,
+                               [&](quint64 id, const QString& text) {
+                                   if (!open.remove(id)) return;
+                                   r.outChars += text.size();
+                                   if (open.isEmpty()) { r.ok = true; loop.quit(); }
+                               });
+    auto c2 = QObject::connect(api, &TextBackend::processingError, &loop,
+                               [&](quint64 id, const QString& err) {
+                                   if (!open.contains(id)) return;
+                                   QTextStream(stderr) << "error: " << err << '\n';
+                                   loop.quit();
+                               });
+    QElapsedTimer t;
+    t.start();
+    for (const auto& s : segments)
+        open.insert(api->processText(s, prompt));
+    r.requests = segments.size();
+    loop.exec();
+    r.ms = t.elapsed();
+    QObject::disconnect(c1);
+    QObject::disconnect(c2);
+    return r;
+}
+
+Result runCoalesced(ApiClient* api, const QStringList& segments, const QString& prompt,
+                    int maxChars, int maxSegments)
+{
+    Result r;
+    RequestCoalescer coalescer;
+    coalescer.setMaxBatchChars(maxChars);
+    coalescer.setMaxBatchSegments(maxSegments);
+    QEventLoop loop;
+    quint64 job = 0;
+    QObject::connect(&coalescer, &RequestCoalescer::finished, &loop,
+                     [&](quint64 id, const QStringList& results) {
+                         if (id != job) return;
+                         for (const auto& s : results)
+                             r.outChars += s.size();
+                         r.ok = true;
+                         loop.quit();
+                     });
+    QObject::connect(&coalescer, &RequestCoalescer::failed, &loop,
+                     [&](quint64 id, const QString& err) {
+                         if (id != job) return;
+                         QTextStream(stderr) << "error: " << err << '\n';
+                         loop.quit();
+                     });
+    QElapsedTimer t;
+    t.start();
+    job = coalescer.submit(api, segments, prompt);
+    loop.exec();
+    r.ms = t.elapsed();
+    r.requests = coalescer.stats().requests;
+    r.fallbacks = coalescer.stats().fallbacks;
+    return r;
+}
+
+void report(const QString& label, const Result& r, int segments)
+{
+    const double sec = qMax<qint64>(r.ms, 1) / 1000.0;
+    QTextStream(stdout)
+            << qSetFieldWidth(12) << Qt::left << label << qSetFieldWidth(0)
+            << r.ms << " ms | " << r.requests << " requests"
+            << (r.fallbacks ? QStringLiteral(" (%1 fallbacks)").arg(r.fallbacks) : QString())
+            << " | " << QString::number(r.requests / sec, 'f', 1) << " req/s"
+            << ", " << QString::number(segments / sec, 'f', 1) << " segments/s"
+            << ", " << QString::number(r.outChars / 4.0 / sec, 'f', 1) << " tok/s"
+            << (r.ok ? "" : "  FAILED") << '\n';
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser p;
+    p.addHelpOption();
+    p.addOptions({
+            {QStringLiteral("endpoint"),  QStringLiteral("Chat-completions URL."), QStringLiteral("url"),
+                                          QStringLiteral("http://127.0.0.1:8080/v1/chat/completions")},
+            {QStringLiteral("model"),     QStringLiteral("Model name sent to the endpoint."), QStringLiteral("name"), QStringLiteral("local")},
+            {QStringLiteral("api-key"),   QStringLiteral("API key for the endpoint."), QStringLiteral("key"), QStringLiteral("none")},
+            {QStringLiteral("input"),     QStringLiteral("Text file, one segment per line (default: generated)."), QStringLiteral("file")},
+            {QStringLiteral("segments"),  QStringLiteral("Number of generated segments."), QStringLiteral("n"), QStringLiteral("50")},
+            {QStringLiteral("max-chars"), QStringLiteral("Coalescer batch size limit in characters."), QStringLiteral("n"), QStringLiteral("6000")},
+            {QStringLiteral("max-segments"), QStringLiteral("Coalescer batch size limit in segments."), QStringLiteral("n"), QStringLiteral("32")},
+    });
+    p.process(app);
+
+    QStringList segments;
+    if (p.isSet(QStringLiteral("input"))) {
+        QFile f(p.value(QStringLiteral("input")));
+        if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            QTextStream(stderr) << "cannot read " << f.fileName() << '\n';
+            return 1;
+        }
+        for (const auto& line : QString::fromUtf8(f.readAll()).split(QLatin1Char('\n')))
+            if (!line.trimmed().isEmpty())
+                segments << line.trimmed();
+    } else {
+        const int n = qMax(1, p.value(QStringLiteral("segments")).toInt());
+        for (int i = 0; i < n; ++i)
+            segments << QStringLiteral("item %1: teh quick brown fox jump over the lazy dog").arg(i + 1);
+    }
+    const QString prompt = QStringLiteral("Correct typos, punctuation, grammar and capitalization.");
+
+    ApiClient api(p.value(QStringLiteral("api-key")), p.value(QStringLiteral("endpoint")),
+                  p.value(QStringLiteral("model")), QString());
+
+    report(QStringLiteral("individual"), runIndividual(&api, segments, prompt), segments.size());
+    report(QStringLiteral("coalesced"),
+           runCoalesced(&api, segments, prompt,
+                        p.value(QStringLiteral("max-chars")).toInt(),
+                        p.value(QStringLiteral("max-segments")).toInt()),
+           segments.size());
+    return 0;
+}
@@ -0,0 +1,164 @@
+// bench/bench_neardup.cpp
+//
+// Hit rate and accuracy of NearDuplicateCache, plus raw fingerprint scan
+// speed. No backend is involved: the "model" is a paragraph-local transform,
+// so a stitched result can be checked against a full recomputation.
+//
+//   bench_neardup                         # generated corpus
+//   bench_neardup --corpus notes.txt      # documents separated by lines of "==="
+//
+// For every document an edited copy (one word replaced in one paragraph)
+// and an unrelated document are looked up:
+//   hit rate     edited copies that reused at least one paragraph
+//   false hits   unrelated documents that reused anything
+//   accuracy     hits whose stitched output equals the full recomputation
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QStringList>
+#include <QTextStream>
+#include <QVector>
+
+#include "NearDuplicateCache.h"
+#include "Paragraphs.h"
+
+namespace {
+
+QString model(const QString& text)            // stands in for the backend
+{
+    const auto s = Paragraphs::split(text);
+    QStringList out;
+    for (const auto& p : s.parts)
+        out << p.toUpper();
+    return Paragraphs::join(out, s.separators);
+}
+
+QString generatedDocument(QRandomGenerator& rng)
+{
+    static const QStringList words = QStringLiteral(
+            "the a report meeting team project budget draft review client server "
+            "release schedule update change issue fix test plan design note user "
+            "data system quarter result sales market cost risk delay owner week "
+            "monday friday send share check confirm agree propose").split(QLatin1Char(' '));
+    QStringList paragraphs;
+    const int nParagraphs = 2 + int(rng.bounded(6));
+    for (int p = 0; p < nParagraphs; ++p) {
+        QStringList w;
+        const int nWords = 20 + int(rng.bounded(40));
+        for (int i = 0; i < nWords; ++i)
+            w << words[rng.bounded(int(words.size()))];
+        paragraphs << w.join(QLatin1Char(' ')) + QLatin1Char('.');
+    }
+    return paragraphs.join(QStringLiteral("\n\n"));
+}
+
+QString editOneWord(const QString& doc, QRandomGenerator& rng)
+{
+    auto s = Paragraphs::split(doc);
+    const int p = int(rng.bounded(int(s.parts.size())));
+    QStringList w = s.parts[p].split(QLatin1Char(' '));
+    w[rng.bounded(int(w.size()))] = QStringLiteral("edited");
+    s.parts[p] = w.join(QLatin1Char(' '));
+    return Paragraphs::join(s.parts, s.separators);
+}
+
+struct Quality { int hits = 0; int correct = 0; int falseHits = 0; int queries = 0; };
+
+Quality evaluate(const QStringList& docs, const QStringList& unrelated, int maxDistance, quint32 seed)
+{
+    QRandomGenerator rng(seed);
+    NearDuplicateCache cache(int(docs.size()), maxDistance);
+    const quint64 key = NearDuplicateCache::actionKey(QStringLiteral("fix"), QStringLiteral("m"), QString());
+    for (const auto& d : docs)
+        cache.insert(key, d, model(d));
+
+    Quality q;
+    for (int i = 0; i < docs.size(); ++i) {
+        ++q.queries;
+        const QString edited = editOneWord(docs[i], rng);
+        if (const auto plan = cache.plan(key, edited)) {
+            ++q.hits;
+            QStringList fresh;
+            for (int k : plan->missing)
+                fresh << model(plan->parts[k]);
+            if (Paragraphs::stitch(*plan, fresh) == model(edited))
+                ++q.correct;
+        }
+        if (i < unrelated.size() && cache.plan(key, unrelated[i]))
+            ++q.falseHits;
+    }
+    return q;
+}
+
+void scanSpeed(int n)
+{
+    QRandomGenerator rng(7);
+    QVector<quint64> fps(n), keys(n, 1);
+    for (auto& f : fps)
+        f = rng.generate64();
+    const int lookups = qMax(10, 20'000'000 / n);
+    QElapsedTimer t;
+    t.start();
+    int found = 0;
+    for (int i = 0; i < lookups; ++i)
+        found += NearDuplicateCache::nearest(fps.constData(), keys.constData(), n,
+                                             rng.generate64(), 1, 12) >= 0;
+    const double ns = double(t.nsecsElapsed()) / lookups;
+    QTextStream(stdout) << "scan " << qSetFieldWidth(8) << Qt::right << n << qSetFieldWidth(0)
+                        << " fingerprints: " << QString::number(ns / 1000.0, 'f', 2) << " us/lookup, "
+                        << QString::number(n / ns, 'f', 2) << " G fingerprints/s ("
+                        << found << " matches)\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser p;
+    p.addHelpOption();
+    p.addOptions({
+            {QStringLiteral("corpus"), QStringLiteral("Documents separated by lines of \"===\"."), QStringLiteral("file")},
+            {QStringLiteral("docs"),   QStringLiteral("Number of generated documents."), QStringLiteral("n"), QStringLiteral("500")},
+    });
+    p.process(app);
+
+    QRandomGenerator rng(42);
+    QStringList docs;
+    if (p.isSet(QStringLiteral("corpus"))) {
+        QFile f(p.value(QStringLiteral("corpus")));
+        if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            QTextStream(stderr) << "cannot read " << f.fileName() << '\n';
+            return 1;
+        }
+        for (const auto& d : QString::fromUtf8(f.readAll()).split(QStringLiteral("\n===\n")))
+            if (d.trimmed().size() > 40)
+                docs << d.trimmed();
+    } else {
+        const int n = qMax(2, p.value(QStringLiteral("docs")).toInt());
+        for (int i = 0; i < n; ++i)
+            docs << generatedDocument(rng);
+    }
+    // Unrelated queries: the second half against a cache of the first half.
+    const int half = int(docs.size() / 2);
+    const QStringList cached = docs.mid(0, half);
+    const QStringList unrelated = docs.mid(half);
+
+    QTextStream out(stdout);
+    out << cached.size() << " cached documents, " << unrelated.size() << " unrelated\n";
+    for (int d : {4, 8, 12, 16, 20}) {
+        const Quality q = evaluate(cached, unrelated, d, 1);
+        out << "max distance " << qSetFieldWidth(2) << d << qSetFieldWidth(0)
+            << ": hit rate " << QString::number(100.0 * q.hits / q.queries, 'f', 1) << "%"
+            << ", accuracy " << QString::number(q.hits ? 100.0 * q.correct / q.hits : 0.0, 'f', 1) << "%"
+            << ", false hits " << QString::number(100.0 * q.falseHits / qMax(1, int(unrelated.size())), 'f', 1)
+            << "%\n";
+    }
+    for (int n : {1'000, 10'000, 100'000, 1'000'000})
+        scanSpeed(n);
+    return 0;
+}
@@ -0,0 +1,143 @@
+// bench/bench_transport.cpp
+//
+// Client-side cost of the HTTP transport: the same small requests sent to
+// the mock server over loopback TCP (QNetworkAccessManager) and over a Unix
+// domain socket (LocalHttpClient).
+//
+//   python3 bench/mock_server.py --port 8080 --overhead-ms 0 --slots 8 &
+//   python3 bench/mock_server.py --unix /tmp/knowbridge-mock.sock --overhead-ms 0 --slots 8 &
+//   bench_transport --requests 500
+//
+// Reports median and p95 latency and the CPU time this process spent per
+// request (user + system, from getrusage), which is what the transport
+// costs on the client. Run the mock server with --chunked to exercise
+// chunked replies.
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QHash>
+#include <QTextStream>
+#include <QVector>
+
+#include <algorithm>
+#include <sys/resource.h>
+
+#include "ApiClient.h"
+
+namespace {
+
+struct Result { QVector<qint64> latencyUs; qint64 wallMs = 0; double cpuMs = 0; int errors = 0; };
+
+double cpuMsNow()
+{
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000.0
+           + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000.0;
+}
+
+// Keeps `parallel` requests in flight until `total` have been sent.
+Result run(ApiClient* api, int total, int parallel, const QString& text)
+{
+    Result r;
+    QEventLoop loop;
+    QHash<quint64, QElapsedTimer> open;
+    int sent = 0;
+    const QString prompt = QStringLiteral("Echo.");
+
+    auto sendOne = [&] {
+        QElapsedTimer t;
+        t.start();
+        open.insert(api->processText(text, prompt), t);
+        ++sent;
+    };
+    auto done = [&](quint64 id, bool ok) {
+        const auto it = open.find(id);
+        if (it == open.end())
+            return;
+        r.latencyUs << it->nsecsElapsed() / 1000;
+        open.erase(it);
+        if (!ok)
+            ++r.errors;
+        if (sent < total)
+            sendOne();
+        else if (open.isEmpty())
+            loop.quit();
+    };
+    auto c1 = QObject::connect(api, &TextBackend::processingFinished, &loop,
+                               [&](quint64 id, const QString&) { done(id, true); });
+    auto c2 = QObject::connect(api, &TextBackend::processingError, &loop,
+                               [&](quint64 id, const QString& err) {
+                                   if (open.contains(id) && r.errors == 0)
+                                       QTextStream(stderr) << "error: " << err << '\n';
+                                   done(id, false);
+                               });
+
+    const double cpu0 = cpuMsNow();
+    QElapsedTimer wall;
+    wall.start();
+    for (int i = 0; i < qMin(parallel, total); ++i)
+        sendOne();
+    loop.exec();
+    r.wallMs = wall.elapsed();
+    r.cpuMs = cpuMsNow() - cpu0;
+    QObject::disconnect(c1);
+    QObject::disconnect(c2);
+    return r;
+}
+
+void report(const QString& label, Result r)
+{
+    std::sort(r.latencyUs.begin(), r.latencyUs.end());
+    const auto pct = [&](double q) {
+        return r.latencyUs.isEmpty() ? 0 : r.latencyUs[qMin<qsizetype>(r.latencyUs.size() - 1,
+                                                                        qsizetype(q * r.latencyUs.size()))];
+    };
+    const int n = qMax<int>(1, r.latencyUs.size());
+    QTextStream(stdout)
+            << qSetFieldWidth(6) << Qt::left << label << qSetFieldWidth(0)
+            << "median " << QString::number(pct(0.5) / 1000.0, 'f', 3) << " ms"
+            << ", p95 " << QString::number(pct(0.95) / 1000.0, 'f', 3) << " ms"
+            << " | " << QString::number(r.latencyUs.size() * 1000.0 / qMax<qint64>(r.wallMs, 1), 'f', 0) << " req/s"
+            << " | CPU " << QString::number(r.cpuMs * 1000.0 / n, 'f', 0) << " us/request"
+            << (r.errors ? QStringLiteral("  (%1 errors)").arg(r.errors) : QString()) << '\n';
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser p;
+    p.addHelpOption();
+    p.addOptions({
+            {QStringLiteral("tcp"),      QStringLiteral("Loopback TCP endpoint (empty to skip)."), QStringLiteral("url"),
+                                         QStringLiteral("http://127.0.0.1:8080/v1/chat/completions")},
+            {QStringLiteral("unix"),     QStringLiteral("Unix socket endpoint (empty to skip)."), QStringLiteral("url"),
+                                         QStringLiteral("unix:///tmp/knowbridge-mock.sock?path=/v1/chat/completions")},
+            {QStringLiteral("requests"), QStringLiteral("Requests per transport."), QStringLiteral("n"), QStringLiteral("500")},
+            {QStringLiteral("parallel"), QStringLiteral("Requests in flight at once."), QStringLiteral("n"), QStringLiteral("1")},
+            {QStringLiteral("chars"),    QStringLiteral("Size of the echoed text."), QStringLiteral("n"), QStringLiteral("200")},
+            {QStringLiteral("warmup"),   QStringLiteral("Untimed requests before each run."), QStringLiteral("n"), QStringLiteral("20")},
+    });
+    p.process(app);
+
+    const int total    = qMax(1, p.value(QStringLiteral("requests")).toInt());
+    const int parallel = qMax(1, p.value(QStringLiteral("parallel")).toInt());
+    const int warmup   = qMax(0, p.value(QStringLiteral("warmup")).toInt());
+    const QString text = QString(qMax(1, p.value(QStringLiteral("chars")).toInt()), QLatin1Char('x'));
+
+    for (const QString& name : {QStringLiteral("tcp"), QStringLiteral("unix")}) {
+        const QString endpoint = p.value(name);
+        if (endpoint.isEmpty())
+            continue;
+        ApiClient api(QStringLiteral("none"), endpoint, QStringLiteral("mock"), QString());
+        if (warmup > 0)
+            run(&api, warmup, parallel, text);      // connections are open afterwards
+        report(name, run(&api, total, parallel, text));
+    }
+    return 0;
+}
@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+"""Minimal OpenAI-compatible chat-completions server for the benchmarks.
+
+Echoes the text part of the user message back (everything after the last
+blank line, so a BatchPrompt JSON array comes back as a valid array) and
+sleeps for a simple cost model of a real server:
+
+    overhead + prompt_tokens / prefill_rate + completion_tokens / decode_rate
+
+with a token counted as four characters. `--slots` limits how many requests
+are served at the same time, like the parallel slots of llama-server.
+`--unix` listens on a Unix domain socket instead of TCP, `--chunked` sends
+the reply with chunked transfer encoding. Requests with `"stream": true`
+get server-sent events, one token per event, paced by the decode rate.
+
+    python3 bench/mock_server.py --port 8080 --overhead-ms 40
+    python3 bench/mock_server.py --unix /tmp/knowbridge-mock.sock
+"""
+
+import argparse
+import json
+import os
+import socketserver
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+def tokens(text):
+    return max(1, len(text) // 4)
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"       # keep-alive, as QNetworkAccessManager expects
+
+    def do_POST(self):
+        length = int(self.headers.get("Content-Length", 0))
+        try:
+            body = json.loads(self.rfile.read(length))
+        except ValueError:
+            self.send_error(400, "invalid JSON")
+            return
+
+        messages = body.get("messages", [])
+        prompt = "".join(m.get("content", "") for m in messages)
+        user = messages[-1].get("content", "") if messages else ""
+        answer = user.rsplit("\n\n", 1)[-1]
+        max_tokens = body.get("max_tokens")
+        if max_tokens is not None:
+            answer = answer[: max_tokens * 4]
+
+        usage = {"prompt_tokens": tokens(prompt), "completion_tokens": tokens(answer)}
+        usage["total_tokens"] = usage["prompt_tokens"] + usage["completion_tokens"]
+
+        args = self.server.args
+        if body.get("stream"):
+            with self.server.slots:
+                self.stream(body, answer, usage)
+            return
+        with self.server.slots:
+            time.sleep(args.overhead_ms / 1000.0
+                       + usage["prompt_tokens"] / args.prefill_tps
+                       + usage["completion_tokens"] / args.decode_tps)
+
+        payload = json.dumps({
+            "id": "mock",
+            "object": "chat.completion",
+            "model": body.get("model", "mock"),
+            "choices": [{"index": 0,
+                         "message": {"role": "assistant", "content": answer},
+                         "finish_reason": "stop"}],
+            "usage": usage,
+        }).encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        if args.chunked:
+            self.send_header("Transfer-Encoding", "chunked")
+            self.end_headers()
+            step = max(1, len(payload) // 4)
+            for i in range(0, len(payload), step):
+                part = payload[i:i + step]
+                self.wfile.write(b"%x\r\n%s\r\n" % (len(part), part))
+            self.wfile.write(b"0\r\n\r\n")
+        else:
+            self.send_header("Content-Length", str(len(payload)))
+            self.end_headers()
+            self.wfile.write(payload)
+
+    def stream(self, body, answer, usage):
+        args = self.server.args
+        self.send_response(200)
+        self.send_header("Content-Type", "text/event-stream")
+        self.send_header("Transfer-Encoding", "chunked")
+        self.end_headers()
+
+        def event(obj):
+            data = b"data: " + (obj if isinstance(obj, bytes) else json.dumps(obj).encode()) + b"\n\n"
+            self.wfile.write(b"%x\r\n%s\r\n" % (len(data), data))
+            self.wfile.flush()
+
+        def chunk(delta):
+            return {"id": "mock", "object": "chat.completion.chunk",
+                    "model": body.get("model", "mock"),
+                    "choices": [{"index": 0, "delta": delta, "finish_reason": None}]}
+
+        time.sleep(args.overhead_ms / 1000.0 + usage["prompt_tokens"] / args.prefill_tps)
+        event(chunk({"role": "assistant", "content": ""}))
+        for i in range(0, len(answer), 4):
+            event(chunk({"content": answer[i:i + 4]}))
+            time.sleep(1.0 / args.decode_tps)
+        if (body.get("stream_options") or {}).get("include_usage"):
+            event({"id": "mock", "object": "chat.completion.chunk", "choices": [], "usage": usage})
+        event(b"[DONE]")
+        self.wfile.write(b"0\r\n\r\n")
+
+    def address_string(self):
+        # client_address is an empty string on a Unix socket
+        return self.client_address[0] if self.client_address else "unix"
+
+    def log_message(self, fmt, *args):
+        if self.server.args.verbose:
+            super().log_message(fmt, *args)
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    p.add_argument("--host", default="127.0.0.1")
+    p.add_argument("--port", type=int, default=8080)
+    p.add_argument("--overhead-ms", type=float, default=40.0,
+                   help="fixed cost per request (queueing, headers, scheduling)")
+    p.add_argument("--prefill-tps", type=float, default=2000.0,
+                   help="prompt tokens processed per second")
+    p.add_argument("--decode-tps", type=float, default=60.0,
+                   help="completion tokens generated per second")
+    p.add_argument("--slots", type=int, default=1,
+                   help="requests served concurrently")
+    p.add_argument("--unix", metavar="PATH",
+                   help="listen on a Unix domain socket instead of host:port")
+    p.add_argument("--chunked", action="store_true",
+                   help="send replies with chunked transfer encoding")
+    p.add_argument("--verbose", action="store_true")
+    args = p.parse_args()
+
+    if args.unix:
+        if os.path.exists(args.unix):
+            os.unlink(args.unix)
+        server = socketserver.ThreadingUnixStreamServer(args.unix, Handler)
+        server.daemon_threads = True
+        url = f"unix://{args.unix}?path=/v1/chat/completions"
+    else:
+        server = ThreadingHTTPServer((args.host, args.port), Handler)
+        url = f"http://{args.host}:{args.port}/v1/chat/completions"
+    server.args = args
+    server.slots = threading.BoundedSemaphore(args.slots)
+    print(f"mock server on {url}", flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if args.unix:
+            os.unlink(args.unix)
+
+
+if __name__ == "__main__":
+    main()
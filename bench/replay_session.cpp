@@ -0,0 +1,378 @@
+// bench/replay_session.cpp
+//
+// Replays a session recorded with KNOWBRIDGE_RECORD_SESSION=<file> against
+// a stand-in server, through the same request pipeline as the application:
+// a RequestScheduler in front of the client, one request per action,
+// RequestCoalescer for several segments and ActionChain for multi-step
+// actions (both as bulk work). Inputs are synthetic text of the
+// recorded sizes; actions answered locally (spell fast path, cache) are
+// counted but not sent.
+//
+//   bench_replay_session --fit session.jsonl          # timing model only
+//   python3 bench/mock_server.py <flags printed by --fit> &
+//   bench_replay_session session.jsonl --out new.json --baseline old.json
+//
+// Actions start at their recorded times, with idle gaps capped by
+// --max-gap-ms and the whole timeline divided by --speed. Reports action
+// latency (median, p95, mean), actions/s and output tokens/s (completion
+// tokens reported by the server), and the
+// change against a report of an earlier build (--baseline).
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QTimer>
+#include <QVector>
+
+#include <algorithm>
+
+#include "ActionChain.h"
+#include "ApiClient.h"
+#include "RequestCoalescer.h"
+#include "RequestScheduler.h"
+
+namespace {
+
+struct Action {
+    qint64 t = 0;
+    qint64 recordedMs = 0;
+    int    promptChars = 0;
+    int    steps = 1;
+    QVector<int> segments;
+};
+
+struct Recording {
+    QVector<Action> actions;            // sent to the model
+    int local = 0;                      // answered without the model
+    QVector<double> promptTokens, ttft; // for the timing model
+    QVector<double> decodeTps;
+};
+
+bool load(const QString& path, Recording* rec)
+{
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        QTextStream(stderr) << "cannot read " << path << '\n';
+        return false;
+    }
+    while (!f.atEnd()) {
+        const QJsonObject o = QJsonDocument::fromJson(f.readLine()).object();
+        if (o.value(u"type"_qs).toString() != u"action"_qs || !o.value(u"ok"_qs).toBool())
+            continue;
+        if (o.value(u"path"_qs).toString() != u"model"_qs) {
+            ++rec->local;
+            continue;
+        }
+        Action a;
+        a.t           = o.value(u"t"_qs).toInteger();
+        a.recordedMs  = o.value(u"ms"_qs).toInteger();
+        a.promptChars = o.value(u"promptChars"_qs).toInt();
+        a.steps       = qMax(1, o.value(u"steps"_qs).toInt(1));
+        for (const QJsonValue v : o.value(u"segments"_qs).toArray())
+            a.segments << v.toInt();
+        if (a.segments.isEmpty())
+            a.segments << o.value(u"chars"_qs).toInt();
+        rec->actions << a;
+
+        for (const QJsonValue v : o.value(u"requests"_qs).toArray()) {
+            RequestMetrics m;
+            const QJsonObject r = v.toObject();
+            m.promptTokens     = r.value(u"promptTokens"_qs).toInt(-1);
+            m.completionTokens = r.value(u"completionTokens"_qs).toInt(-1);
+            m.ttftMs           = r.value(u"ttftMs"_qs).toInteger(-1);
+            m.totalMs          = r.value(u"totalMs"_qs).toInteger();
+            if (m.promptTokens > 0 && m.ttftMs >= 0) {
+                rec->promptTokens << m.promptTokens;
+                rec->ttft << double(m.ttftMs);
+            }
+            if (const double tps = m.decodeTokensPerSec(); tps > 0)
+                rec->decodeTps << tps;
+        }
+    }
+    std::sort(rec->actions.begin(), rec->actions.end(),
+              [](const Action& a, const Action& b) { return a.t < b.t; });
+    return true;
+}
+
+// ttft = overhead + promptTokens / prefill (least squares), decode = median.
+void printTimingModel(const Recording& rec)
+{
+    const int n = int(rec.ttft.size());
+    double overheadMs = 40, prefillTps = 2000, decodeTps = 60;
+    if (n >= 2) {
+        double sx = 0, sy = 0, sxx = 0, sxy = 0;
+        for (int i = 0; i < n; ++i) {
+            sx += rec.promptTokens[i]; sy += rec.ttft[i];
+            sxx += rec.promptTokens[i] * rec.promptTokens[i];
+            sxy += rec.promptTokens[i] * rec.ttft[i];
+        }
+        const double den = n * sxx - sx * sx;
+        const double slope = den > 0 ? (n * sxy - sx * sy) / den : 0;   // ms per token
+        overheadMs = qMax(0.0, (sy - slope * sx) / n);
+        if (slope > 0)
+            prefillTps = 1000.0 / slope;
+    }
+    if (!rec.decodeTps.isEmpty()) {
+        QVector<double> v = rec.decodeTps;
+        std::sort(v.begin(), v.end());
+        decodeTps = v[v.size() / 2];
+    }
+    QTextStream(stdout)
+            << "timing model from " << n << " requests: overhead "
+            << QString::number(overheadMs, 'f', 0) << " ms, prefill "
+            << QString::number(prefillTps, 'f', 0) << " tok/s, decode "
+            << QString::number(decodeTps, 'f', 1) << " tok/s\n"
+            << "  python3 bench/mock_server.py --overhead-ms " << QString::number(overheadMs, 'f', 0)
+            << " --prefill-tps " << QString::number(prefillTps, 'f', 0)
+            << " --decode-tps " << QString::number(decodeTps, 'f', 1) << '\n';
+}
+
+// Words and sentences of about the shape of prose, exactly `chars` long.
+QString synthetic(int chars, int seed)
+{
+    static const QStringList words = {
+            QStringLiteral("the"), QStringLiteral("report"), QStringLiteral("shows"),
+            QStringLiteral("that"), QStringLiteral("our"), QStringLiteral("team"),
+            QStringLiteral("delivered"), QStringLiteral("most"), QStringLiteral("of"),
+            QStringLiteral("planned"), QStringLiteral("work"), QStringLiteral("on"),
+            QStringLiteral("time"), QStringLiteral("although"), QStringLiteral("several"),
+            QStringLiteral("reviews"), QStringLiteral("took"), QStringLiteral("longer"),
+    };
+    QString out;
+    out.reserve(chars + 16);
+    quint32 x = 2654435761u * quint32(seed + 1);
+    int inSentence = 0;
+    while (out.size() < chars) {
+        x = x * 1664525u + 1013904223u;
+        out += words[int((x >> 16) % words.size())];
+        if (++inSentence >= 12) {
+            out += QLatin1Char('.');
+            inSentence = 0;
+        }
+        out += QLatin1Char(' ');
+    }
+    out.truncate(chars);
+    return out;
+}
+
+struct Report {
+    int    actions = 0;
+    int    errors = 0;
+    qint64 wallMs = 0;
+    qint64 outTokens = 0;           // completion tokens, from the usage reports
+    QVector<qint64> latencyMs;
+    QVector<qint64> recordedMs;
+
+    static qint64 pct(QVector<qint64> v, double p)
+    {
+        if (v.isEmpty())
+            return 0;
+        std::sort(v.begin(), v.end());
+        return v[qMin(int(v.size()) - 1, int(v.size() * p))];
+    }
+    static double mean(const QVector<qint64>& v)
+    {
+        double s = 0;
+        for (qint64 x : v)
+            s += x;
+        return v.isEmpty() ? 0 : s / v.size();
+    }
+    QJsonObject toJson() const
+    {
+        const double sec = qMax<qint64>(wallMs, 1) / 1000.0;
+        return {
+                {u"actions"_qs,       actions},
+                {u"errors"_qs,        errors},
+                {u"wallMs"_qs,        wallMs},
+                {u"medianMs"_qs,      pct(latencyMs, 0.5)},
+                {u"p95Ms"_qs,         pct(latencyMs, 0.95)},
+                {u"meanMs"_qs,        mean(latencyMs)},
+                {u"actionsPerSec"_qs, latencyMs.size() / sec},
+                {u"tokensPerSec"_qs,  outTokens / sec},
+                {u"recordedMedianMs"_qs, pct(recordedMs, 0.5)},
+                {u"recordedP95Ms"_qs,    pct(recordedMs, 0.95)},
+        };
+    }
+};
+
+Report replay(TextBackend* api, const Recording& rec, double speed, qint64 maxGapMs)
+{
+    Report r;
+    QEventLoop loop;
+    RequestCoalescer coalescer;
+    ActionChain chain;
+    QHash<quint64, int> single, batched, chained;   // id -> action index
+    QVector<QElapsedTimer> started(rec.actions.size());
+    int open = int(rec.actions.size());
+
+    RequestOptions bulk;            // as BackgroundProcessor sends chunked jobs
+    bulk.priority = RequestOptions::Priority::Bulk;
+
+    auto done = [&](int idx, bool ok) {
+        if (ok) {
+            r.latencyMs << started[idx].elapsed();
+            r.recordedMs << rec.actions[idx].recordedMs;
+        } else {
+            ++r.errors;
+        }
+        if (--open == 0)
+            loop.quit();
+    };
+    // Every request reports its usage here, chunks and chain steps included.
+    QObject::connect(api, &TextBackend::requestMetrics, &loop, [&](quint64, const RequestMetrics& m) {
+        if (m.completionTokens > 0)
+            r.outTokens += m.completionTokens;
+    });
+    QObject::connect(api, &TextBackend::processingFinished, &loop, [&](quint64 id, const QString&) {
+        if (single.contains(id)) done(single.take(id), true);
+    });
+    QObject::connect(api, &TextBackend::processingError, &loop, [&](quint64 id, const QString& err) {
+        if (!single.contains(id)) return;
+        QTextStream(stderr) << "error: " << err << '\n';
+        done(single.take(id), false);
+    });
+    QObject::connect(&coalescer, &RequestCoalescer::finished, &loop, [&](quint64 id, const QStringList&) {
+        if (batched.contains(id)) done(batched.take(id), true);
+    });
+    QObject::connect(&coalescer, &RequestCoalescer::failed, &loop, [&](quint64 id, const QString& err) {
+        if (!batched.contains(id)) return;
+        QTextStream(stderr) << "error: " << err << '\n';
+        done(batched.take(id), false);
+    });
+    QObject::connect(&chain, &ActionChain::finished, &loop, [&](quint64 id, const QStringList&) {
+        if (chained.contains(id)) done(chained.take(id), true);
+    });
+    QObject::connect(&chain, &ActionChain::failed, &loop, [&](quint64 id, const QString& err) {
+        if (!chained.contains(id)) return;
+        QTextStream(stderr) << "error: " << err << '\n';
+        done(chained.take(id), false);
+    });
+
+    auto start = [&](int idx) {
+        const Action& a = rec.actions[idx];
+        QStringList segments;
+        for (int k = 0; k < a.segments.size(); ++k)
+            segments << synthetic(a.segments[k], idx * 31 + k);
+        started[idx].start();
+        if (a.steps > 1) {
+            QStringList prompts;
+            for (int s = 0; s < a.steps; ++s)
+                prompts << synthetic(qMax(1, a.promptChars / a.steps), -1 - s);
+            chained.insert(chain.submit(api, segments, prompts, bulk), idx);
+        } else if (segments.size() > 1) {
+            batched.insert(coalescer.submit(api, segments, synthetic(a.promptChars, -1), bulk), idx);
+        } else {
+            single.insert(api->processText(segments.first(), synthetic(a.promptChars, -1)), idx);
+        }
+    };
+
+    r.actions = int(rec.actions.size());
+    if (rec.actions.isEmpty())
+        return r;
+    QElapsedTimer wall;
+    wall.start();
+    qint64 at = 0;
+    for (int i = 0; i < rec.actions.size(); ++i) {
+        if (i > 0)
+            at += qMin(maxGapMs, rec.actions[i].t - rec.actions[i - 1].t);
+        QTimer::singleShot(int(at / speed), &loop, [&start, i] { start(i); });
+    }
+    loop.exec();
+    r.wallMs = wall.elapsed();
+    return r;
+}
+
+void printReport(const QJsonObject& now, const QJsonObject& base)
+{
+    QTextStream out(stdout);
+    const QStringList keys = {u"medianMs"_qs, u"p95Ms"_qs, u"meanMs"_qs,
+                              u"actionsPerSec"_qs, u"tokensPerSec"_qs, u"errors"_qs};
+    out << qSetFieldWidth(16) << Qt::left << "metric" << qSetFieldWidth(12) << Qt::right << "now";
+    if (!base.isEmpty())
+        out << "baseline" << "delta";
+    out << qSetFieldWidth(0) << '\n';
+    for (const QString& k : keys) {
+        const double v = now.value(k).toDouble();
+        out << qSetFieldWidth(16) << Qt::left << k << qSetFieldWidth(12) << Qt::right
+            << QString::number(v, 'f', 1);
+        if (!base.isEmpty()) {
+            const double b = base.value(k).toDouble();
+            out << QString::number(b, 'f', 1)
+                << (b != 0 ? QStringLiteral("%1%").arg((v - b) * 100.0 / b, 0, 'f', 1) : u"-"_qs);
+        }
+        out << qSetFieldWidth(0) << '\n';
+    }
+    out << "recorded latency of the same actions: median "
+        << now.value(u"recordedMedianMs"_qs).toInteger() << " ms, p95 "
+        << now.value(u"recordedP95Ms"_qs).toInteger() << " ms\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser p;
+    p.addHelpOption();
+    p.addPositionalArgument(QStringLiteral("recording"), QStringLiteral("Session file (JSON lines)."));
+    p.addOptions({
+            {QStringLiteral("endpoint"),   QStringLiteral("Chat-completions URL."), QStringLiteral("url"),
+                                           QStringLiteral("http://127.0.0.1:8080/v1/chat/completions")},
+            {QStringLiteral("model"),      QStringLiteral("Model name sent to the endpoint."), QStringLiteral("name"), QStringLiteral("local")},
+            {QStringLiteral("api-key"),    QStringLiteral("API key for the endpoint."), QStringLiteral("key"), QStringLiteral("none")},
+            {QStringLiteral("speed"),      QStringLiteral("Timeline speed-up factor."), QStringLiteral("x"), QStringLiteral("1")},
+            {QStringLiteral("max-gap-ms"), QStringLiteral("Longest idle gap between actions."), QStringLiteral("ms"), QStringLiteral("2000")},
+            {QStringLiteral("fit"),        QStringLiteral("Only print the timing model of the recording.")},
+            {QStringLiteral("out"),        QStringLiteral("Write the report as JSON."), QStringLiteral("file")},
+            {QStringLiteral("baseline"),   QStringLiteral("Report of an earlier build to compare with."), QStringLiteral("file")},
+    });
+    p.process(app);
+    if (p.positionalArguments().size() != 1)
+        p.showHelp(1);
+
+    Recording rec;
+    if (!load(p.positionalArguments().first(), &rec))
+        return 1;
+    QTextStream(stdout) << rec.actions.size() << " actions sent to the model, "
+                        << rec.local << " answered locally\n";
+    printTimingModel(rec);
+    if (p.isSet(QStringLiteral("fit")))
+        return 0;
+
+    // Same concurrency as the application's HTTP backends (kHttpConcurrency).
+    RequestScheduler api(new ApiClient(p.value(QStringLiteral("api-key")),
+                                       p.value(QStringLiteral("endpoint")),
+                                       p.value(QStringLiteral("model")), QString()),
+                         4);
+    const Report r = replay(&api, rec, qMax(0.01, p.value(QStringLiteral("speed")).toDouble()),
+                            qMax<qint64>(0, p.value(QStringLiteral("max-gap-ms")).toLongLong()));
+    const QJsonObject now = r.toJson();
+
+    QJsonObject base;
+    if (p.isSet(QStringLiteral("baseline"))) {
+        QFile f(p.value(QStringLiteral("baseline")));
+        if (f.open(QIODevice::ReadOnly))
+            base = QJsonDocument::fromJson(f.readAll()).object();
+        else
+            QTextStream(stderr) << "cannot read " << f.fileName() << '\n';
+    }
+    printReport(now, base);
+
+    if (p.isSet(QStringLiteral("out"))) {
+        QFile f(p.value(QStringLiteral("out")));
+        if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            QTextStream(stderr) << "cannot write " << f.fileName() << '\n';
+            return 1;
+        }
+        f.write(QJsonDocument(now).toJson());
+    }
+    return r.errors ? 2 : 0;
+}
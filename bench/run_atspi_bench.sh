@@ -0,0 +1,63 @@
+#!/bin/sh
+# Runs bench_atspi on a private D-Bus session, AT-SPI bus and X server
+# (Xvfb; without it the offscreen platform is tried, which may not expose
+# accessibility), so the desktop session is not disturbed.
+#
+#   bench/run_atspi_bench.sh <dir with bench_atspi> [bench_atspi options]
+#   KB_BENCH=bench_atspi_soak bench/run_atspi_bench.sh <dir> [options]
+#
+# Needs dbus-run-session, at-spi-bus-launcher and preferably Xvfb and
+# dbus-monitor (for the D-Bus call counts).
+set -eu
+
+if [ -z "${KB_BENCH_INNER:-}" ]; then
+    KB_BENCH_INNER=1 exec dbus-run-session -- "$0" "$@"
+fi
+
+BIN_DIR=${1:?usage: $0 <dir with bench_atspi> [options]}
+shift
+
+PIDS=""
+cleanup() { [ -n "$PIDS" ] && kill $PIDS 2>/dev/null || true; }
+trap cleanup EXIT INT TERM
+
+if command -v Xvfb >/dev/null 2>&1; then
+    DISPLAY_NUM=99
+    while [ -e "/tmp/.X11-unix/X$DISPLAY_NUM" ]; do DISPLAY_NUM=$((DISPLAY_NUM + 1)); done
+    Xvfb ":$DISPLAY_NUM" -screen 0 1280x1024x24 -nolisten tcp >/dev/null 2>&1 &
+    PIDS="$PIDS $!"
+    export DISPLAY=":$DISPLAY_NUM" QT_QPA_PLATFORM=xcb
+    sleep 1
+else
+    echo "Xvfb not found, trying QT_QPA_PLATFORM=offscreen" >&2
+    export QT_QPA_PLATFORM=offscreen
+fi
+
+LAUNCHER=""
+for f in /usr/libexec/at-spi-bus-launcher /usr/lib/at-spi2-core/at-spi-bus-launcher \
+         /usr/lib/at-spi-bus-launcher /usr/lib/*/at-spi-bus-launcher; do
+    if [ -x "$f" ]; then LAUNCHER=$f; break; fi
+done
+if [ -z "$LAUNCHER" ]; then
+    echo "at-spi-bus-launcher not found" >&2
+    exit 1
+fi
+"$LAUNCHER" --launch-immediately &
+PIDS="$PIDS $!"
+
+ADDRESS=""
+for _ in 1 2 3 4 5 6 7 8 9 10; do
+    ADDRESS=$(dbus-send --session --print-reply=literal --dest=org.a11y.Bus \
+                  /org/a11y/bus org.a11y.Bus.GetAddress 2>/dev/null | tr -d ' ') || true
+    [ -n "$ADDRESS" ] && break
+    sleep 0.5
+done
+if [ -z "$ADDRESS" ]; then
+    echo "AT-SPI bus did not come up" >&2
+    exit 1
+fi
+
+export AT_SPI_BUS_ADDRESS="$ADDRESS"
+export QT_LINUX_ACCESSIBILITY_ALWAYS_ON=1 QT_ACCESSIBILITY=1
+
+"$BIN_DIR/${KB_BENCH:-bench_atspi}" "$@"
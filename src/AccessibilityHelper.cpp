@@ -1,9 +1,19 @@
 // --- File: src/AccessibilityHelper.cpp ---
 #include "AccessibilityHelper.h"
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QTimer> // For GLib event processing
 #include <QCoreApplication> // For thread check
 #include <QThread> // <<< FIX 1: Include QThread
+#include <QLoggingCategory>
+#include <QStringList>
+
+#include <algorithm>
+#include <utility>
+
+#include <cerrno>
+#include <csignal>
 
 #ifdef HAVE_ATSPI
 #include <atspi/atspi.h>
@@ -26,6 +36,31 @@
 
 namespace { // Anonymous namespace for static callback
 
+#ifdef HAVE_ATSPI
+// What libatspi keeps for each object: enough for focus tracking and the
+// Text/EditableText lookups. Children and descriptions, which make up most
+// of a big application's cache, are fetched on demand instead.
+constexpr int kCacheMask = ATSPI_CACHE_PARENT | ATSPI_CACHE_NAME | ATSPI_CACHE_ROLE
+                           | ATSPI_CACHE_STATES | ATSPI_CACHE_INTERFACES;
+
+// D-Bus timeouts per kind of call. An application that does not answer
+// in time is left alone (see AccessibilityLatency) instead of making the
+// user wait.
+constexpr int kQuickCallMs     = 500;      // counts, selections, names
+constexpr int kTransferCallMs  = 2000;     // text in or out, which grows with the size
+constexpr int kDefaultCallMs   = 800;      // libatspi's defaults, restored after each call
+constexpr int kAppStartupMs    = 15000;
+
+// For the synthesized paste, without pulling in X11 headers.
+constexpr long kControlMask = 1 << 2;     // ControlMask
+constexpr long kKeysymV     = 0x0076;     // XK_v
+
+bool processAlive(int pid)
+{
+    return ::kill(pid, 0) == 0 || errno != ESRCH;
+}
+#endif
+
 #ifdef HAVE_ATSPI
 // Static callback function for focus events
 // Needs access to the AccessibilityHelper instance to update m_currentFocus
@@ -46,53 +81,16 @@ namespace { // Anonymous namespace for static callback
             return;
         }
 
-        // --- START: Check if the focus event is from our own application ---
-        GError* pid_error = nullptr;
-        // Note: atspi_accessible_get_process_id does not take a GError** argument
-        // It returns -1 on error.
-        int focused_app_pid = atspi_accessible_get_process_id(event->source, nullptr); // Pass nullptr for error
-
-        if (focused_app_pid == -1) {
-            // Could not get PID, proceed cautiously (maybe log a warning)
-            qWarning() << "AT-SPI: Failed to get process ID for focused object. Cannot ignore self.";
-            // Don't compare if we couldn't get the PID
-        } else {
-            qint64 self_pid = QCoreApplication::applicationPid();
-            if (self_pid > 0 && focused_app_pid == self_pid) {
-                // It's our own application window gaining focus (e.g., menu popup).
-                // Ignore this event to keep focus on the original target application.
-                // qDebug() << "AT-SPI: Ignoring focus event from self (PID:" << self_pid << ")";
-                return; // <-- EXIT EARLY, DO NOT UPDATE m_currentFocus
-            }
-        }
-        // --- END: Check if the focus event is from our own application ---
-
-        // Check if the event indicates focus gain
-        // The event string "object:state-changed:focused" implies state change.
-        // We need to check if the FOCUSED state is *now* set on the source object.
-        // We can rely on the event source directly being the newly focused object for
-        // standard focus events like `Focus:Object` or `Focus:Window`.
-        // For `object:state-changed:focused`, let's verify the state.
-        AtspiStateSet* stateSet = atspi_accessible_get_state_set(event->source);
-        // <<< FIX 2: Use g_object_unref for AtspiStateSet
-        if (stateSet) {
-            g_object_unref(stateSet); // Free the state set reference
-        }
-
-        if (atspi_state_set_contains(stateSet, ATSPI_STATE_FOCUSED)
-            && atspi_state_set_contains(stateSet, ATSPI_STATE_EDITABLE)) {
-            // The source object is now focused.
-            helper->updateCurrentFocus(event->source);
-        } else if (atspi_state_set_contains(stateSet, ATSPI_STATE_FOCUSED)) {
-            helper->updateCurrentFocus(nullptr); // we don't need other components
-        }
-
-        // This could be a focus-lost event for this object, ignore for our purpose
-        // unless we also want to track focus loss explicitly.
+        // For "object:state-changed:focused" detail1 tells whether the state
+        // was set or cleared, so the state set need not be fetched.
         // NOTE: DO NOT free the event here, the listener machinery does it.
-        //       atspi_event_free(event); // <-- WRONG
+        helper->onFocusEvent(event->source, event->detail1 != 0);
+    }
 
-        return;
+    void selection_event_callback(AtspiEvent *event, gpointer user_data) {
+        auto *helper = static_cast<AccessibilityHelper*>(user_data);
+        if (helper && event && event->source)
+            helper->onSelectionEvent(event->source);
     }
 
     void   destroy_callback     (gpointer){};
@@ -105,6 +103,7 @@ AccessibilityHelper::AccessibilityHelper(QObject *parent)
         : QObject(parent)
 #ifdef HAVE_ATSPI
         , m_glibEventTimer(new QTimer(this)), // Initialize timer here
+          m_cacheTimer(new QTimer(this)),
           m_focusListener(nullptr),
           m_currentFocus(nullptr)
 #endif // HAVE_ATSPI
@@ -113,6 +112,7 @@ AccessibilityHelper::AccessibilityHelper(QObject *parent)
     // Connect the timer here
 #ifdef HAVE_ATSPI
     connect(m_glibEventTimer, &QTimer::timeout, this, &AccessibilityHelper::processGlibEvents);
+    connect(m_cacheTimer, &QTimer::timeout, this, &AccessibilityHelper::sweepCaches);
 #endif
 }
 
@@ -136,10 +136,18 @@ AccessibilityHelper::~AccessibilityHelper()
         }
         m_focusListener = nullptr; // Mark as deregistered
     }
+    setSelectionTracking(false);
     if (m_currentFocus) {
         g_object_unref(m_currentFocus);
         m_currentFocus = nullptr;
     }
+    if (m_pendingFocus) {
+        g_object_unref(m_pendingFocus);
+        m_pendingFocus = nullptr;
+    }
+    for (const AppEntry& e : std::as_const(m_apps))
+        g_object_unref(e.app);
+    m_apps.clear();
     if (m_initialized) {
         qInfo() << "AT-SPI potentially shutting down (if managed by this helper).";
         // Commented out as it might interfere with Desktop Environment AT-SPI management
@@ -195,6 +203,16 @@ bool AccessibilityHelper::initialize()
         qInfo() << "AT-SPI focus listener registered successfully."; // FIX 7: Warning gone now
     }
 
+    // The mask set on the desktop is the default of every application.
+    if (m_cachePolicy.restrictMask) {
+        if (AtspiAccessible* desktop = atspi_get_desktop(0)) {
+            atspi_accessible_set_cache_mask(desktop, AtspiCache(kCacheMask));
+            g_object_unref(desktop);
+        }
+    }
+    if (m_cachePolicy.sweepMs > 0)
+        m_cacheTimer->start(m_cachePolicy.sweepMs);
+
     // Start GLib event processing timer (e.g., every 50ms)
     m_glibEventTimer->start(50);
     qInfo() << "GLib event processing timer started.";
@@ -213,6 +231,51 @@ bool AccessibilityHelper::isInitialized() const
     return m_initialized;
 }
 
+void AccessibilityHelper::setSelectionTracking(bool on)
+{
+#ifdef HAVE_ATSPI
+    static const char kEvent[] = "object:text-selection-changed";
+    if (on == (m_selectionListener != nullptr) || (on && !m_initialized))
+        return;
+    GError* error = nullptr;
+    if (on) {
+        m_selectionListener = atspi_event_listener_new(selection_event_callback, this, destroy_callback);
+        if (!atspi_event_listener_register(m_selectionListener, kEvent, &error)) {
+            qWarning() << "Failed to register AT-SPI selection listener:"
+                       << (error ? error->message : "Unknown error");
+            g_clear_error(&error);
+            g_object_unref(m_selectionListener);
+            m_selectionListener = nullptr;
+        }
+        return;
+    }
+    atspi_event_listener_deregister(m_selectionListener, kEvent, &error);
+    if (error) {
+        qWarning() << "Error deregistering AT-SPI selection listener:" << error->message;
+        g_error_free(error);
+    }
+    g_object_unref(m_selectionListener);
+    m_selectionListener = nullptr;
+    m_selectionDirty = false;
+#else
+    Q_UNUSED(on);
+#endif
+}
+
+bool AccessibilityHelper::focusedApplicationIsSlow() const
+{
+    return !m_focusApp.isEmpty() && m_latency.isSlow(m_focusApp);
+}
+
+int AccessibilityHelper::trackedApplications() const
+{
+#ifdef HAVE_ATSPI
+    return int(m_apps.size());
+#else
+    return 0;
+#endif
+}
+
 
 #ifdef HAVE_ATSPI
 // Slot to process pending GLib events
@@ -221,6 +284,55 @@ void AccessibilityHelper::processGlibEvents() {
     while (g_main_context_pending(nullptr)) {
         g_main_context_iteration(nullptr, FALSE);
     }
+    // A burst of focus events (window switch, dialog) ends up as one change.
+    if (m_pendingFocus) {
+        AtspiAccessible* focus = m_pendingFocus;
+        m_pendingFocus = nullptr;
+        updateCurrentFocus(focus);
+        g_object_unref(focus);
+    }
+    if (m_selectionDirty) {
+        m_selectionDirty = false;
+        Q_EMIT selectionChanged();
+    }
+}
+
+// No D-Bus traffic here: the PID is cached per application and everything
+// else about the element is looked up when the shortcut needs it.
+void AccessibilityHelper::onFocusEvent(AtspiAccessible* source, bool gained)
+{
+    if (!gained)
+        return;                             // focus left; the next gain replaces it
+    const int pid = processIdOf(source);
+    if (pid > 0 && pid == QCoreApplication::applicationPid())
+        return;                             // our own menu or dialog: keep the target
+    if (m_pendingFocus)
+        g_object_unref(m_pendingFocus);
+    m_pendingFocus = static_cast<AtspiAccessible*>(g_object_ref(source));
+}
+
+void AccessibilityHelper::onSelectionEvent(AtspiAccessible* source)
+{
+    const int pid = processIdOf(source);
+    if (pid > 0 && pid == QCoreApplication::applicationPid())
+        return;
+    m_selectionDirty = true;
+}
+
+// libatspi knows the bus name of every object's application; the PID behind
+// a bus name never changes, so one D-Bus call per application is enough.
+int AccessibilityHelper::processIdOf(AtspiAccessible* acc)
+{
+    const AtspiApplication* app = acc->parent.app;
+    if (!app || !app->bus_name)
+        return atspi_accessible_get_process_id(acc, nullptr);
+    const QByteArray bus(app->bus_name);
+    const auto it = m_pidByBus.constFind(bus);
+    if (it != m_pidByBus.cend())
+        return *it;
+    const int pid = atspi_accessible_get_process_id(acc, nullptr);
+    m_pidByBus.insert(bus, pid);
+    return pid;
 }
 
 // Member function to update the currently tracked focused object
@@ -232,6 +344,8 @@ void AccessibilityHelper::updateCurrentFocus(AtspiAccessible* newFocus) {
             g_object_unref(m_currentFocus);
         }
         m_currentFocus = nullptr;
+        m_focusPid = -1;
+        m_focusApp.clear();
     }
 
 
@@ -241,13 +355,9 @@ void AccessibilityHelper::updateCurrentFocus(AtspiAccessible* newFocus) {
         return;
     }
 
-    // Get info before updating pointer
-    char *name = atspi_accessible_get_name(newFocus, nullptr);
-    AtspiRole role = atspi_accessible_get_role(newFocus, nullptr);
-    char *role_name = atspi_role_get_name(role);
-    qDebug() << "AT-SPI Focus changed to:" << getAccessibleDebugString(newFocus);
-    g_free(name);
-    g_free(role_name);
+    // Name and role would cost round trips; they are logged on capture.
+    qDebug() << "AT-SPI Focus changed, application"
+             << (newFocus->parent.app ? newFocus->parent.app->bus_name : "?");
 
 
     // Release the old reference if it exists
@@ -257,8 +367,94 @@ void AccessibilityHelper::updateCurrentFocus(AtspiAccessible* newFocus) {
 
     // Take a new reference to the new object and store it
     m_currentFocus = static_cast<AtspiAccessible*>(g_object_ref(newFocus));
+    noteApplication(newFocus);
+}
+
+void AccessibilityHelper::noteApplication(AtspiAccessible* focus)
+{
+    m_focusPid = processIdOf(focus);
+    m_focusApp = processName(m_focusPid);
+    // The root is known once anything asked for it; until then there is
+    // little cached for the application anyway.
+    AtspiAccessible* app = focus->parent.app ? focus->parent.app->root : nullptr;
+    if (!app)
+        return;
+    auto it = m_apps.find(app);
+    if (it == m_apps.end()) {
+        AppEntry e;
+        e.app = static_cast<AtspiAccessible*>(g_object_ref(app));
+        e.pid = m_focusPid;
+        it = m_apps.insert(app, e);
+    }
+    it->lastFocus.start();
+}
+
+// Cheap and local: only kill(pid, 0) per tracked application, no D-Bus.
+void AccessibilityHelper::sweepCaches()
+{
+    if (m_currentFocus && m_focusPid > 0 && !processAlive(m_focusPid)) {
+        qDebug() << "AT-SPI: focused application" << m_focusPid << "exited, releasing it.";
+        updateCurrentFocus(nullptr);
+    }
+    for (auto it = m_apps.begin(); it != m_apps.end();) {
+        const bool gone = it->pid > 0 && !processAlive(it->pid);
+        const bool idle = m_cachePolicy.idleMs > 0 && it->pid != m_focusPid
+                          && it->lastFocus.hasExpired(m_cachePolicy.idleMs);
+        if (!gone && !idle) {
+            ++it;
+            continue;
+        }
+        if (gone && it->app->parent.app && it->app->parent.app->bus_name)
+            m_pidByBus.remove(QByteArray(it->app->parent.app->bus_name));
+        if (gone)
+            m_processNames.remove(it->pid);     // the PID may be reused
+        atspi_accessible_clear_cache(it->app);
+        g_object_unref(it->app);
+        it = m_apps.erase(it);
+    }
+}
+
+
+template <typename Call>
+auto AccessibilityHelper::timedCall(int timeoutMs, GError** error, Call&& call)
+{
+    atspi_set_timeout(timeoutMs, kAppStartupMs);
+    QElapsedTimer t;
+    t.start();
+    auto result = call(error);
+    const qint64 ms = t.elapsed();
+    atspi_set_timeout(kDefaultCallMs, kAppStartupMs);
+
+    // libatspi reports a timeout like any other IPC error; the time tells.
+    const bool timedOut = error && *error && ms >= timeoutMs * 9 / 10;
+    if (timedOut) {
+        m_callTimedOut = true;
+        qWarning() << "AT-SPI:" << m_callApp << "did not answer within" << timeoutMs << "ms";
+    }
+    // Text transfers take longer with the size of the document; only their
+    // timeouts say something about the application, their time does not.
+    if (timeoutMs <= kQuickCallMs || timedOut)
+        m_latency.record(m_callApp, ms, timedOut);
+    return result;
 }
 
+// Local: /proc, no D-Bus. Falls back to the PID.
+QString AccessibilityHelper::processName(int pid)
+{
+    if (pid <= 0)
+        return QString();
+    const auto it = m_processNames.constFind(pid);
+    if (it != m_processNames.cend())
+        return *it;
+    QFile comm(QStringLiteral("/proc/%1/comm").arg(pid));
+    QString name;
+    if (comm.open(QIODevice::ReadOnly))
+        name = QString::fromUtf8(comm.readAll()).trimmed();
+    if (name.isEmpty())
+        name = QStringLiteral("pid %1").arg(pid);
+    m_processNames.insert(pid, name);
+    return name;
+}
 
 // Helper to safely get text from AtspiText*, returns empty QString on error or if no text
 // This isolates the direct text fetching logic.
@@ -267,7 +463,9 @@ QString AccessibilityHelper::getTextFromAtspiText(AtspiText* textInterface, int
 
     GError *error = nullptr;
     // Note: atspi_text_get_text returns a NEW string that must be g_free'd
-    char *c_text = atspi_text_get_text(textInterface, startOffset, endOffset, &error);
+    char *c_text = timedCall(kTransferCallMs, &error, [&](GError** e) {
+        return atspi_text_get_text(textInterface, startOffset, endOffset, e);
+    });
 
     if (error) {
         qWarning() << "AT-SPI Error getting text:" << error->message;
@@ -350,8 +548,23 @@ ElementInfo AccessibilityHelper::getFocusedElementInfo()
     // We need to pass a new reference to ElementInfo, as it will unref it later.
     // The m_currentFocus reference belongs to the helper class instance.
     AtspiAccessible *focused_acc = static_cast<AtspiAccessible*>(g_object_ref(focused_acc_tracked));
-
-    qDebug() << "AT-SPI: Processing tracked focused object:" << getAccessibleDebugString(focused_acc);
+    m_callApp = m_focusApp;
+    m_callTimedOut = false;
+
+    if (QLoggingCategory::defaultCategory()->isDebugEnabled())
+        qDebug() << "AT-SPI: Processing tracked focused object:" << getAccessibleDebugString(focused_acc);
+
+    // Focus is tracked without asking the application anything, so a
+    // focused button or list is only told apart from a text field here.
+    AtspiStateSet* states = atspi_accessible_get_state_set(focused_acc);
+    const bool editableState = states && atspi_state_set_contains(states, ATSPI_STATE_EDITABLE);
+    if (states)
+        g_object_unref(states);
+    if (!editableState) {
+        qDebug() << "AT-SPI: Focused object is not an editable text element.";
+        g_object_unref(focused_acc);
+        return ElementInfo();
+    }
 
     if (!focused_acc) {
         qWarning() << "AT-SPI: No object currently focused.";
@@ -371,7 +584,14 @@ ElementInfo AccessibilityHelper::getFocusedElementInfo()
 
     // --- Get Text Length ---
     GError* error = nullptr;
-    gint text_length = atspi_text_get_character_count(text_iface, &error);
+    gint text_length = timedCall(kQuickCallMs, &error, [&](GError** e) {
+        return atspi_text_get_character_count(text_iface, e);
+    });
+    if (m_callTimedOut) {
+        g_clear_error(&error);
+        g_object_unref(focused_acc);
+        return ElementInfo();               // the selection readers take over
+    }
     if (error) {
         qWarning() << "AT-SPI Error getting character count:" << error->message;
         g_error_free(error);
@@ -381,38 +601,60 @@ ElementInfo AccessibilityHelper::getFocusedElementInfo()
         qDebug() << "AT-SPI: Text length:" << text_length;
     }
 
-    // --- Get Selection ---
+    // --- Get Selections ---
+    // Multi-cursor editors and browsers can report several ranges; take all
+    // of them so one request can handle every range.
     int start_offset = -1;
     int end_offset = -1;
     error = nullptr; // Reset error pointer
-    // Use AtspiTextRange, not AtspiRange. Function takes AtspiText*
-    AtspiRange* selection_range = atspi_text_get_selection(text_iface, 0, &error); // Selection index 0
-
+    gint n_selections = timedCall(kQuickCallMs, &error, [&](GError** e) {
+        return atspi_text_get_n_selections(text_iface, e);
+    });
     if (error) {
-        qWarning() << "AT-SPI Error getting selection:" << error->message;
+        qWarning() << "AT-SPI Error getting selection count:" << error->message;
         g_error_free(error);
-        error = nullptr; // Reset error
-        // Continue, maybe we can still get all text
+        error = nullptr;
+        n_selections = 0; // Continue, maybe we can still get all text
     }
 
-    bool has_selection = (selection_range != nullptr && selection_range->start_offset >= 0 && selection_range->end_offset >= selection_range->start_offset);
-    if (has_selection) {
-        start_offset = selection_range->start_offset;
-        end_offset = selection_range->end_offset;
-    }
-    if (selection_range) {
-        // atspi_text_range_free(selection_range); // Use correct free function <<-- REMOVED
-        g_free(selection_range); // <<-- CORRECTED: Use g_free for memory returned by AT-SPI functions like this
+    QVector<TextRange> ranges;
+    for (gint i = 0; i < n_selections && !m_callTimedOut; ++i) {
+        AtspiRange* selection_range = timedCall(kQuickCallMs, &error, [&](GError** e) {
+            return atspi_text_get_selection(text_iface, i, e);
+        });
+        if (error) {
+            qWarning() << "AT-SPI Error getting selection" << i << ":" << error->message;
+            g_error_free(error);
+            error = nullptr;
+        }
+        if (selection_range) {
+            const int s = selection_range->start_offset;
+            const int e = selection_range->end_offset;
+            if (s >= 0 && e > s && e <= text_length)
+                ranges.append(TextRange{s, e, QString()});
+            g_free(selection_range); // Use g_free for memory returned by AT-SPI functions like this
+        }
     }
+    std::sort(ranges.begin(), ranges.end(),
+              [](const TextRange& a, const TextRange& b) { return a.start < b.start; });
+    for (auto& r : ranges)
+        r.text = getTextFromAtspiText(text_iface, r.start, r.end);
 
     // --- Get Text Content ---
     QString element_text;
     bool was_selection = false;
 
-    if (has_selection && start_offset >= 0 && end_offset >= start_offset && end_offset <= text_length && end_offset != 0) {
-        // Valid selection found, get selected text using the dedicated helper
-        element_text = getTextFromAtspiText(text_iface, start_offset, end_offset); // Pass text_iface
+    if (!ranges.isEmpty()) {
+        // Valid selection(s) found; the first one also fills the single-range fields
+        start_offset = ranges.first().start;
+        end_offset = ranges.first().end;
+        QStringList parts;
+        for (const auto& r : std::as_const(ranges))
+            parts << r.text;
+        element_text = parts.join(QLatin1Char('\n'));
         was_selection = true;
+        if (ranges.size() > 1)
+            qDebug() << "AT-SPI:" << ranges.size() << "selected ranges";
     } else {
         // No valid selection or error getting selection, get all text
         start_offset = 0; // Reset offsets for "all text" case
@@ -430,6 +672,10 @@ ElementInfo AccessibilityHelper::getFocusedElementInfo()
             qDebug() << "AT-SPI: No selection found, and no text content.";
         }
     }
+    if (m_callTimedOut) {
+        g_object_unref(focused_acc);
+        return ElementInfo();
+    }
     qDebug() << "AT-SPI: Text retrieved (WasSelection:" << was_selection << "Range:" << start_offset << "-" << end_offset << "):" << element_text.left(50) << "...";
 
     // --- Check Editability ---
@@ -453,10 +699,23 @@ ElementInfo AccessibilityHelper::getFocusedElementInfo()
     // The AtspiAccessible* (focused_acc) is passed to the ElementInfo constructor,
     // which takes ownership via QSharedPointer and ensures it's unref'd later.
     // We don't unref focused_acc here anymore.
-    return ElementInfo(focused_acc, is_editable, element_text,
-                       was_selection ? start_offset : 0,
-                       was_selection ? end_offset : text_length,
-                       text_length, was_selection);
+    ElementInfo info(focused_acc, is_editable, element_text,
+                     was_selection ? start_offset : 0,
+                     was_selection ? end_offset : text_length,
+                     text_length, was_selection);
+    info.ranges = ranges;
+    info.process = m_focusApp;
+    if (AtspiAccessible* app = atspi_accessible_get_application(focused_acc, nullptr)) {
+        GError* name_error = nullptr;
+        gchar* app_name = timedCall(kQuickCallMs, &name_error, [&](GError** e) {
+            return atspi_accessible_get_name(app, e);
+        });
+        g_clear_error(&name_error);
+        info.appName = app_name ? QString::fromUtf8(app_name) : QString();
+        g_free(app_name);
+        g_object_unref(app);
+    }
+    return info;
 
 #else
     qWarning() << "AT-SPI support is disabled.";
@@ -468,15 +727,225 @@ ElementInfo AccessibilityHelper::getFocusedElementInfo()
 bool AccessibilityHelper::replaceTextInElement(const ElementInfo& elementInfo, const QString& newText)
 {
 #ifdef HAVE_ATSPI
+    AtspiEditableText* editable_iface = editableInterface(elementInfo);
+    if (!editable_iface)
+        return false;
+    m_callApp = elementInfo.process;
+
+    QElapsedTimer t;
+    t.start();
+    const bool success = replaceRange(editable_iface, elementInfo.selectionStart,
+                                      elementInfo.selectionEnd, newText);
+    if (success) {
+        m_latency.recordInsert(elementInfo.process, int(newText.size()), t.elapsed());
+        qInfo() << "AT-SPI: Text replacement/modification successful.";
+    } else {
+        qWarning() << "AT-SPI: Text replacement/modification failed.";
+    }
+    return success;
+
+#else
+    Q_UNUSED(elementInfo);
+    Q_UNUSED(newText);
+    qWarning() << "AT-SPI support is disabled, cannot replace text.";
+    return false;
+#endif // HAVE_ATSPI
+}
+
+bool AccessibilityHelper::replaceRanges(const ElementInfo& elementInfo, const QStringList& newTexts)
+{
+#ifdef HAVE_ATSPI
+    if (newTexts.size() != elementInfo.ranges.size()) {
+        qWarning() << "Cannot replace ranges: got" << newTexts.size()
+                   << "results for" << elementInfo.ranges.size() << "ranges.";
+        return false;
+    }
+    AtspiEditableText* editable_iface = editableInterface(elementInfo);
+    if (!editable_iface)
+        return false;
+    m_callApp = elementInfo.process;
+
+    // Back to front: replacing a range only shifts the offsets after it,
+    // so the ranges still to be processed stay valid.
+    for (qsizetype i = elementInfo.ranges.size() - 1; i >= 0; --i) {
+        const TextRange& r = elementInfo.ranges[i];
+        if (!replaceRange(editable_iface, r.start, r.end, newTexts[i])) {
+            qWarning() << "AT-SPI: Replacing range" << i << "failed," << (elementInfo.ranges.size() - 1 - i)
+                       << "of" << elementInfo.ranges.size() << "ranges were replaced.";
+            return false;
+        }
+    }
+    qInfo() << "AT-SPI: Replaced" << elementInfo.ranges.size() << "ranges.";
+    return true;
+#else
+    Q_UNUSED(elementInfo);
+    Q_UNUSED(newTexts);
+    qWarning() << "AT-SPI support is disabled, cannot replace text.";
+    return false;
+#endif // HAVE_ATSPI
+}
+
+bool AccessibilityHelper::replaceInFocusedElement(const QString& from, const QString& to, int nearOffset)
+{
+#ifdef HAVE_ATSPI
+    if (!m_initialized || !m_currentFocus || from.isEmpty())
+        return false;
+    AtspiText* text_iface = atspi_accessible_get_text_iface(m_currentFocus);
+    AtspiEditableText* editable_iface = atspi_accessible_get_editable_text_iface(m_currentFocus);
+    if (!text_iface || !editable_iface) {
+        qWarning() << "AT-SPI: Focused element is not editable text.";
+        return false;
+    }
+    m_callApp = m_focusApp;
+    GError* error = nullptr;
+    const gint length = timedCall(kQuickCallMs, &error, [&](GError** e) {
+        return atspi_text_get_character_count(text_iface, e);
+    });
+    if (error) {
+        qWarning() << "AT-SPI Error getting character count:" << error->message;
+        g_error_free(error);
+        return false;
+    }
+    const QString all = getTextFromAtspiText(text_iface, 0, length);
+
+    // AT-SPI offsets count code points, QString indexes UTF-16 units.
+    auto toChars = [&all](qsizetype index) { return int(QStringView(all).left(index).toUcs4().size()); };
+    int best = -1;
+    int bestDistance = 0;
+    for (qsizetype i = all.indexOf(from); i >= 0; i = all.indexOf(from, i + 1)) {
+        const int chars = toChars(i);
+        const int distance = nearOffset < 0 ? 0 : qAbs(chars - nearOffset);
+        if (best < 0 || distance < bestDistance) {
+            best = chars;
+            bestDistance = distance;
+        }
+        if (nearOffset < 0)
+            break;
+    }
+    if (best < 0) {
+        qInfo() << "AT-SPI: Text to replace is no longer in the focused element.";
+        return false;
+    }
+    return replaceRange(editable_iface, best, best + int(from.toUcs4().size()), to);
+#else
+    Q_UNUSED(from);
+    Q_UNUSED(to);
+    Q_UNUSED(nearOffset);
+    return false;
+#endif // HAVE_ATSPI
+}
+
+bool AccessibilityHelper::selectRange(const ElementInfo& elementInfo, int start, int end)
+{
+#ifdef HAVE_ATSPI
+    if (!m_initialized || !elementInfo.isValid || !elementInfo.accessible)
+        return false;
+    AtspiText* text_iface = atspi_accessible_get_text_iface(elementInfo.accessible.data());
+    if (!text_iface)
+        return false;
+    m_callApp = elementInfo.process;
+    GError* error = nullptr;
+    // Replace the first selection; without one, add it.
+    bool ok = timedCall(kQuickCallMs, &error, [&](GError** e) {
+        return atspi_text_set_selection(text_iface, 0, start, end, e);
+    });
+    if (!ok || error) {
+        g_clear_error(&error);
+        ok = timedCall(kQuickCallMs, &error, [&](GError** e) {
+            return atspi_text_add_selection(text_iface, start, end, e);
+        });
+    }
+    if (error) {
+        qWarning() << "AT-SPI Error selecting range:" << error->message;
+        g_error_free(error);
+        return false;
+    }
+    return ok;
+#else
+    Q_UNUSED(elementInfo);
+    Q_UNUSED(start);
+    Q_UNUSED(end);
+    return false;
+#endif // HAVE_ATSPI
+}
+
+bool AccessibilityHelper::hasFocus(const ElementInfo& elementInfo)
+{
+#ifdef HAVE_ATSPI
+    if (!m_initialized || !elementInfo.isValid || !elementInfo.accessible)
+        return false;
+    processGlibEvents();                    // focus changes not applied yet
+    if (m_currentFocus != elementInfo.accessible.data())
+        return false;
+    AtspiStateSet* states = atspi_accessible_get_state_set(elementInfo.accessible.data());
+    const bool focused = states && atspi_state_set_contains(states, ATSPI_STATE_FOCUSED);
+    if (states)
+        g_object_unref(states);
+    return focused;
+#else
+    Q_UNUSED(elementInfo);
+    return false;
+#endif // HAVE_ATSPI
+}
+
+bool AccessibilityHelper::synthesizePaste()
+{
+#ifdef HAVE_ATSPI
+    if (!m_initialized)
+        return false;
+    GError* error = nullptr;
+    bool ok = atspi_generate_keyboard_event(kControlMask, nullptr, ATSPI_KEY_LOCKMODIFIERS, &error);
+    if (ok && !error)
+        ok = atspi_generate_keyboard_event(kKeysymV, nullptr, ATSPI_KEY_SYM, &error);
+    // Always released, even if the key itself failed.
+    atspi_generate_keyboard_event(kControlMask, nullptr, ATSPI_KEY_UNLOCKMODIFIERS, nullptr);
+    if (error) {
+        qWarning() << "AT-SPI Error synthesizing paste:" << error->message;
+        g_error_free(error);
+        return false;
+    }
+    return ok;
+#else
+    return false;
+#endif // HAVE_ATSPI
+}
+
+int AccessibilityHelper::characterCount(const ElementInfo& elementInfo)
+{
+#ifdef HAVE_ATSPI
+    if (!m_initialized || !elementInfo.isValid || !elementInfo.accessible)
+        return -1;
+    AtspiText* text_iface = atspi_accessible_get_text_iface(elementInfo.accessible.data());
+    if (!text_iface)
+        return -1;
+    m_callApp = elementInfo.process;
+    GError* error = nullptr;
+    const gint count = timedCall(kQuickCallMs, &error, [&](GError** e) {
+        return atspi_text_get_character_count(text_iface, e);
+    });
+    if (error) {
+        g_error_free(error);
+        return -1;
+    }
+    return count;
+#else
+    Q_UNUSED(elementInfo);
+    return -1;
+#endif // HAVE_ATSPI
+}
+
+#ifdef HAVE_ATSPI
+AtspiEditableText* AccessibilityHelper::editableInterface(const ElementInfo& elementInfo)
+{
     if (!m_initialized || !elementInfo.isValid || !elementInfo.isEditable || !elementInfo.accessible) {
         qWarning() << "Cannot replace text: AT-SPI not init, element invalid/uneditable, or accessible ptr missing.";
-        return false;
+        return nullptr;
     }
 
     AtspiAccessible* acc = elementInfo.accessible.data(); // Get raw pointer from QSharedPointer
     if (!acc) {
         qWarning() << "Accessible pointer is null in ElementInfo.";
-        return false;
+        return nullptr;
     }
 
     // Get the EditableText interface pointer
@@ -485,24 +954,26 @@ bool AccessibilityHelper::replaceTextInElement(const ElementInfo& elementInfo, c
 
     if (!editable_iface) {
         qWarning() << "Could not get EditableText interface for replacement (already checked isEditable, but verify again).";
-        return false;
     }
+    return editable_iface;
+}
 
+// Strategy: Delete original range, then insert new text at start position.
+bool AccessibilityHelper::replaceRange(AtspiEditableText* editable_iface, int start, int end,
+                                       const QString& newText)
+{
     GError *error = nullptr;
     bool success = false;
     QByteArray newTextUtf8 = newText.toUtf8();
 
-    qDebug() << "AT-SPI: Attempting to replace range" << elementInfo.selectionStart
-             << "to" << elementInfo.selectionEnd << "with new text (length " << newTextUtf8.length() << ")";
-
-    // Strategy: Delete original range, then insert new text at start position.
+    qDebug() << "AT-SPI: Attempting to replace range" << start
+             << "to" << end << "with new text (length " << newTextUtf8.length() << ")";
 
     // 1. Delete the original text range
-    if (elementInfo.selectionEnd > elementInfo.selectionStart) { // Only delete if range has size > 0
-        success = atspi_editable_text_delete_text(editable_iface,
-                                                  elementInfo.selectionStart,
-                                                  elementInfo.selectionEnd,
-                                                  &error);
+    if (end > start) { // Only delete if range has size > 0
+        success = timedCall(kTransferCallMs, &error, [&](GError** e) {
+            return atspi_editable_text_delete_text(editable_iface, start, end, e);
+        });
         if (error) {
             qWarning() << "AT-SPI Error deleting text:" << error->message;
             g_error_free(error);
@@ -512,29 +983,25 @@ bool AccessibilityHelper::replaceTextInElement(const ElementInfo& elementInfo, c
             qWarning() << "AT-SPI: Deleting text failed without specific GError.";
             // Success remains false
         } else {
-            qDebug() << "AT-SPI: Successfully deleted range" << elementInfo.selectionStart << "-" << elementInfo.selectionEnd;
+            qDebug() << "AT-SPI: Successfully deleted range" << start << "-" << end;
         }
     } else {
         qDebug() << "AT-SPI: Skipping delete step as range has zero or negative size:"
-                 << elementInfo.selectionStart << "to" << elementInfo.selectionEnd;
+                 << start << "to" << end;
         success = true; // Consider the (non-)delete step successful to proceed to insert
     }
 
-
-    // Optional delay (use with caution)
-    // QThread::msleep(20);
-
     // 2. Insert the new text at the original start position (only if delete step succeeded)
     if (success && !newTextUtf8.isEmpty()) { // Also check if there's actually text to insert
-        // Note: The length parameter for insert_text is the number of *characters*, not bytes.
-        // However, AT-SPI C API often expects byte length for char*. Let's stick with byte length.
-        // CORRECTION: Documentation often specifies length is in characters for Glib/Gtk related C APIs dealing with UTF-8.
-        // Let's use the character count from the QString.
-        success = atspi_editable_text_insert_text(editable_iface,
-                                                  elementInfo.selectionStart, // Insert at the beginning of the original range
-                                                  newTextUtf8.constData(),
-                                                  newText.length(), // Pass CHARACTER length
-                                                  &error);
+        // The length parameter for insert_text is the number of *characters*,
+        // not bytes: use the character count from the QString.
+        success = timedCall(kTransferCallMs, &error, [&](GError** e) {
+            return atspi_editable_text_insert_text(editable_iface,
+                                                   start, // Insert at the beginning of the original range
+                                                   newTextUtf8.constData(),
+                                                   newText.length(), // Pass CHARACTER length
+                                                   e);
+        });
         if (error) {
             qWarning() << "AT-SPI Error inserting text:" << error->message;
             g_error_free(error);
@@ -548,22 +1015,7 @@ bool AccessibilityHelper::replaceTextInElement(const ElementInfo& elementInfo, c
         // Success remains true (as delete might have been the only intended action)
     }
 
-
-    // Cleanup the interface pointer - Not needed for interfaces obtained via atspi_accessible_get_*_iface
-    // g_object_unref(editable_iface);
-
-    if (success) {
-        qInfo() << "AT-SPI: Text replacement/modification successful.";
-    } else {
-        qWarning() << "AT-SPI: Text replacement/modification failed.";
-    }
-
+    // Interfaces obtained via atspi_accessible_get_*_iface need no cleanup.
     return success;
-
-#else
-    Q_UNUSED(elementInfo);
-    Q_UNUSED(newText);
-    qWarning() << "AT-SPI support is disabled, cannot replace text.";
-    return false;
+}
 #endif // HAVE_ATSPI
-}
\ No newline at end of file
@@ -2,11 +2,17 @@
 #ifndef ACCESSIBILITYHELPER_H
 #define ACCESSIBILITYHELPER_H
 
+#include <QElapsedTimer>
+#include <QHash>
 #include <QObject>
 #include <QString>
+#include <QStringList>
 #include <QSharedPointer> // For managing AtspiAccessible lifecycle
+#include <QVector>
 #include <utility> // For std::move
 
+#include "AccessibilityLatency.h"
+
 // Forward declare Qt classes used in private members
 class QTimer;
 
@@ -41,6 +47,13 @@ typedef void AtspiEvent; // Dummy type
 // Helper function prototype (definition in .cpp)
 QString getAccessibleDebugString(AtspiAccessible *obj);
 
+// One selected range of an element, in character offsets
+struct TextRange {
+    int start = -1;
+    int end = -1;
+    QString text;
+};
+
 // Structure to hold information about the focused text element
 struct ElementInfo {
     bool isValid = false;       // Was a valid, focused, text element found?
@@ -50,6 +63,9 @@ struct ElementInfo {
     int selectionEnd = -1;      // End offset of selection (-1 if none/invalid)
     int textLength = 0;         // Total length of the text in the element
     bool wasSelection = false;  // True if specific text was selected, false if all text was retrieved
+    QVector<TextRange> ranges;  // All selected ranges in ascending order (empty if none)
+    QString appName;            // Name of the application owning the element
+    QString process;            // Executable of that application (see AccessibilityLatency)
 
 #ifdef HAVE_ATSPI
     // Use QSharedPointer with a custom deleter for automatic g_object_unref
@@ -90,6 +106,16 @@ public:
     bool initialize(); // Initialize AT-SPI connection, register listener, start timer
     bool isInitialized() const;
 
+    // How the AT-SPI client cache is kept small. Set before initialize();
+    // the soak benchmark uses shorter times.
+    struct CachePolicy {
+        bool restrictMask = true;           // cache only the properties we read
+        int  sweepMs = 30 * 1000;           // check for exited and idle applications
+        int  idleMs  = 10 * 60 * 1000;      // drop caches of apps unfocused this long, 0 = never
+    };
+    void setCachePolicy(const CachePolicy& policy) { m_cachePolicy = policy; }
+    int trackedApplications() const;        // applications with caches we hold
+
     // Get info about the currently focused text element using the tracked focus.
     ElementInfo getFocusedElementInfo();
 
@@ -97,11 +123,48 @@ public:
     // Uses selectionStart/End from ElementInfo to determine the range.
     bool replaceTextInElement(const ElementInfo& elementInfo, const QString& newText);
 
+    // Replace every range in elementInfo.ranges with the matching entry of newTexts.
+    bool replaceRanges(const ElementInfo& elementInfo, const QStringList& newTexts);
+
+    // Replace the occurrence of `from` closest to `nearOffset` (characters,
+    // -1 = any) in the focused element with `to`. Used to undo and redo
+    // edits after the original ElementInfo is gone.
+    bool replaceInFocusedElement(const QString& from, const QString& to, int nearOffset = -1);
+
+    // Every capture and replace call has a short D-Bus timeout of its own and
+    // is timed per application. For an application found slow the caller
+    // should not use AT-SPI at all (selection in, clipboard out).
+    const AccessibilityLatency& latency() const { return m_latency; }
+    QString focusedApplication() const { return m_focusApp; }
+    bool focusedApplicationIsSlow() const;
+
+    // Paste injection (see PasteInjector): select [start, end) of the
+    // element, then press Ctrl+V through the AT-SPI device event controller.
+    bool selectRange(const ElementInfo& elementInfo, int start, int end);
+    bool synthesizePaste();
+    // Is the element still the focused one? Key events go wherever the
+    // keyboard focus is, so paste only after this said yes.
+    bool hasFocus(const ElementInfo& elementInfo);
+    int characterCount(const ElementInfo& elementInfo);    // -1 on error
+    void recordPaste(const QString& process, qint64 ms, bool ok) { m_latency.recordPaste(process, ms, ok); }
+
+    // Also listen to "object:text-selection-changed" (off by default: every
+    // application then wakes us on each selection change).
+    void setSelectionTracking(bool on);
+
+Q_SIGNALS:
+    // Once per event batch in which a selection of another application changed.
+    void selectionChanged();
+
+public:
+
 #ifdef HAVE_ATSPI
-    // Public method to update the internal focus pointer (called by static callback)
-    // Must ensure this is called thread-safely if callbacks can happen off main thread
-    // (but our timer approach keeps it on the main thread)
-    void updateCurrentFocus(AtspiAccessible* newFocus);
+    // Called by the static focus callback, on the main thread (our timer
+    // drives the GLib loop). Makes no D-Bus calls except the first time an
+    // application is seen; the change is applied after the event batch.
+    void onFocusEvent(AtspiAccessible* source, bool gained);
+    // Same for the selection callback; no D-Bus calls.
+    void onSelectionEvent(AtspiAccessible* source);
 #endif
 
 private Q_SLOTS:
@@ -112,17 +175,53 @@ private Q_SLOTS:
 
 private:
     bool m_initialized = false;
+    CachePolicy m_cachePolicy;
+    AccessibilityLatency m_latency;
+    QString m_focusApp;                  // executable of the focused application
 
 #ifdef HAVE_ATSPI
+    // Runs one blocking AT-SPI call with the given D-Bus timeout and records
+    // its time for m_callApp; sets m_callTimedOut when it ran into the timeout.
+    template <typename Call>
+    auto timedCall(int timeoutMs, GError** error, Call&& call);
+    QString processName(int pid);
+
     // Helper to get text safely from AtspiText interface
     QString getTextFromAtspiText(AtspiText* textInterface, int startOffset, int endOffset);
 
     // Helper to get text safely from AtspiAccessible object
     QString getTextFromAccessible(AtspiAccessible* acc, int startOffset, int endOffset);
 
+    // EditableText interface of a valid, editable element (nullptr otherwise)
+    AtspiEditableText* editableInterface(const ElementInfo& elementInfo);
+
+    // Delete [start, end) and insert newText at start
+    bool replaceRange(AtspiEditableText* editableIface, int start, int end, const QString& newText);
+
+    // Applications that had focus, to drop their caches later.
+    struct AppEntry {
+        AtspiAccessible* app = nullptr;     // owned ref
+        int pid = -1;
+        QElapsedTimer lastFocus;
+    };
+    void updateCurrentFocus(AtspiAccessible* newFocus);
+    int processIdOf(AtspiAccessible* acc);
+    void noteApplication(AtspiAccessible* focus);
+    void sweepCaches();
+
     QTimer* m_glibEventTimer; // Timer to drive GLib event loop processing
+    QTimer* m_cacheTimer;     // runs sweepCaches()
     AtspiEventListener* m_focusListener; // Handle for the registered focus listener
+    AtspiEventListener* m_selectionListener = nullptr;  // set while tracking selections
+    bool m_selectionDirty = false;       // selection events in the current batch
     AtspiAccessible* m_currentFocus;     // Pointer to the currently focused accessible object (owned ref)
+    AtspiAccessible* m_pendingFocus = nullptr;  // last focus of the current event batch (owned ref)
+    int m_focusPid = -1;                 // process of m_currentFocus
+    QHash<QByteArray, int> m_pidByBus;   // application bus name -> PID
+    QHash<int, QString> m_processNames;  // PID -> executable name
+    QString m_callApp;                   // application the running calls go to
+    bool m_callTimedOut = false;
+    QHash<AtspiAccessible*, AppEntry> m_apps;
 
 #endif
 
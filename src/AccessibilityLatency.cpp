@@ -0,0 +1,97 @@
+#include "AccessibilityLatency.h"
+
+#include <QDebug>
+
+#include <algorithm>
+
+namespace {
+constexpr double kRecentWeight = 0.3;   // of the newest call in recentMs
+constexpr int    kMinCalls = 3;         // before an average marks an app slow
+} // namespace
+
+void AccessibilityLatency::record(const QString& app, qint64 ms, bool timedOut)
+{
+    if (app.isEmpty())
+        return;
+    App& a = m_apps[app];
+    a.name = app;
+    // A retry after the slow period starts the average afresh.
+    const bool retry = a.slowSince.isValid() && a.slowSince.hasExpired(kRetryAfterMs);
+    if (retry)
+        a.slowSince.invalidate();
+    a.recentMs = (a.calls && !retry) ? a.recentMs + kRecentWeight * (double(ms) - a.recentMs)
+                                     : double(ms);
+    ++a.calls;
+    a.totalMs += ms;
+    a.maxMs = qMax(a.maxMs, ms);
+    if (timedOut)
+        ++a.timeouts;
+
+    const bool slow = timedOut || (a.calls >= kMinCalls && a.recentMs > kSlowMs);
+    if (slow) {
+        if (!a.slowSince.isValid())
+            qInfo() << "AT-SPI:" << app << "is slow to answer, using the clipboard path for it.";
+        a.slowSince.start();
+    } else if (a.slowSince.isValid() && a.recentMs <= kSlowMs) {
+        a.slowSince.invalidate();
+    }
+}
+
+bool AccessibilityLatency::isSlow(const QString& app) const
+{
+    const auto it = m_apps.constFind(app);
+    return it != m_apps.cend() && it->slowSince.isValid()
+           && !it->slowSince.hasExpired(kRetryAfterMs);
+}
+
+void AccessibilityLatency::recordInsert(const QString& app, int chars, qint64 ms)
+{
+    if (app.isEmpty() || chars <= 0)
+        return;
+    App& a = m_apps[app];
+    a.name = app;
+    const double perKChar = double(ms) * 1000.0 / chars;
+    a.insertMsPerKChar = a.inserts ? a.insertMsPerKChar + kRecentWeight * (perKChar - a.insertMsPerKChar)
+                                   : perKChar;
+    ++a.inserts;
+}
+
+void AccessibilityLatency::recordPaste(const QString& app, qint64 ms, bool ok)
+{
+    if (app.isEmpty())
+        return;
+    App& a = m_apps[app];
+    a.name = app;
+    if (!ok) {
+        ++a.pasteFailures;
+        return;
+    }
+    a.pasteMs = a.pastes ? a.pasteMs + kRecentWeight * (double(ms) - a.pasteMs) : double(ms);
+    ++a.pastes;
+}
+
+bool AccessibilityLatency::pasteWorks(const QString& app) const
+{
+    const auto it = m_apps.constFind(app);
+    return it == m_apps.cend() || it->pasteFailures < 2 || it->pastes > it->pasteFailures;
+}
+
+// An insert is measured first; from then on the cheaper way is used.
+bool AccessibilityLatency::preferPaste(const QString& app, int chars) const
+{
+    if (chars < kPasteMinChars || !pasteWorks(app))
+        return false;
+    const auto it = m_apps.constFind(app);
+    if (it == m_apps.cend() || it->inserts == 0)
+        return false;
+    const double insertMs = it->insertMsPerKChar * chars / 1000.0;
+    return insertMs > (it->pastes ? it->pasteMs : double(kPasteGuessMs));
+}
+
+QVector<AccessibilityLatency::App> AccessibilityLatency::rows() const
+{
+    QVector<App> out(m_apps.cbegin(), m_apps.cend());
+    std::sort(out.begin(), out.end(),
+              [](const App& a, const App& b) { return a.recentMs > b.recentMs; });
+    return out;
+}
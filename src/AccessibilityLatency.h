@@ -0,0 +1,59 @@
+#pragma once
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+/**
+ *  How fast each application answers AT-SPI calls (this session only).
+ *  Only calls whose cost does not depend on the text size are averaged;
+ *  text transfers count when they time out.
+ *  An application that timed out or answers slowly is "slow" for a while:
+ *  its text is then taken from the selection and results go through the
+ *  clipboard, so the user does not wait on D-Bus. Afterwards it gets
+ *  another chance.
+ *
+ *  Also picks how a large result is put back: inserted through
+ *  EditableText, or pasted (see PasteInjector), whichever was faster for
+ *  the application so far.
+ */
+class AccessibilityLatency
+{
+public:
+    static constexpr int kSlowMs = 500;                 // typical call above this
+    static constexpr int kRetryAfterMs = 10 * 60 * 1000;
+    static constexpr int kPasteMinChars = 2000;         // smaller results are inserted anywhere
+    static constexpr int kPasteGuessMs = 500;           // paste cost before one was measured
+
+    struct App {
+        QString name;
+        int     calls = 0;
+        int     timeouts = 0;
+        qint64  totalMs = 0;
+        qint64  maxMs = 0;
+        double  recentMs = 0;           // moving average of the last calls
+        QElapsedTimer slowSince;        // invalid while the app is fine
+
+        int     inserts = 0;            // replacements through EditableText
+        double  insertMsPerKChar = 0;   // moving average
+        int     pastes = 0;
+        int     pasteFailures = 0;
+        double  pasteMs = 0;            // moving average of successful pastes
+
+        qint64 avgMs() const { return calls ? totalMs / calls : 0; }
+    };
+
+    void record(const QString& app, qint64 ms, bool timedOut);
+    bool isSlow(const QString& app) const;
+
+    void recordInsert(const QString& app, int chars, qint64 ms);
+    void recordPaste(const QString& app, qint64 ms, bool ok);
+    // Paste a result of `chars` characters instead of inserting it?
+    bool preferPaste(const QString& app, int chars) const;
+    // Has pasting not failed for the application most of the time?
+    bool pasteWorks(const QString& app) const;
+    QVector<App> rows() const;          // slowest (by recent calls) first
+
+private:
+    QHash<QString, App> m_apps;
+};
@@ -0,0 +1,237 @@
+#include "ActionChain.h"
+
+#include <QRegularExpression>
+#include <QTimer>
+#include <KLocalizedString>
+
+ActionChain::ActionChain(QObject* parent)
+        : QObject(parent)
+{
+}
+
+QStringList ActionChain::steps(const QString& prompt)
+{
+    static const QRegularExpression separator(QStringLiteral("^[ \\t]*---[ \\t]*$"),
+                                              QRegularExpression::MultilineOption);
+    QStringList out;
+    for (const QString& part : prompt.split(separator)) {
+        const QString step = part.trimmed();
+        if (!step.isEmpty())
+            out << step;
+    }
+    if (out.isEmpty())
+        out << prompt;
+    return out;
+}
+
+quint64 ActionChain::submit(TextBackend* backend, const QStringList& segments,
+                            const QStringList& prompts, const RequestOptions& options)
+{
+    const quint64 jobId = ++m_lastJobId;
+    Job& job = m_jobs[jobId];
+    job.backend = backend;
+    job.prompts = prompts;
+    job.options = options;
+
+    connect(backend, &TextBackend::partialResult,
+            this, &ActionChain::onPartial, Qt::UniqueConnection);
+    connect(backend, &TextBackend::processingFinished,
+            this, &ActionChain::onFinished, Qt::UniqueConnection);
+    connect(backend, &TextBackend::processingError,
+            this, &ActionChain::onError, Qt::UniqueConnection);
+
+    for (const QString& s : segments)
+        send(jobId, -1, 0, s, QString());
+    // Nothing to wait for (no segments, only whitespace): finish asynchronously.
+    const auto jit = m_jobs.constFind(jobId);
+    if (jit != m_jobs.cend() && jit->requests.isEmpty())
+        QTimer::singleShot(0, this, [this, jobId]{ checkDone(jobId); });
+    return jobId;
+}
+
+// Adds a node under `parent` (-1 = a segment) and starts its request.
+void ActionChain::send(quint64 jobId, int parent, int stage, const QString& text, const QString& trailing)
+{
+    auto jit = m_jobs.find(jobId);
+    if (jit == m_jobs.end())
+        return;
+    Node node;
+    node.stage = stage;
+    node.trailing = trailing;
+    const int idx = int(jit->nodes.size());
+    jit->nodes.append(node);
+    if (parent < 0)
+        jit->roots << idx;
+    else
+        jit->nodes[parent].children << idx;
+
+    if (text.trimmed().isEmpty() || stage >= jit->prompts.size()) {
+        jit->nodes[idx].stage = int(jit->prompts.size()) - 1;  // nothing to do, kept as is
+        jit->nodes[idx].output = text;
+        return;
+    }
+    if (!jit->backend) {
+        fail(jobId, i18n("The backend was replaced before the request finished."));
+        return;
+    }
+    const quint64 requestId = jit->backend->processText(text, jit->prompts[stage], jit->options);
+    // processText may have ended the job already (synchronous failure)
+    jit = m_jobs.find(jobId);
+    if (jit == m_jobs.end())
+        return;
+    jit->requests.insert(requestId, idx);
+    m_owner.insert(requestId, jobId);
+}
+
+// Sends the sentence-complete part of a node's output to the next step;
+// `final` sends the rest too.
+void ActionChain::passOn(quint64 jobId, int idx, bool final)
+{
+    for (;;) {
+        const auto jit = m_jobs.constFind(jobId);
+        if (jit == m_jobs.cend())
+            return;
+        const Node& n = jit->nodes[idx];
+        int sepEnd = 0;
+        const int cut = nextCut(n.stream, n.passed, m_minChunkChars, &sepEnd);
+        if (cut < 0)
+            break;
+        const QString piece = n.stream.mid(n.passed, cut - n.passed);
+        const QString trailing = n.stream.mid(cut, sepEnd - cut);
+        const int stage = n.stage + 1;
+        m_jobs[jobId].nodes[idx].passed = sepEnd;
+        send(jobId, idx, stage, piece, trailing);       // may reallocate nodes
+    }
+    if (!final)
+        return;
+    const auto jit = m_jobs.constFind(jobId);
+    if (jit == m_jobs.cend())
+        return;
+    const Node& n = jit->nodes[idx];
+    const QString rest = n.stream.mid(n.passed).trimmed();
+    const int stage = n.stage + 1;
+    const int end = int(n.stream.size());
+    m_jobs[jobId].nodes[idx].passed = end;
+    if (!rest.isEmpty())
+        send(jobId, idx, stage, rest, QString());
+}
+
+void ActionChain::onPartial(quint64 requestId, const QString& delta)
+{
+    const auto oit = m_owner.constFind(requestId);
+    if (oit == m_owner.cend())
+        return;
+    const quint64 jobId = *oit;
+    Job& job = m_jobs[jobId];
+    const int idx = job.requests.value(requestId, -1);
+    if (idx < 0 || job.nodes[idx].stage == job.prompts.size() - 1)
+        return;                             // the last step is only needed whole
+    Node& n = job.nodes[idx];
+    n.stream += delta;
+    n.streamed = true;
+    passOn(jobId, idx, false);
+}
+
+void ActionChain::onFinished(quint64 requestId, const QString& text)
+{
+    const auto oit = m_owner.constFind(requestId);
+    if (oit == m_owner.cend())
+        return;                             // not ours
+    const quint64 jobId = *oit;
+    m_owner.erase(oit);
+    Job& job = m_jobs[jobId];
+    const int idx = job.requests.take(requestId);
+    Node& n = job.nodes[idx];
+
+    if (n.stage == job.prompts.size() - 1) {
+        n.output = text;
+    } else {
+        // A backend that does not stream delivers everything here.
+        if (!n.streamed)
+            n.stream = text;
+        passOn(jobId, idx, true);
+    }
+    checkDone(jobId);
+}
+
+void ActionChain::onError(quint64 requestId, const QString& errorMsg)
+{
+    const auto oit = m_owner.constFind(requestId);
+    if (oit == m_owner.cend())
+        return;
+    const quint64 jobId = *oit;
+    m_owner.erase(oit);
+    m_jobs[jobId].requests.remove(requestId);
+    fail(jobId, errorMsg);
+}
+
+void ActionChain::fail(quint64 jobId, const QString& errorMsg)
+{
+    const auto jit = m_jobs.find(jobId);
+    if (jit == m_jobs.end())
+        return;
+    const Job job = *jit;
+    m_jobs.erase(jit);
+    // Stop the other steps still running; their errors are no longer ours.
+    for (auto it = job.requests.cbegin(); it != job.requests.cend(); ++it) {
+        m_owner.remove(it.key());
+        if (job.backend)
+            job.backend->cancel(it.key());
+    }
+    Q_EMIT failed(jobId, errorMsg);
+}
+
+void ActionChain::checkDone(quint64 jobId)
+{
+    const auto jit = m_jobs.find(jobId);
+    if (jit == m_jobs.end() || !jit->requests.isEmpty())
+        return;
+    QStringList results;
+    for (int root : std::as_const(jit->roots))
+        results << assemble(*jit, root);
+    m_jobs.erase(jit);
+    Q_EMIT finished(jobId, results);
+}
+
+QString ActionChain::assemble(const Job& job, int idx) const
+{
+    const Node& n = job.nodes[idx];
+    QString out;
+    if (n.stage == job.prompts.size() - 1) {
+        out = n.output;
+    } else {
+        for (int child : n.children)
+            out += assemble(job, child);
+    }
+    return out + n.trailing;
+}
+
+// End of the first sentence (or line) that ends at least `minChars` after
+// `from` and is followed by the start of another one; -1 if none yet.
+// `sepEnd` receives the end of the whitespace after it.
+int ActionChain::nextCut(const QString& s, int from, int minChars, int* sepEnd)
+{
+    static const QString terminators = QStringLiteral(".!?…。！？");
+    static const QString closers = QStringLiteral("\"'»”’)]");
+    for (int i = from + minChars; i < s.size(); ++i) {
+        if (!s[i].isSpace())
+            continue;
+        bool boundary = s[i] == QLatin1Char('\n');
+        if (!boundary) {
+            int j = i - 1;
+            while (j > from && closers.contains(s[j]))
+                --j;
+            boundary = j > from && terminators.contains(s[j]);
+        }
+        if (!boundary)
+            continue;
+        int e = i;
+        while (e < s.size() && s[e].isSpace())
+            ++e;
+        if (e == s.size())
+            return -1;                      // the next sentence has not started yet
+        *sepEnd = e;
+        return i;
+    }
+    return -1;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+#include <QVector>
+
+#include "TextBackend.h"
+
+/**
+ *  Runs an action made of several prompts ("Fix grammar", then "Simplify")
+ *  as a pipeline: while step N streams its output, every finished sentence
+ *  group is sent on to step N+1 at once, so a chain costs about one
+ *  request of latency rather than one per step. The pieces of the last
+ *  step are put back together with the original whitespace between them.
+ *
+ *  Suits edits that work sentence by sentence (grammar, tone, translation);
+ *  a later step sees pieces of the text, not the whole.
+ */
+class ActionChain : public QObject
+{
+Q_OBJECT
+public:
+    explicit ActionChain(QObject* parent = nullptr);
+
+    // The steps of an action prompt: parts separated by a line "---".
+    static QStringList steps(const QString& prompt);
+
+    // Results arrive through `finished` in the order of `segments`.
+    quint64 submit(TextBackend* backend, const QStringList& segments, const QStringList& prompts,
+                   const RequestOptions& options = {});
+
+    // Smallest piece passed on between steps, in characters.
+    void setMinChunkChars(int chars) { m_minChunkChars = qMax(1, chars); }
+
+Q_SIGNALS:
+    void finished(quint64 jobId, const QStringList& results);
+    void failed  (quint64 jobId, const QString& errorMsg);
+
+private:
+    // One request: a piece of text going through one step.
+    struct Node {
+        int         stage = 0;
+        QString     trailing;           // whitespace after the piece in its source
+        QString     stream;             // output so far (steps before the last)
+        int         passed = 0;         // stream characters already sent on
+        bool        streamed = false;
+        QString     output;             // last step only
+        QVector<int> children;          // pieces sent to the next step, in order
+    };
+    struct Job {
+        QPointer<TextBackend> backend;
+        QStringList prompts;
+        RequestOptions options;
+        QVector<Node> nodes;
+        QVector<int>  roots;            // one node per segment
+        QHash<quint64, int> requests;   // backend request id -> node
+    };
+
+    void send(quint64 jobId, int parent, int stage, const QString& text, const QString& trailing);
+    void passOn(quint64 jobId, int node, bool final);
+    void onPartial (quint64 requestId, const QString& delta);
+    void onFinished(quint64 requestId, const QString& text);
+    void onError   (quint64 requestId, const QString& errorMsg);
+    void fail(quint64 jobId, const QString& errorMsg);
+    void checkDone(quint64 jobId);
+    QString assemble(const Job& job, int node) const;
+    static int nextCut(const QString& s, int from, int minChars, int* sepEnd);
+
+    QHash<quint64, Job>     m_jobs;
+    QHash<quint64, quint64> m_owner;    // backend request id -> job
+    quint64 m_lastJobId = 0;
+    int     m_minChunkChars = 160;
+};
@@ -1,5 +1,18 @@
 // --------- src/ActionEditorDialog.cpp ----------
 #include "ActionEditorDialog.h"
+#include "SpellFastPath.h"
+#include <QCheckBox>
+#include <QComboBox>
+#include <QDoubleSpinBox>
+#include <QGroupBox>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QSpinBox>
+#include <QTableWidget>
+#include <QVBoxLayout>
+
+#include <algorithm>
+#include <limits>
 #include <QDialogButtonBox>
 #include <QFormLayout>
 #include <QLineEdit>
@@ -14,7 +27,7 @@ ActionEditorDialog::ActionEditorDialog(QWidget *parent)
         : QDialog(parent)
 {
     setWindowTitle(i18nc("@title:window","Custom Action"));
-    resize(400, 200);
+    resize(520, 560);
 
     auto *lay = new QFormLayout(this);
     lay->setFieldGrowthPolicy(QFormLayout::ExpandingFieldsGrow);
@@ -23,10 +36,91 @@ ActionEditorDialog::ActionEditorDialog(QWidget *parent)
     m_prompt = new QTextEdit(this);
     m_prompt->setAcceptRichText(false);
     m_prompt->setMinimumHeight(80);
+    m_prompt->setToolTip(i18n("Several prompts separated by a line containing only \"---\" "
+                              "run as a chain: each step works on the output of the one before."));
 
     lay->addRow(i18n("Name:"),   m_name);
     lay->addRow(i18n("Prompt:"),    m_prompt);
 
+    m_localSpell = new QCheckBox(i18n("Spelling only: fix plain misspellings locally, without the model"), this);
+    m_localSpell->setToolTip(i18n("Only for actions that fix nothing but spelling. The spell checker "
+                                  "cannot see grammar, punctuation or capitalization: when it can "
+                                  "correct every misspelled word of a short selection, its result "
+                                  "is used as the answer and the model is not asked."));
+    if (!SpellFastPath::isAvailable()) {
+        m_localSpell->setEnabled(false);
+        m_localSpell->setToolTip(i18n("Built without Sonnet spell checking support."));
+    }
+    lay->addRow(QString(), m_localSpell);
+
+    /* --- generation overrides ------------------------------------------ */
+    auto *gen = new QGroupBox(i18n("Generation (empty = global settings)"), this);
+    auto *genLay = new QFormLayout(gen);
+    m_model    = new QLineEdit(gen);
+    m_endpoint = new QLineEdit(gen);
+    m_model->setPlaceholderText(i18n("Default model"));
+    m_endpoint->setPlaceholderText(i18n("Default endpoint"));
+
+    m_temperature = new QDoubleSpinBox(gen);
+    m_temperature->setRange(-0.1, 2.0);      // minimum shows "Default"
+    m_temperature->setSingleStep(0.1);
+    m_temperature->setDecimals(1);
+    m_temperature->setSpecialValueText(i18n("Default"));
+
+    m_maxTokens = new QSpinBox(gen);
+    m_maxTokens->setRange(0, 200000);
+    m_maxTokens->setSpecialValueText(i18n("No limit"));
+
+    m_reasoning = new QComboBox(gen);
+    m_reasoning->addItem(i18n("Default"), QString());
+    m_reasoning->addItem(i18n("Low"),    QStringLiteral("low"));
+    m_reasoning->addItem(i18n("Medium"), QStringLiteral("medium"));
+    m_reasoning->addItem(i18n("High"),   QStringLiteral("high"));
+
+    genLay->addRow(i18n("Model:"),            m_model);
+    genLay->addRow(i18n("Endpoint:"),         m_endpoint);
+    genLay->addRow(i18n("Temperature:"),      m_temperature);
+    genLay->addRow(i18n("Max tokens:"),       m_maxTokens);
+    genLay->addRow(i18n("Reasoning effort:"), m_reasoning);
+
+    m_predict = new QCheckBox(i18n("Send the input as predicted output"), gen);
+    m_predict->setToolTip(i18n("For edits that keep most of the text (grammar, spelling). "
+                               "Servers with predicted outputs (the OpenAI \"prediction\" field) "
+                               "then only generate what changed; others ignore it. "
+                               "The accepted share is shown under Statistics."));
+    genLay->addRow(QString(), m_predict);
+
+    m_patch = new QCheckBox(i18n("Ask for a list of edits instead of the whole text"), gen);
+    m_patch->setToolTip(i18n("For light edits of long texts: the model only writes the changed "
+                             "passages, which are put into the text here. If its answer does not "
+                             "fit the text, the whole text is requested as usual. "
+                             "Not used for chains and multiple ranges."));
+    genLay->addRow(QString(), m_patch);
+    lay->addRow(gen);
+
+    /* --- routing by size ------------------------------------------------- */
+    auto *routing = new QGroupBox(i18n("Routing by text size"), this);
+    auto *routingLay = new QVBoxLayout(routing);
+    m_routes = new QTableWidget(0, 3, routing);
+    m_routes->setHorizontalHeaderLabels({i18n("Up to chars (0 = any)"), i18n("Model"), i18n("Endpoint")});
+    m_routes->horizontalHeader()->setStretchLastSection(true);
+    m_routes->verticalHeader()->hide();
+    m_routes->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_routes->setToolTip(i18n("The first rule whose size limit fits the text decides the model "
+                              "and endpoint, e.g. a small model up to 500 characters and a "
+                              "long-context model for any size."));
+    auto *addBtn = new QPushButton(QIcon::fromTheme(QStringLiteral("list-add")), i18n("Add Rule"), routing);
+    auto *delBtn = new QPushButton(QIcon::fromTheme(QStringLiteral("list-remove")), i18n("Remove Rule"), routing);
+    auto *btnRow = new QHBoxLayout;
+    btnRow->addWidget(addBtn);
+    btnRow->addWidget(delBtn);
+    btnRow->addStretch();
+    routingLay->addWidget(m_routes);
+    routingLay->addLayout(btnRow);
+    lay->addRow(routing);
+    connect(addBtn, &QPushButton::clicked, this, &ActionEditorDialog::addRoute);
+    connect(delBtn, &QPushButton::clicked, this, &ActionEditorDialog::removeRoute);
+
     m_buttons = new QDialogButtonBox(QDialogButtonBox::Ok|QDialogButtonBox::Cancel, this);
     lay->addRow(m_buttons);
     connect(m_buttons, &QDialogButtonBox::accepted, this, &ActionEditorDialog::accept);
@@ -41,12 +135,72 @@ void ActionEditorDialog::setAction(const CustomAction &a)
 {
     m_name->setText(a.name);
     m_prompt->setPlainText(a.prompt);
+    m_localSpell->setChecked(a.localSpellCheck);
+    m_model->setText(a.model);
+    m_endpoint->setText(a.endpoint);
+    m_temperature->setValue(a.temperature < 0 ? m_temperature->minimum() : a.temperature);
+    m_maxTokens->setValue(a.maxTokens);
+    m_reasoning->setCurrentIndex(qMax(0, m_reasoning->findData(a.reasoningEffort)));
+    m_predict->setChecked(a.predictOutput);
+    m_patch->setChecked(a.patchOutput);
+    m_routes->setRowCount(0);
+    for (const auto &r : a.routes)
+        appendRouteRow(r);
     validate();
 }
 
 CustomAction ActionEditorDialog::action() const
 {
-    return {m_name->text().trimmed(), m_prompt->toPlainText().trimmed()};
+    CustomAction a;
+    a.name            = m_name->text().trimmed();
+    a.prompt          = m_prompt->toPlainText().trimmed();
+    a.localSpellCheck = m_localSpell->isChecked();
+    a.model           = m_model->text().trimmed();
+    a.endpoint        = m_endpoint->text().trimmed();
+    a.temperature     = m_temperature->value() < 0 ? -1 : m_temperature->value();
+    a.maxTokens       = m_maxTokens->value();
+    a.reasoningEffort = m_reasoning->currentData().toString();
+    a.predictOutput   = m_predict->isChecked();
+    a.patchOutput     = m_patch->isChecked();
+
+    for (int row = 0; row < m_routes->rowCount(); ++row) {
+        auto cell = [this, row](int col) {
+            const auto *item = m_routes->item(row, col);
+            return item ? item->text().trimmed() : QString();
+        };
+        RoutingRule r{qMax(0, cell(0).toInt()), cell(1), cell(2)};
+        if (!r.model.isEmpty() || !r.endpoint.isEmpty())
+            a.routes << r;
+    }
+    // Size limits ascending, "any size" last.
+    std::stable_sort(a.routes.begin(), a.routes.end(), [](const RoutingRule &x, const RoutingRule &y) {
+        const int kx = x.maxChars > 0 ? x.maxChars : std::numeric_limits<int>::max();
+        const int ky = y.maxChars > 0 ? y.maxChars : std::numeric_limits<int>::max();
+        return kx < ky;
+    });
+    return a;
+}
+
+void ActionEditorDialog::appendRouteRow(const RoutingRule &r)
+{
+    const int row = m_routes->rowCount();
+    m_routes->insertRow(row);
+    m_routes->setItem(row, 0, new QTableWidgetItem(QString::number(r.maxChars)));
+    m_routes->setItem(row, 1, new QTableWidgetItem(r.model));
+    m_routes->setItem(row, 2, new QTableWidgetItem(r.endpoint));
+}
+
+void ActionEditorDialog::addRoute()
+{
+    appendRouteRow(RoutingRule{500, QString(), QString()});
+    m_routes->editItem(m_routes->item(m_routes->rowCount() - 1, 1));
+}
+
+void ActionEditorDialog::removeRoute()
+{
+    const int row = m_routes->currentRow();
+    if (row >= 0)
+        m_routes->removeRow(row);
 }
 
 void ActionEditorDialog::validate()
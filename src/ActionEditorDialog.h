@@ -4,7 +4,12 @@
 #include <QDialogButtonBox>
 #include "ConfigManager.h"
 
+class QCheckBox;
+class QComboBox;
+class QDoubleSpinBox;
 class QLineEdit;
+class QSpinBox;
+class QTableWidget;
 class QTextEdit;
 
 class ActionEditorDialog : public QDialog
@@ -18,9 +23,24 @@ public:
 
 private Q_SLOTS:
     void validate();
+    void addRoute();
+    void removeRoute();
 
 private:
+    void appendRouteRow(const RoutingRule &r);
+
     QDialogButtonBox *m_buttons{nullptr};   // <- keep a pointer
     QLineEdit *m_name;
     QTextEdit *m_prompt;
+    QCheckBox *m_localSpell;
+
+    /* --- генерация ---*/
+    QLineEdit      *m_model;
+    QLineEdit      *m_endpoint;
+    QDoubleSpinBox *m_temperature;
+    QSpinBox       *m_maxTokens;
+    QComboBox      *m_reasoning;
+    QCheckBox      *m_predict;
+    QCheckBox      *m_patch;
+    QTableWidget   *m_routes;
 };
@@ -1,4 +1,5 @@
 #include "ApiClient.h"
+#include "LocalHttp.h"
 
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -14,34 +15,59 @@ ApiClient::ApiClient(const QString& key,
                      const QString& model,
                      const QString &systemPrompt,
                      QObject* parent)
-        : QObject(parent)
+        : TextBackend(parent)
         , m_apiKey(key)
         , m_apiUrl(QUrl(endpoint))
         , m_model(model)
         , m_systemPrompt(systemPrompt)
 {
-    m_net = new QNetworkAccessManager(this);
+    if (LocalHttpClient::isLocalUrl(m_apiUrl))
+        m_local = new LocalHttpClient(this);
+    else
+        m_net = new QNetworkAccessManager(this);
 }
 
-QString ApiClient::defaultSystemPrompt()
+void ApiClient::setGenerationSettings(const QString& model, const QString& systemPrompt)
 {
-    return u"You are an AI text editor. "
-           "Strictly follow the instructions. "
-           "Return ONLY the modified text—no explanations, pre-/post-amble."_qs;
+    m_model = model;
+    m_systemPrompt = systemPrompt;
 }
 
-void ApiClient::processText(const QString& text, const QString& userPrompt)
+void ApiClient::cancel(quint64 requestId)
 {
-    QString finalPrompt =  userPrompt + QStringLiteral("\n") + QStringLiteral("\n") + text;
+    const auto it = m_pending.constFind(requestId);
+    if (it == m_pending.cend())
+        return;
+    // finished follows with OperationCanceledError / LocalHttpReply::OperationCanceled
+    if (it->reply)
+        it->reply->abort();
+    else if (it->local)
+        it->local->abort();
+}
 
-    QNetworkRequest req(m_apiUrl);
-    req.setHeader(QNetworkRequest::ContentTypeHeader,
-                  QStringLiteral("application/json"));
-    req.setRawHeader("Authorization",
-                     "Bearer " + m_apiKey.toUtf8());
+quint64 ApiClient::processText(const QString& text, const QString& userPrompt,
+                               const RequestOptions& options)
+{
+    return send(userMessage(text, userPrompt), options, false,
+                options.predictInput ? text : QString());
+}
+
+// A one-token completion with the real system prompt: loads the model on
+// Ollama-style servers and primes the prompt cache of llama.cpp/vLLM.
+quint64 ApiClient::warmUp()
+{
+    RequestOptions options;
+    options.maxTokens = 1;
+    return send(QStringLiteral("ping"), options, true);
+}
+
+quint64 ApiClient::send(const QString& userContent, const RequestOptions& options, bool warmUp,
+                        const QString& prediction)
+{
+    const quint64 id = startRequest();
 
     QJsonObject root;
-    root.insert(QStringLiteral("model"), m_model);
+    root.insert(QStringLiteral("model"), options.model.isEmpty() ? m_model : options.model);
 
     QJsonArray messages;
     messages.append(QJsonObject{
@@ -51,45 +77,221 @@ void ApiClient::processText(const QString& text, const QString& userPrompt)
     });
     messages.append(QJsonObject{
             {QStringLiteral("role"),    QStringLiteral("user")},
-            {QStringLiteral("content"),  finalPrompt}
+            {QStringLiteral("content"),  userContent}
     });
     root.insert(QStringLiteral("messages"), messages);
+    if (options.maxTokens > 0)
+        root.insert(QStringLiteral("max_tokens"), options.maxTokens);
+    if (options.temperature >= 0)
+        root.insert(QStringLiteral("temperature"), options.temperature);
+    if (!options.reasoningEffort.isEmpty())
+        root.insert(QStringLiteral("reasoning_effort"), options.reasoningEffort);
+    // Edits keep most of the input: servers with predicted outputs verify
+    // the input in large steps instead of generating it token by token.
+    if (!prediction.isEmpty())
+        root.insert(QStringLiteral("prediction"),
+                    QJsonObject{{QStringLiteral("type"),    QStringLiteral("content")},
+                                {QStringLiteral("content"), prediction}});
+    if (!warmUp) {
+        root.insert(QStringLiteral("stream"), true);
+        root.insert(QStringLiteral("stream_options"),
+                    QJsonObject{{QStringLiteral("include_usage"), true}});
+    }
+    const QByteArray body = QJsonDocument(root).toJson(QJsonDocument::Compact);
 
-    auto* r = m_net->post(req, QJsonDocument(root).toJson());
-    connect(r, &QNetworkReply::finished,
-            this, [this, r]{ handleNetworkReply(r); });
+    Pending& p = m_pending[id];
+    p.warmUp = warmUp;
+    p.model  = root.value(QStringLiteral("model")).toString();
+    p.label  = options.label;
+    p.predicted = !prediction.isEmpty();
+    p.timer.start();
+
+    if (m_local) {
+        auto* lr = m_local->post(m_apiUrl,
+                                 {{"Content-Type", "application/json"},
+                                  {"Authorization", "Bearer " + m_apiKey.toUtf8()}},
+                                 body);
+        p.local = lr;
+        connect(lr, &LocalHttpReply::readyRead, this, [this, lr, id]{ onData(id, lr->readAll()); });
+        connect(lr, &LocalHttpReply::finished, this, [this, lr, id]{
+            lr->deleteLater();
+            onData(id, lr->readAll());
+            if (lr->error() == LocalHttpReply::NoError && lr->statusCode() >= 400)
+                complete(id, i18n("server replied with HTTP status %1", lr->statusCode()), false);
+            else
+                complete(id, lr->error() == LocalHttpReply::NoError ? QString() : lr->errorString(),
+                         lr->error() == LocalHttpReply::OperationCanceled);
+        });
+        return id;
+    }
+
+    QNetworkRequest req(m_apiUrl);
+    req.setHeader(QNetworkRequest::ContentTypeHeader,
+                  QStringLiteral("application/json"));
+    req.setRawHeader("Authorization",
+                     "Bearer " + m_apiKey.toUtf8());
+
+    auto* r = m_net->post(req, body);
+    p.reply = r;
+    connect(r, &QNetworkReply::readyRead, this, [this, r, id]{ onData(id, r->readAll()); });
+    connect(r, &QNetworkReply::finished, this, [this, r, id]{
+        r->deleteLater();
+        onData(id, r->readAll());
+        complete(id, r->error() == QNetworkReply::NoError ? QString() : r->errorString(),
+                 r->error() == QNetworkReply::OperationCanceledError);
+    });
+    return id;
 }
 
-void ApiClient::handleNetworkReply(QNetworkReply* reply)
+void ApiClient::onData(quint64 requestId, const QByteArray& data)
 {
-    reply->deleteLater();
-
-    if (reply->error() != QNetworkReply::NoError) {
-        Q_EMIT processingError(
-                i18n("Network error: %1", reply->errorString()));
+    const auto it = m_pending.find(requestId);
+    if (it == m_pending.end() || data.isEmpty())
         return;
+    it->buf += data;
+    if (!it->detected) {
+        const QByteArray head = it->buf.trimmed();
+        if (head.isEmpty())
+            return;
+        it->detected = true;
+        it->sse = !head.startsWith('{');        // the server ignored "stream"
     }
+    if (!it->sse)
+        return;
+    // Emitted after parsing: a receiver may cancel and so end the request.
+    const QStringList deltas = parseEvents(*it, false);
+    for (const QString& d : deltas)
+        Q_EMIT partialResult(requestId, d);
+}
 
-    const auto doc = QJsonDocument::fromJson(reply->readAll());
+// Consumes the complete "data:" lines of an SSE body; returns the content
+// deltas. `flush` also takes a last line without newline.
+QStringList ApiClient::parseEvents(Pending& p, bool flush)
+{
+    QStringList deltas;
+    if (flush && !p.buf.endsWith('\n'))
+        p.buf += '\n';
+    qsizetype pos = 0;
+    for (qsizetype nl; (nl = p.buf.indexOf('\n', pos)) >= 0; pos = nl + 1) {
+        const QByteArray line = p.buf.mid(pos, nl - pos).trimmed();
+        if (!line.startsWith("data:"))
+            continue;                           // blank separators, comments, "event:"
+        const QByteArray data = line.mid(5).trimmed();
+        if (data == "[DONE]")
+            continue;
+        const QJsonObject obj = QJsonDocument::fromJson(data).object();
+        if (const QJsonValue err = obj.value(QStringLiteral("error")); !err.isUndefined()) {
+            p.streamError = err.isObject() ? err.toObject().value(QStringLiteral("message")).toString()
+                                           : err.toVariant().toString();
+            continue;
+        }
+        const QJsonObject usage = obj.value(QStringLiteral("usage")).toObject();
+        if (!usage.isEmpty())
+            readUsage(p, usage);
+        const QJsonArray choices = obj.value(QStringLiteral("choices")).toArray();
+        if (choices.isEmpty())
+            continue;
+        const QString delta = choices.first().toObject()
+                .value(QStringLiteral("delta")).toObject()
+                .value(QStringLiteral("content")).toString();
+        if (delta.isEmpty())
+            continue;
+        if (p.ttftMs < 0)
+            p.ttftMs = p.timer.elapsed();
+        ++p.chunks;
+        p.text += delta;
+        deltas << delta;
+    }
+    p.buf.remove(0, pos);
+    return deltas;
+}
+
+// Plain (non-streamed) chat completion.
+bool ApiClient::parseJsonBody(Pending& p, QString* error)
+{
+    const auto doc = QJsonDocument::fromJson(p.buf);
     if (!doc.isObject()) {
-        Q_EMIT processingError(i18n("Malformed JSON in reply."));
-        return;
+        *error = i18n("Malformed JSON in reply.");
+        return false;
     }
 
     const auto obj = doc.object();
     const auto choices = obj.value(QStringLiteral("choices")).toArray();
     if (choices.isEmpty()) {
-        Q_EMIT processingError(i18n("No choices in reply."));
-        return;
+        *error = i18n("No choices in reply.");
+        return false;
     }
 
-    const auto msg = choices.first().toObject()
+    p.text = choices.first().toObject()
             .value(QStringLiteral("message")).toObject()
             .value(QStringLiteral("content")).toString();
-    if (msg.isEmpty()) {
-        Q_EMIT processingError(i18n("Empty content in reply."));
+    readUsage(p, obj.value(QStringLiteral("usage")).toObject());
+    return true;
+}
+
+void ApiClient::readUsage(Pending& p, const QJsonObject& usage)
+{
+    p.promptTokens     = usage.value(QStringLiteral("prompt_tokens")).toInt(-1);
+    p.completionTokens = usage.value(QStringLiteral("completion_tokens")).toInt(-1);
+    const QJsonObject details = usage.value(QStringLiteral("completion_tokens_details")).toObject();
+    p.acceptedPrediction = details.value(QStringLiteral("accepted_prediction_tokens")).toInt(-1);
+    p.rejectedPrediction = details.value(QStringLiteral("rejected_prediction_tokens")).toInt(-1);
+}
+
+void ApiClient::complete(quint64 requestId, const QString& networkError, bool cancelled)
+{
+    const auto it = m_pending.find(requestId);
+    if (it == m_pending.end())
+        return;
+    Pending p = std::move(*it);
+    m_pending.erase(it);
+
+    if (cancelled) {
+        failRequest(requestId, i18n("Request cancelled."));
+        return;
+    }
+    if (!networkError.isEmpty()) {
+        failRequest(requestId,
+                i18n("Network error: %1", networkError));
+        return;
+    }
+    if (p.warmUp) {             // any successful reply means the model is loaded
+        finishRequest(requestId, QString());
+        return;
+    }
+
+    if (p.sse) {
+        for (const QString& d : parseEvents(p, true))
+            Q_EMIT partialResult(requestId, d);
+        if (!p.streamError.isEmpty()) {
+            failRequest(requestId, i18n("Server error: %1", p.streamError));
+            return;
+        }
+        if (p.completionTokens < 0 && p.chunks > 0)
+            p.completionTokens = p.chunks;      // servers send about a token per event
+    } else {
+        QString error;
+        if (!parseJsonBody(p, &error)) {
+            failRequest(requestId, error);
+            return;
+        }
+    }
+    if (p.text.isEmpty()) {
+        failRequest(requestId, i18n("Empty content in reply."));
         return;
     }
 
-    Q_EMIT processingFinished(msg.trimmed());
+    RequestMetrics metrics;
+    metrics.endpoint         = m_apiUrl.toString(QUrl::RemoveUserInfo);
+    metrics.model            = p.model;
+    metrics.label            = p.label;
+    metrics.promptTokens     = p.promptTokens;
+    metrics.completionTokens = p.completionTokens;
+    metrics.ttftMs           = p.ttftMs;
+    metrics.totalMs          = p.timer.elapsed();
+    metrics.predicted        = p.predicted;
+    metrics.acceptedPredictionTokens = p.acceptedPrediction;
+    metrics.rejectedPredictionTokens = p.rejectedPrediction;
+    Q_EMIT requestMetrics(requestId, metrics);
+    finishRequest(requestId, p.text.trimmed());
 }
@@ -1,16 +1,25 @@
 #pragma once
-#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QString>
 #include <QUrl>
 
+#include "TextBackend.h"
+
 class QNetworkAccessManager;
 class QNetworkReply;
+class LocalHttpClient;
+class LocalHttpReply;
+class QJsonObject;
 
 /**
  *  Простая тонкая обёртка над Chat-completion API.
  *  Передаём текст и готовый user-prompt в `processText`.
+ *  Replies are requested as a stream (SSE) for `partialResult` and the time
+ *  to first token; servers that ignore `stream` answer with plain JSON,
+ *  which is handled the same way.
  */
-class ApiClient : public QObject
+class ApiClient : public TextBackend
 {
 Q_OBJECT
 public:
@@ -21,21 +30,48 @@ public:
                        QObject* parent = nullptr);
     ~ApiClient() override = default;
 
-    void processText(const QString& text, const QString& userPrompt);
+    quint64 processText(const QString& text, const QString& userPrompt,
+                        const RequestOptions& options = {}) override;
+    quint64 warmUp() override;
+    void setGenerationSettings(const QString& model, const QString& systemPrompt) override;
+    void cancel(quint64 requestId) override;
 
-Q_SIGNALS:
-    void processingFinished(const QString& resultText);
-    void processingError   (const QString& errorMsg);
+private:
+    struct Pending {
+        QNetworkReply*  reply = nullptr;
+        LocalHttpReply* local = nullptr;
+        bool          warmUp = false;
+        QElapsedTimer timer;
+        QString       model;
+        QString       label;
+        QByteArray    buf;              // body bytes not parsed yet
+        bool          detected = false; // SSE or JSON known
+        bool          sse = false;
+        QString       text;             // streamed content so far
+        int           chunks = 0;       // content events, ~ tokens
+        qint64        ttftMs = -1;
+        int           promptTokens = -1;
+        int           completionTokens = -1;
+        bool          predicted = false;
+        int           acceptedPrediction = -1;
+        int           rejectedPrediction = -1;
+        QString       streamError;
+    };
 
-private Q_SLOTS:
-    void handleNetworkReply(QNetworkReply* reply);
+    quint64 send(const QString& userContent, const RequestOptions& options, bool warmUp,
+                 const QString& prediction = QString());
+    void onData(quint64 requestId, const QByteArray& data);
+    QStringList parseEvents(Pending& p, bool flush);
+    void complete(quint64 requestId, const QString& networkError, bool cancelled);
+    bool parseJsonBody(Pending& p, QString* error);
+    static void readUsage(Pending& p, const QJsonObject& usage);
 
-private:
     QString m_apiKey;
     QUrl    m_apiUrl;
     QString m_model;
     QNetworkAccessManager* m_net{nullptr};
+    LocalHttpClient* m_local{nullptr};          // unix:// endpoints
+    QHash<quint64, Pending> m_pending;          // requests in flight
 
     QString m_systemPrompt;
-    static QString defaultSystemPrompt();   // keeps the old literal
 };
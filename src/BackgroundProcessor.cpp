@@ -1,13 +1,85 @@
 #include "BackgroundProcessor.h"
+#include "ApiClient.h"
+#include "EditPatch.h"
+#include "LlamaClient.h"
+#include "RequestScheduler.h"
+#include "StartupProfiler.h"
 
 #include <QApplication>
 #include <QAction>
 #include <QCursor>
+#include <QDateTime>
 #include <QTimer>
 #include <QRegularExpression>
 #include <QStandardPaths>
 #include <QDebug>
 
+#include <utility>
+
+// Ollama unloads a model after 5 idle minutes by default; a request after
+// such a pause is counted as a cold one.
+static constexpr qint64 kColdAfterMs = 5 * 60 * 1000;
+
+// AT-SPI and the backend are brought up this long after login instead of
+// competing with the rest of the session start; a shortcut press before that
+// initializes them on the spot.
+static constexpr int kDeferredInitMs = 3000;
+
+// Requests running at once per endpoint (RequestScheduler adds one slot for
+// interactive edits over HTTP). llama.cpp runs one generation at a time, so
+// there it has no spare slot.
+static constexpr int kHttpConcurrency  = 4;
+static constexpr int kLlamaConcurrency = 1;
+
+// A selection unchanged this long is worth a precompute run; larger ones
+// are left to the shortcut.
+static constexpr int kPrecomputeDebounceMs = 1500;
+static constexpr int kPrecomputeMaxChars = 8000;
+
+namespace {
+
+struct Route {
+    QString        endpoint;        // empty = the configured one
+    RequestOptions options;
+};
+
+// Action overrides, then the first size rule that fits.
+Route routeFor(const CustomAction& a, qsizetype chars)
+{
+    Route r;
+    r.endpoint                = a.endpoint;
+    r.options.model           = a.model;
+    r.options.temperature     = a.temperature;
+    r.options.maxTokens       = a.maxTokens;
+    r.options.reasoningEffort = a.reasoningEffort;
+    r.options.label           = a.name;
+    r.options.predictInput    = a.predictOutput;
+    for (const auto& rule : a.routes) {
+        if (rule.maxChars > 0 && chars > rule.maxChars)
+            continue;
+        if (!rule.model.isEmpty())
+            r.options.model = rule.model;
+        if (!rule.endpoint.isEmpty())
+            r.endpoint = rule.endpoint;
+        break;
+    }
+    return r;
+}
+
+// Identifies the results that can be reused for `a` with these settings.
+quint64 cacheKeyFor(const ConfigSnapshot& cfg, const CustomAction& a, const Route& route)
+{
+    const bool local = cfg.backend == ConfigManager::Backend::Llama;
+    const QString modelId = local ? cfg.localModelPath
+                                  : (route.endpoint.isEmpty() ? cfg.endpoint : route.endpoint)
+                                    + QLatin1Char('\n')
+                                    + (route.options.model.isEmpty() ? cfg.model : route.options.model);
+    return NearDuplicateCache::actionKey(a.prompt + QLatin1Char('\n') + route.options.reasoningEffort,
+                                         modelId, cfg.systemPrompt);
+}
+
+} // namespace
+
 #ifdef HAVE_KNOTIFICATIONS
 #include <KNotification>
 #include <QSystemTrayIcon>
@@ -18,18 +90,41 @@
 BackgroundProcessor::BackgroundProcessor(ConfigManager* cfg, QObject* parent)
         : QObject(parent)
         , m_cfg(cfg)
+        , m_config(cfg->snapshot())
         , m_clip(QApplication::clipboard())
-        , m_menu(new QMenu)
         , m_a11y(this)
 {
-    createActionMenu();
-    connect(m_cfg, &ConfigManager::configChanged,
-            this,   &BackgroundProcessor::createActionMenu);
-    // update api client
     connect(m_cfg, &ConfigManager::configChanged,
-            this,   &BackgroundProcessor::setupApiClient);
-    QTimer::singleShot(0, this, &BackgroundProcessor::initialize);
-
+            this,   &BackgroundProcessor::onConfigChanged);
+    connect(&m_keepAlive, &QTimer::timeout,
+            this,   &BackgroundProcessor::onKeepAliveTimeout);
+    connect(&m_coalescer, &RequestCoalescer::finished,
+            this,   &BackgroundProcessor::handleRangeResults);
+    connect(&m_coalescer, &RequestCoalescer::failed,
+            this,   &BackgroundProcessor::handleRangeError);
+    connect(&m_chain, &ActionChain::finished,
+            this,   &BackgroundProcessor::handleChainResults);
+    connect(&m_chain, &ActionChain::failed,
+            this,   &BackgroundProcessor::handleChainError);
+    connect(&m_a11y, &AccessibilityHelper::selectionChanged,
+            this,   &BackgroundProcessor::onSelectionChanged);
+    m_precomputeTimer.setSingleShot(true);
+    m_precomputeTimer.setInterval(kPrecomputeDebounceMs);
+    connect(&m_precomputeTimer, &QTimer::timeout,
+            this,   &BackgroundProcessor::runPrecompute);
+    connect(&m_paste, &PasteInjector::finished, this, [this](bool ok) {
+        if (ok)
+            notify(i18n("Done"), i18n("Text was replaced."), false);
+        else if (m_paste.focusLost())
+            notify(i18n("Result copied"),
+                   i18n("The field lost the focus before the result was ready; the result is in the clipboard."),
+                   false);
+        else
+            notify(i18n("Result copied"),
+                   i18n("Pasting into the application did not work; the result is in the clipboard."),
+                   false);
+    });
+    QTimer::singleShot(kDeferredInitMs, this, &BackgroundProcessor::initialize);
 }
 
 BackgroundProcessor::~BackgroundProcessor()
@@ -39,90 +134,502 @@ BackgroundProcessor::~BackgroundProcessor()
 
 void BackgroundProcessor::initialize()
 {
+    if (m_initialized)
+        return;
+    m_initialized = true;
+    m_journal.open();
+    m_metrics.load();
+    m_recorder.openFromEnvironment();
 #ifdef HAVE_ATSPI
     m_a11y.initialize();
+    StartupProfiler::mark("AT-SPI listener");
 #endif
-    setupApiClient();
+    // Without warm-up the network stack is only created for the first request.
+    if (m_config->warmUpEnabled || m_config->keepAliveMinutes > 0) {
+        setupApiClient();       // also sends the initial warm-up
+        StartupProfiler::mark("backend");
+    }
+    setupKeepAlive();
+    setupPrecompute();
+    StartupProfiler::finish("deferred initialization");
+}
+
+void BackgroundProcessor::onConfigChanged(ConfigManager::Fields changed)
+{
+    m_config = m_cfg->snapshot();
+
+    // Only rebuild what has already been created, and only what changed.
+    if (m_menu && (changed & ConfigManager::ActionsField))
+        createActionMenu();
+    if (m_api) {
+        if (changed & ConfigManager::connectionFields()) {
+            setupApiClient();
+        } else if (changed & (ConfigManager::ModelField | ConfigManager::SystemPromptField)) {
+            // same endpoint: keep the client and its warm connections
+            m_api->setGenerationSettings(m_config->model, m_config->systemPrompt);
+            for (TextBackend* b : std::as_const(m_routeBackends))
+                b->setGenerationSettings(m_config->model, m_config->systemPrompt);
+            if (m_config->warmUpEnabled)
+                warmUpBackend();
+        }
+    }
+    if (m_initialized && (changed & ConfigManager::WarmUpField))
+        setupKeepAlive();
+    if (m_initialized && (changed & ConfigManager::PrecomputeField))
+        setupPrecompute();
+}
+
+// Let requests in flight finish with the settings they started with.
+void BackgroundProcessor::retireBackend(TextBackend* old)
+{
+    if (old->requestsInFlight() > 0)
+        connect(old, &TextBackend::idle, old, &QObject::deleteLater);
+    else
+        old->deleteLater();
+}
+
+// HTTP client for an action's own endpoint, created on first use and kept
+// until the connection settings change. The local backend has no endpoints.
+TextBackend* BackgroundProcessor::backendFor(const QString& endpoint)
+{
+    if (endpoint.isEmpty() || endpoint == m_config->endpoint
+        || m_config->backend == ConfigManager::Backend::Llama)
+        return m_api;
+    TextBackend*& b = m_routeBackends[endpoint];
+    if (!b) {
+        b = new RequestScheduler(new ApiClient(m_config->apiKey, endpoint, m_config->model,
+                                               m_config->systemPrompt),
+                                 kHttpConcurrency, this);
+        connect(b, &TextBackend::processingFinished,
+                this, &BackgroundProcessor::handleResult);
+        connect(b, &TextBackend::processingError,
+                this, &BackgroundProcessor::handleError);
+        connect(b, &TextBackend::requestMetrics,
+                &m_metrics, [this](quint64 id, const RequestMetrics& m) {
+                    m_metrics.record(m);
+                    if (id != m_precomputeId)
+                        m_recorder.request(m);
+                });
+    }
+    return b;
 }
 
 void BackgroundProcessor::setupApiClient()
 {
-    // free old client
+    // retire old clients
     if (m_api) {
-        m_api->deleteLater();
+        retireBackend(m_api);
         m_api = nullptr;
     }
-    m_api = new ApiClient(m_cfg->apiKey(),
-                          m_cfg->apiEndpoint(),
-                          m_cfg->model(),
-                          m_cfg->systemPrompt(),
-                          this);
-    connect(m_api, &ApiClient::processingFinished,
+    for (TextBackend* b : std::as_const(m_routeBackends))
+        retireBackend(b);
+    m_routeBackends.clear();
+    if (m_config->backend == ConfigManager::Backend::Llama) {
+        auto* s = new RequestScheduler(new LlamaClient(m_config->localModelPath,
+                                                       m_config->systemPrompt,
+                                                       m_config->localThreads,
+                                                       m_config->localContextSize),
+                                       kLlamaConcurrency, this);
+        s->setSpareInteractiveSlot(false);
+        m_api = s;
+    } else
+        m_api = new RequestScheduler(new ApiClient(m_config->apiKey,
+                                                   m_config->endpoint,
+                                                   m_config->model,
+                                                   m_config->systemPrompt),
+                                     kHttpConcurrency, this);
+    connect(m_api, &TextBackend::processingFinished,
             this, &BackgroundProcessor::handleResult);
-    connect(m_api, &ApiClient::processingError,
+    connect(m_api, &TextBackend::processingError,
             this, &BackgroundProcessor::handleError);
+    connect(m_api, &TextBackend::requestMetrics,
+            &m_metrics, [this](quint64 id, const RequestMetrics& m) {
+                    m_metrics.record(m);
+                    if (id != m_precomputeId)
+                        m_recorder.request(m);
+                });
+
+    m_warmUpId = 0;
+    m_lastBackendUse.invalidate();
+    if (m_config->warmUpEnabled)
+        warmUpBackend();
+}
+
+void BackgroundProcessor::setupKeepAlive()
+{
+    const int minutes = m_config->keepAliveMinutes;
+    if (minutes <= 0) {
+        m_keepAlive.stop();
+        return;
+    }
+    m_keepAlive.start(minutes * 60 * 1000);
+}
+
+void BackgroundProcessor::warmUpBackend()
+{
+    if (!m_api || m_warmUpId)
+        return;
+    m_warmUpTimer.start();
+    m_warmUpId = m_api->warmUp();
+}
+
+void BackgroundProcessor::onKeepAliveTimeout()
+{
+    // Only ping when nothing else has touched the backend for a full period.
+    if (m_processing)
+        return;
+    if (m_lastBackendUse.isValid()
+        && m_lastBackendUse.elapsed() < m_keepAlive.interval())
+        return;
+    warmUpBackend();
+}
+
+void BackgroundProcessor::setupPrecompute()
+{
+    const int perHour = m_config->precomputePerHour;
+    m_precompute.setPerHour(perHour);
+    m_a11y.setSelectionTracking(perHour > 0);
+    if (perHour <= 0) {
+        m_precomputeTimer.stop();
+        cancelPrecompute();
+    }
+}
+
+// Restarts the wait on every change; the run goes out once it settles.
+void BackgroundProcessor::onSelectionChanged()
+{
+    if (m_precompute.perHour() > 0)
+        m_precomputeTimer.start();
+}
+
+void BackgroundProcessor::runPrecompute()
+{
+    if (m_precompute.perHour() <= 0 || m_processing || m_capture.active || m_paste.isBusy()
+        || m_config->actions.isEmpty())
+        return;
+#ifdef HAVE_ATSPI
+    if (!m_a11y.isInitialized() || m_a11y.focusedApplicationIsSlow())
+        return;
+    const ElementInfo info = m_a11y.getFocusedElementInfo();
+    if (!info.isValid || !info.wasSelection || info.ranges.size() > 1
+        || info.text.trimmed().isEmpty() || info.text.size() > kPrecomputeMaxChars)
+        return;
+    // The first action is the default one, at the top of the menu. Chains
+    // and texts the spell checker fixes locally are not worth a request.
+    const CustomAction& action = m_config->actions.first();
+    if (ActionChain::steps(action.prompt).size() > 1
+        || (action.localSpellCheck && m_spell.tryCorrect(info.text)))
+        return;
+    const Route route = routeFor(action, info.text.size());
+    const quint64 key = cacheKeyFor(*m_config, action, route);
+    if (m_precompute.covers(key, info.text))
+        return;                             // done or running already
+    if (!m_precompute.spend()) {
+        qDebug() << "Precompute budget used up";
+        return;
+    }
+    cancelPrecompute();                     // a run on the previous selection
+    if (!m_api)
+        setupApiClient();
+    RequestOptions options = route.options;
+    options.priority = RequestOptions::Priority::Speculative;
+    m_precomputeBackend = backendFor(route.endpoint);
+    m_precomputeKey = key;
+    m_precomputeText = info.text;
+    m_precompute.started(key, info.text);
+    m_precomputeId = m_precomputeBackend->processText(info.text, action.prompt, options);
+#endif
+}
+
+void BackgroundProcessor::cancelPrecompute()
+{
+    if (!m_precomputeId)
+        return;
+    const quint64 id = std::exchange(m_precomputeId, 0);
+    m_precompute.discard();
+    if (m_precomputeBackend)
+        m_precomputeBackend->cancel(id);    // its error is ignored, the id is gone
+}
+
+bool BackgroundProcessor::backendIsCold() const
+{
+    return m_warmUpId != 0          // still loading, the request queues behind it
+           || !m_lastBackendUse.isValid()
+           || m_lastBackendUse.elapsed() > kColdAfterMs;
 }
 
 void BackgroundProcessor::createActionMenu()
 {
+    if (!m_menu) {
+        m_menu = new QMenu;
+        connect(m_menu, &QMenu::triggered,
+                this,  &BackgroundProcessor::onActionSelected);
+    }
     m_menu->clear();
-    for (int i = 0; i < m_cfg->actions().size(); ++i) {
-        const auto& a = m_cfg->actions()[i];
+    const auto& actions = m_config->actions;
+    for (int i = 0; i < actions.size(); ++i) {
+        const auto& a = actions[i];
         auto* act = m_menu->addAction(a.name);
         act->setData(i);
     }
-    connect(m_menu, &QMenu::triggered,
-            this,  &BackgroundProcessor::onActionSelected);
 }
 
 void BackgroundProcessor::onShortcutActivated()
 {
-    if (m_processing) return;
+    if (m_processing || m_capture.active || m_paste.isBusy()) return;
+    initialize();
     m_target = ElementInfo();
 
+    // With a helper tool the selection owners are asked in the background
+    // while AT-SPI is queried, so a busy owner costs nothing when AT-SPI has
+    // the text. Without one the read blocks: it waits for AT-SPI to fail.
+    m_capture = Capture();
+    m_capture.active = true;
+    const bool background = ClipboardReader::readsInBackground();
+    if (background)
+        startClipboardReaders();
+
 #ifdef HAVE_ATSPI
-    if (m_a11y.isInitialized())
+    // A slow application would keep the user waiting on D-Bus: its
+    // selection is read instead and the result goes to the clipboard.
+    if (m_a11y.isInitialized() && !m_a11y.focusedApplicationIsSlow())
         m_target = m_a11y.getFocusedElementInfo();
+    else if (m_a11y.isInitialized())
+        qInfo() << "AT-SPI skipped for slow application" << m_a11y.focusedApplication();
 #endif
-    if (!m_target.isValid || m_target.text.trimmed().isEmpty())
-        m_target.text = m_clip->text(QClipboard::Selection).trimmed();
-    if (m_target.text.isEmpty())
-        m_target.text = m_clip->text().trimmed();
+    if (m_target.isValid && !m_target.text.trimmed().isEmpty())
+        finishCapture(QString());
+    else if (!background)
+        startClipboardReaders();
+}
+
+void BackgroundProcessor::startClipboardReaders()
+{
+    for (auto mode : {QClipboard::Selection, QClipboard::Clipboard}) {
+        auto* reader = new ClipboardReader(mode, this);
+        connect(reader, &ClipboardReader::finished,
+                this,   &BackgroundProcessor::onClipboardRead);
+        (mode == QClipboard::Selection ? m_capture.primary : m_capture.clipboard) = reader;
+        reader->start();
+    }
+}
+
+void BackgroundProcessor::onClipboardRead(QClipboard::Mode mode, const QString& text)
+{
+    if (!m_capture.active)
+        return;
+    if (mode == QClipboard::Selection) {
+        m_capture.primaryDone = true;
+        m_capture.primaryText = text.trimmed();
+    } else {
+        m_capture.clipboardDone = true;
+        m_capture.clipboardText = text.trimmed();
+    }
+    // The primary selection wins; the clipboard only once it is known empty.
+    if (m_capture.primaryDone && !m_capture.primaryText.isEmpty())
+        finishCapture(m_capture.primaryText);
+    else if (m_capture.primaryDone && m_capture.clipboardDone)
+        finishCapture(m_capture.clipboardText);
+}
+
+void BackgroundProcessor::finishCapture(const QString& fallbackText)
+{
+    m_capture.active = false;
+    for (auto* reader : {m_capture.primary.data(), m_capture.clipboard.data()})
+        if (reader)
+            reader->cancel();
 
+    if (!m_target.isValid || m_target.text.trimmed().isEmpty())
+        m_target.text = fallbackText;
     if (m_target.text.isEmpty()) {
         notify(i18n("Nothing to process"),
                i18n("No text was found in focus or clipboard."),
                false);
         return;
     }
+    if (!m_menu)
+        createActionMenu();
     m_menu->popup(QCursor::pos());
 }
 
 void BackgroundProcessor::onActionSelected(QAction* act)
 {
     const int idx = act->data().toInt();
-    if (idx < 0 || idx >= m_cfg->actions().size())
+    if (idx < 0 || idx >= m_config->actions.size())
         return;
 
-    m_currentPrompt = m_cfg->actions()[idx].prompt;
+    m_jobConfig = m_config;
+    const CustomAction& action = m_jobConfig->actions[idx];
+    m_currentPrompt = action.prompt;
+    m_currentAction = action.name;
+    const QStringList steps = ActionChain::steps(action.prompt);
+    m_recorder.begin(action.name, int(m_target.text.size()), int(qMax<qsizetype>(1, m_target.ranges.size())),
+                     int(action.prompt.size()), int(steps.size()));
+
+    // A spell fix alone would skip the later steps of a chain.
+    if (action.localSpellCheck && steps.size() == 1 && m_target.ranges.size() <= 1) {
+        QElapsedTimer t;
+        t.start();
+        if (const auto fixed = m_spell.tryCorrect(m_target.text)) {
+            m_stats.recordLocalHit(t.elapsed());
+            m_recorder.finish(QStringLiteral("spell"), int(fixed->size()), true);
+            applyResult(*fixed);
+            return;
+        }
+        m_stats.recordLocalMiss();
+    }
+
+    const Route route = routeFor(action, m_target.text.size());
+    m_cacheKey = cacheKeyFor(*m_jobConfig, action, route);
+    // A precompute run on this selection left its result in the caches,
+    // or is still on its way.
+    const bool precomputed = m_precompute.claim(m_cacheKey, m_target.text);
+    m_plan.reset();
+    if (m_target.ranges.size() <= 1) {
+        // Whole input seen before (or nearly), else paragraphs seen before.
+        auto plan = m_nearCache.plan(m_cacheKey, m_target.text);
+        if (!plan)
+            plan = m_memo.plan(m_cacheKey, m_target.text);
+        if (plan && plan->missing.isEmpty()) {
+            const QString text = Paragraphs::stitch(*plan, {});
+            m_recorder.finish(QStringLiteral("cache"), int(text.size()), true);
+            applyResult(text);
+            return;
+        }
+        m_plan = std::move(plan);
+    }
 
     QApplication::setOverrideCursor(Qt::BusyCursor);
     QSystemTrayIcon* tray = qobject_cast<QSystemTrayIcon*>(sender());
     if (tray)
         tray->setToolTip(i18n("Processing…"));
-    m_api->processText(m_target.text, m_currentPrompt);
+    if (!m_api)
+        setupApiClient();
+    TextBackend* backend = backendFor(route.endpoint);
+    m_processing = true;
+    m_requestCold = backendIsCold();
+    m_requestTimer.start();
+    QStringList segments;
+    if (m_plan) {
+        // Near-duplicate of an earlier input: only the changed paragraphs.
+        for (int k : std::as_const(m_plan->missing))
+            segments << m_plan->parts[k];
+    } else if (m_target.ranges.size() > 1) {
+        for (const auto& r : std::as_const(m_target.ranges))
+            segments << r.text;
+    }
+    if (m_recorder.isOpen()) {
+        QVector<int> sizes;
+        for (const QString& s : std::as_const(segments))
+            sizes << int(s.size());
+        if (sizes.isEmpty())
+            sizes << int(m_target.text.size());
+        m_recorder.setSegments(sizes);
+    }
+    m_requestId = 0;
+    m_jobId = 0;
+    m_chainId = 0;
+    m_patchMode = false;
+    // Chunked work yields to single interactive edits (RequestScheduler).
+    RequestOptions bulk = route.options;
+    bulk.priority = RequestOptions::Priority::Bulk;
+    if (precomputed && m_precomputeId) {
+        // Wait for it instead of asking again, now as interactive work:
+        // speculative requests are the first to be preempted.
+        m_plan.reset();
+        m_requestId = std::exchange(m_precomputeId, 0);
+        if (auto* s = qobject_cast<RequestScheduler*>(m_precomputeBackend.data()))
+            s->setPriority(m_requestId, RequestOptions::Priority::Interactive);
+    } else if (steps.size() > 1) {
+        // Each step starts on the sentences the previous one has finished.
+        if (segments.isEmpty())
+            segments << m_target.text;
+        m_chainId = m_chain.submit(backend, segments, steps, bulk);
+    } else if (!segments.isEmpty()) {
+        // Ranges are packed into as few requests as possible.
+        m_jobId = m_coalescer.submit(backend, segments, m_currentPrompt, bulk);
+    } else if (action.patchOutput) {
+        // Only the changes are generated; handleResult applies them.
+        RequestOptions options = route.options;
+        options.predictInput = false;       // the reply is not the input text
+        m_patchMode = true;
+        m_patchBackend = backend;
+        m_patchOptions = route.options;
+        m_requestId = backend->processText(m_target.text, EditPatch::prompt(m_currentPrompt), options);
+    } else {
+        m_requestId = backend->processText(m_target.text, m_currentPrompt, route.options);
+    }
 }
 
-void BackgroundProcessor::handleResult(const QString& text)
+void BackgroundProcessor::handleResult(quint64 requestId, const QString& text)
 {
+    if (requestId && requestId == m_warmUpId) {
+        m_warmUpId = 0;
+        m_stats.recordWarmUp(m_warmUpTimer.elapsed());
+        m_lastBackendUse.start();
+        qInfo() << "Backend warm-up took" << m_warmUpTimer.elapsed() << "ms";
+        return;
+    }
+    if (requestId && requestId == m_precomputeId) {
+        m_precomputeId = 0;
+        m_lastBackendUse.start();
+        m_nearCache.insert(m_precomputeKey, m_precomputeText, text);
+        m_memo.insert(m_precomputeKey, m_precomputeText, text);
+        return;
+    }
+    if (!requestId || requestId != m_requestId)
+        return;
+    QString result = text;
+    if (m_patchMode) {
+        m_patchMode = false;
+        const auto patched = EditPatch::apply(m_target.text, text);
+        m_stats.recordPatch(patched.has_value());
+        if (!patched) {
+            if (!m_patchBackend) {
+                handleError(requestId, i18n("The model's edits do not fit the text."));
+                return;
+            }
+            qInfo() << "Edit list does not apply, requesting the whole text";
+            m_requestId = m_patchBackend->processText(m_target.text, m_currentPrompt, m_patchOptions);
+            return;
+        }
+        result = *patched;
+    }
     QApplication::restoreOverrideCursor();
     m_processing = false;
+    m_stats.recordRequest(m_requestTimer.elapsed(), m_requestCold);
+    m_lastBackendUse.start();
+    m_recorder.finish(QStringLiteral("model"), int(result.size()), true);
+    remember(m_target.text, result);
+    applyResult(result);
+}
 
+void BackgroundProcessor::remember(const QString& input, const QString& output)
+{
+    m_nearCache.insert(m_cacheKey, input, output);
+    m_memo.insert(m_cacheKey, input, output);
+}
+
+void BackgroundProcessor::applyResult(const QString& text)
+{
+    record(m_target, m_currentAction,
+           {TextRange{m_target.selectionStart, m_target.selectionEnd, m_target.text}}, {text});
 #ifdef HAVE_ATSPI
     bool ok = false;
-    if (m_target.isEditable && m_target.accessible &&
-        m_a11y.isInitialized())
-        ok = m_a11y.replaceTextInElement(m_target, text);
+    if (m_target.accessible && m_a11y.isInitialized()
+        && !m_a11y.latency().isSlow(m_target.process)) {
+        // Paste where inserting is impossible, or slower for this application.
+        const AccessibilityLatency& lat = m_a11y.latency();
+        const bool paste = !m_paste.isBusy()
+                           && (m_target.isEditable ? lat.preferPaste(m_target.process, int(text.size()))
+                                                   : lat.pasteWorks(m_target.process));
+        if (paste) {
+            m_paste.start(m_target, text);  // notifies when done
+            return;
+        }
+        if (m_target.isEditable)
+            ok = m_a11y.replaceTextInElement(m_target, text);
+    }
     if (ok) {
         notify(i18n("Done"), i18n("Text was replaced."), false);
         return;
@@ -131,13 +638,244 @@ void BackgroundProcessor::handleResult(const QString& text)
     clipboardFallback(text, i18n("Inserted into clipboard."));
 }
 
-void BackgroundProcessor::handleError(const QString& err)
+void BackgroundProcessor::handleRangeResults(quint64 jobId, const QStringList& results)
 {
+    if (!jobId || jobId != m_jobId)
+        return;
+    m_jobId = 0;
+    finishJob(results);
+}
+
+void BackgroundProcessor::handleRangeError(quint64 jobId, const QString& err)
+{
+    if (!jobId || jobId != m_jobId)
+        return;
+    m_jobId = 0;
+    failJob(err);
+}
+
+void BackgroundProcessor::handleChainResults(quint64 jobId, const QStringList& results)
+{
+    if (!jobId || jobId != m_chainId)
+        return;
+    m_chainId = 0;
+    finishJob(results);
+}
+
+void BackgroundProcessor::handleChainError(quint64 jobId, const QString& err)
+{
+    if (!jobId || jobId != m_chainId)
+        return;
+    m_chainId = 0;
+    failJob(err);
+}
+
+// Results of a coalescer or chain job, one per segment.
+void BackgroundProcessor::finishJob(const QStringList& results)
+{
+    QApplication::restoreOverrideCursor();
+    m_processing = false;
+    m_stats.recordRequest(m_requestTimer.elapsed(), m_requestCold);
+    m_lastBackendUse.start();
+    if (m_recorder.isOpen()) {
+        int chars = 0;
+        for (const QString& r : results)
+            chars += int(r.size());
+        m_recorder.finish(QStringLiteral("model"), chars, true);
+    }
+    if (m_plan) {
+        const QString text = Paragraphs::stitch(*m_plan, results);
+        m_plan.reset();
+        remember(m_target.text, text);
+        applyResult(text);
+        return;
+    }
+    if (m_target.ranges.size() <= 1) {         // a chain over the whole text
+        const QString text = results.value(0);
+        remember(m_target.text, text);
+        applyResult(text);
+        return;
+    }
+    applyRangeResults(results);
+}
+
+void BackgroundProcessor::failJob(const QString& err)
+{
+    m_plan.reset();
     QApplication::restoreOverrideCursor();
     m_processing = false;
+    m_stats.recordError();
+    m_recorder.finish(QStringLiteral("model"), 0, false);
     notify(i18n("Error"), err, true);
 }
 
+void BackgroundProcessor::applyRangeResults(const QStringList& results)
+{
+    record(m_target, m_currentAction, m_target.ranges, results);
+#ifdef HAVE_ATSPI
+    bool ok = false;
+    if (m_target.isEditable && m_target.accessible &&
+        m_a11y.isInitialized() && !m_a11y.latency().isSlow(m_target.process))
+        ok = m_a11y.replaceRanges(m_target, results);
+    if (ok) {
+        notify(i18n("Done"), i18np("One range was replaced.", "%1 ranges were replaced.", results.size()), false);
+        return;
+    }
+#endif
+    clipboardFallback(results.join(QLatin1Char('\n')), i18n("Inserted into clipboard."));
+}
+
+// One journal entry per replaced range, all with the same timestamp so that
+// undo reverts them together.
+void BackgroundProcessor::record(const ElementInfo& target, const QString& action,
+                                 const QVector<TextRange>& replaced, const QStringList& results)
+{
+    if (!m_journal.isOpen())
+        return;
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    int shift = 0;                      // earlier ranges change the later offsets (code points)
+    for (int i = 0; i < replaced.size() && i < results.size(); ++i) {
+        JournalEntry e;
+        e.timestamp = now;
+        e.app       = target.appName;
+        e.action    = action;
+        e.original  = replaced[i].text;
+        e.inputHash = EditJournal::hashText(e.original);
+        e.offset    = replaced[i].start < 0 ? -1 : replaced[i].start + shift;
+        e.result    = results[i];
+        shift += int(e.result.toUcs4().size() - e.original.toUcs4().size());
+        m_journal.append(e);
+    }
+}
+
+void BackgroundProcessor::undoLastEdit()
+{
+    initialize();
+    const auto last = m_journal.last();
+    if (!last || last->timestamp == m_lastUndone) {
+        notify(i18n("Nothing to undo"), i18n("No edit was recorded."), false);
+        return;
+    }
+    m_lastUndone = last->timestamp;
+
+    // Offsets are those of the edited text: reverting back to front keeps
+    // the ones still to do valid.
+    QVector<JournalEntry> edit;
+    for (int i = m_journal.size() - 1; i >= 0; --i) {
+        const auto e = m_journal.entry(i);
+        if (!e || e->timestamp != last->timestamp)
+            break;
+        edit.prepend(*e);
+    }
+    int reverted = 0;
+#ifdef HAVE_ATSPI
+    if (m_a11y.isInitialized() && !m_a11y.focusedApplicationIsSlow()) {
+        for (auto it = edit.crbegin(); it != edit.crend(); ++it)
+            if (m_a11y.replaceInFocusedElement(it->result, it->original, it->offset))
+                ++reverted;
+    }
+#endif
+    if (reverted == edit.size()) {
+        notify(i18n("Undone"), i18n("The original text was restored."), false);
+        return;
+    }
+    QStringList originals;
+    for (const auto& e : std::as_const(edit))
+        originals << e.original;
+    clipboardFallback(originals.join(QLatin1Char('\n')),
+                      i18n("The edited text was not found in the focused field; "
+                           "the original text was copied to the clipboard."));
+}
+
+void BackgroundProcessor::reapplyForSelection()
+{
+    if (m_processing) return;
+    initialize();
+    ElementInfo target;
+#ifdef HAVE_ATSPI
+    if (m_a11y.isInitialized() && !m_a11y.focusedApplicationIsSlow())
+        target = m_a11y.getFocusedElementInfo();
+#endif
+    const auto e = m_journal.findByInput(EditJournal::hashText(target.text));
+    if (!target.isValid || !e || e->original != target.text) {
+        notify(i18n("Nothing to re-apply"),
+               i18n("No earlier result was recorded for the selected text."), false);
+        return;
+    }
+    m_target = target;
+    m_currentAction = e->action;
+    applyResult(e->result);
+}
+
+void BackgroundProcessor::reapplyEntry(int index)
+{
+    if (m_processing) return;
+    initialize();
+    const auto e = m_journal.entry(index);
+    if (!e)
+        return;
+    m_target = ElementInfo();
+#ifdef HAVE_ATSPI
+    if (m_a11y.isInitialized() && !m_a11y.focusedApplicationIsSlow())
+        m_target = m_a11y.getFocusedElementInfo();
+    // Without a selection, look for the original text in the field.
+    if (m_target.isValid && !m_target.wasSelection) {
+        if (m_a11y.replaceInFocusedElement(e->original, e->result, e->offset)) {
+            m_target.selectionStart = e->offset;
+            m_target.text = e->original;
+            record(m_target, e->action, {TextRange{e->offset, -1, e->original}}, {e->result});
+            notify(i18n("Done"), i18n("Text was replaced."), false);
+            return;
+        }
+        m_target.isEditable = false;    // do not overwrite the whole field
+    }
+#endif
+    if (!m_target.wasSelection)
+        m_target.text = e->original;
+    m_currentAction = e->action;
+    applyResult(e->result);
+}
+
+void BackgroundProcessor::handleError(quint64 requestId, const QString& err)
+{
+    if (requestId && requestId == m_warmUpId) {
+        m_warmUpId = 0;
+        qWarning() << "Backend warm-up failed:" << err;
+        return;
+    }
+    if (requestId && requestId == m_precomputeId) {
+        m_precomputeId = 0;
+        m_precompute.discard();
+        qDebug() << "Precompute failed:" << err;
+        return;
+    }
+    if (!requestId || requestId != m_requestId)
+        return;
+    QApplication::restoreOverrideCursor();
+    m_processing = false;
+    m_stats.recordError();
+    m_recorder.finish(QStringLiteral("model"), 0, false);
+    notify(i18n("Error"), err, true);
+}
+
+QString BackgroundProcessor::statsSummary() const
+{
+    const auto& c = m_nearCache.stats();
+    const auto& m = m_memo.stats();
+    QString text = m_stats.summary() + QLatin1Char('\n')
+           + i18n("Result cache: %1 exact and %2 partial hits of %3 lookups "
+                  "(%4 paragraphs reused, %5 sent)",
+                  c.exact, c.partial, c.lookups, c.reusedParts, c.sentParts)
+           + QLatin1Char('\n')
+           + i18n("Paragraph memo: %1 hits of %2 lookups (%3 paragraphs reused, %4 sent)",
+                  m.hits, m.lookups, m.reusedParts, m.sentParts);
+    if (const auto* s = qobject_cast<const RequestScheduler*>(m_api); s && !s->summary().isEmpty())
+        text += QLatin1Char('\n') + s->summary();
+    if (const QString p = m_precompute.summary(); !p.isEmpty())
+        text += QLatin1Char('\n') + p;
+    return text;
+}
+
 void BackgroundProcessor::clipboardFallback(const QString& text,
                                             const QString& why)
 {
@@ -150,7 +888,7 @@ void BackgroundProcessor::notify(const QString& title,
                                  bool error)
 {
     // Respect the user’s preference
-    if (!m_cfg->notificationsEnabled())
+    if (!m_config->notificationsEnabled)
         return;
 #ifdef HAVE_KNOTIFICATIONS
     KNotification* n = new KNotification(QStringLiteral("knowbridge"));
@@ -2,11 +2,27 @@
 #include <QObject>
 #include <QString>
 #include <QClipboard>
+#include <QElapsedTimer>
 #include <QMenu>
+#include <QHash>
+#include <QPointer>
+#include <QTimer>
 
 #include "AccessibilityHelper.h"
+#include "ActionChain.h"
+#include "ClipboardReader.h"
 #include "ConfigManager.h"
-#include "ApiClient.h"
+#include "EditJournal.h"
+#include "MetricsStore.h"
+#include "NearDuplicateCache.h"
+#include "ParagraphMemo.h"
+#include "PasteInjector.h"
+#include "PrecomputeBudget.h"
+#include "RequestCoalescer.h"
+#include "SessionRecorder.h"
+#include "SessionStats.h"
+#include "SpellFastPath.h"
+#include "TextBackend.h"
 
 /**
  *  Управляет жизненным циклом операции:
@@ -24,29 +40,114 @@ public:
     ~BackgroundProcessor() override;
 
     Q_INVOKABLE void onShortcutActivated();
+    Q_INVOKABLE void undoLastEdit();
+    // Puts back the journaled result for the text selected now.
+    Q_INVOKABLE void reapplyForSelection();
+    void reapplyEntry(int index);
+
+    const EditJournal& journal() const { return m_journal; }
+    MetricsStore& metrics() { return m_metrics; }
+    const AccessibilityLatency& accessibilityLatency() const { return m_a11y.latency(); }
+
+    QString statsSummary() const;
 
 private Q_SLOTS:
     void initialize();                  // отложенный старт
+    void onConfigChanged(ConfigManager::Fields changed);
     void onActionSelected(QAction* act);
 
-    void handleResult(const QString& text);
-    void handleError (const QString& err);
+    void handleResult(quint64 requestId, const QString& text);
+    void handleError (quint64 requestId, const QString& err);
+    void handleRangeResults(quint64 jobId, const QStringList& results);
+    void handleRangeError  (quint64 jobId, const QString& err);
+    void handleChainResults(quint64 jobId, const QStringList& results);
+    void handleChainError  (quint64 jobId, const QString& err);
 
 private:
     void setupApiClient();
+    void retireBackend(TextBackend* old);
+    TextBackend* backendFor(const QString& endpoint);
+    void setupKeepAlive();
+    void setupPrecompute();
+    void onSelectionChanged();
+    void runPrecompute();
+    void cancelPrecompute();
+    void warmUpBackend();
+    void onKeepAliveTimeout();
+    bool backendIsCold() const;
     void createActionMenu();
+    void startClipboardReaders();
+    void onClipboardRead(QClipboard::Mode mode, const QString& text);
+    void finishCapture(const QString& fallbackText);
     void notify(const QString& title,
                 const QString& text,
                 bool error = false);
+    void applyResult(const QString& text);
+    void remember(const QString& input, const QString& output);
+    void applyRangeResults(const QStringList& results);
+    void finishJob(const QStringList& results);
+    void failJob(const QString& err);
     void clipboardFallback(const QString& text,
                            const QString& why);
+    void record(const ElementInfo& target, const QString& action,
+                const QVector<TextRange>& replaced, const QStringList& results);
 
     bool               m_processing{false}; // <- добавлено
+    bool               m_initialized{false};
     ConfigManager*      m_cfg;
-    ApiClient*          m_api{nullptr};
+    ConfigSnapshotPtr   m_config;           // latest published settings
+    ConfigSnapshotPtr   m_jobConfig;        // settings the running request started with
+    TextBackend*        m_api{nullptr};
+    QHash<QString, TextBackend*> m_routeBackends;   // per-action endpoints
+    quint64             m_requestId{0};     // request whose result we are waiting for
+    quint64             m_jobId{0};         // same for a multi-range coalescer job
+    quint64             m_chainId{0};       // same for a multi-step action
+    quint64             m_warmUpId{0};      // pending warm-up / keep-alive ping
+    // m_requestId asks for EditPatch edits; backend and options are kept to
+    // ask for the whole text if they do not apply.
+    bool                m_patchMode{false};
+    QPointer<TextBackend> m_patchBackend;
+    RequestOptions      m_patchOptions;
+    // Opt-in: the first action run on a stable selection before the shortcut.
+    PrecomputeBudget    m_precompute;
+    QTimer              m_precomputeTimer;  // waits for the selection to settle
+    quint64             m_precomputeId{0};  // run in flight
+    QPointer<TextBackend> m_precomputeBackend;
+    quint64             m_precomputeKey{0};
+    QString             m_precomputeText;
+    bool                m_requestCold{false};
+    QElapsedTimer       m_requestTimer;
+    QElapsedTimer       m_warmUpTimer;
+    QElapsedTimer       m_lastBackendUse;   // last finished request or warm-up
+    QTimer              m_keepAlive;
+    RequestCoalescer    m_coalescer;        // multi-range selections
+    ActionChain         m_chain;            // actions with several prompts
+    SessionStats        m_stats;
+    MetricsStore        m_metrics;          // persistent usage per endpoint/model/action
+    SessionRecorder     m_recorder;         // opt-in, see KNOWBRIDGE_RECORD_SESSION
+    SpellFastPath       m_spell;
+    EditJournal         m_journal;
+    NearDuplicateCache  m_nearCache;
+    ParagraphMemo       m_memo;
+    std::optional<Paragraphs::Plan> m_plan;   // running partial re-run
+    quint64             m_cacheKey{0};      // action key of the running request
+    qint64              m_lastUndone{0};    // timestamp of the edit reverted last
     QClipboard*         m_clip;
-    QMenu*              m_menu;
+    QMenu*              m_menu{nullptr};    // built on first shortcut
     AccessibilityHelper m_a11y;
+    PasteInjector       m_paste{&m_a11y};   // large results, fields without EditableText
     ElementInfo         m_target;
+    // Text capture after the shortcut: AT-SPI first, then the selections.
+    struct Capture {
+        bool active = false;
+        QPointer<ClipboardReader> primary;
+        QPointer<ClipboardReader> clipboard;
+        bool primaryDone = false;
+        bool clipboardDone = false;
+        QString primaryText;
+        QString clipboardText;
+    };
+    Capture             m_capture;
     QString             m_currentPrompt;
+    QString             m_currentAction;
 };
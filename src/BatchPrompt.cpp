@@ -0,0 +1,51 @@
+#include "BatchPrompt.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+
+namespace BatchPrompt {
+
+QString prompt(const QString& userPrompt, int count)
+{
+    return userPrompt + QStringLiteral(
+            "\n\nThe input is a JSON array of %1 independent text fragments. "
+            "Apply the instruction to every fragment separately. "
+            "Return ONLY a JSON array of exactly %1 strings with the results, "
+            "in the same order, without code fences or comments.").arg(count);
+}
+
+QString pack(const QStringList& segments)
+{
+    return QString::fromUtf8(QJsonDocument(QJsonArray::fromStringList(segments))
+                                     .toJson(QJsonDocument::Compact));
+}
+
+std::optional<QStringList> unpack(const QString& reply, int expected)
+{
+    // Models like to wrap JSON in ```json fences or add a line of chatter:
+    // take the outermost brackets.
+    const qsizetype from = reply.indexOf(QLatin1Char('['));
+    const qsizetype to   = reply.lastIndexOf(QLatin1Char(']'));
+    if (from < 0 || to <= from)
+        return std::nullopt;
+
+    QJsonParseError err{};
+    const auto doc = QJsonDocument::fromJson(reply.mid(from, to - from + 1).toUtf8(), &err);
+    if (err.error != QJsonParseError::NoError || !doc.isArray())
+        return std::nullopt;
+
+    const QJsonArray arr = doc.array();
+    if (arr.size() != expected)
+        return std::nullopt;
+
+    QStringList out;
+    out.reserve(expected);
+    for (const auto& v : arr) {
+        if (!v.isString())
+            return std::nullopt;
+        out << v.toString();
+    }
+    return out;
+}
+
+} // namespace BatchPrompt
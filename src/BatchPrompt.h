@@ -0,0 +1,23 @@
+#pragma once
+#include <QString>
+#include <QStringList>
+
+#include <optional>
+
+/**
+ *  Several independent fragments in one chat request.
+ *  Fragments go out as a JSON array of strings and the model must answer
+ *  with an array of the same length, so the reply can be split back.
+ */
+namespace BatchPrompt {
+
+// User prompt extended with the output contract for `count` fragments.
+QString prompt(const QString& userPrompt, int count);
+
+// Fragments encoded as the request text.
+QString pack(const QStringList& segments);
+
+// Splits a reply; empty if it does not hold exactly `expected` strings.
+std::optional<QStringList> unpack(const QString& reply, int expected);
+
+} // namespace BatchPrompt
@@ -0,0 +1,111 @@
+#include "ClipboardReader.h"
+
+#include <QApplication>
+#include <QDebug>
+#include <QStandardPaths>
+
+ClipboardReader::ClipboardReader(QClipboard::Mode mode, QObject* parent)
+        : QObject(parent)
+        , m_mode(mode)
+{
+    m_timeout.setSingleShot(true);
+    connect(&m_timeout, &QTimer::timeout, this, [this] {
+        qWarning() << "ClipboardReader: owner did not answer in time, mode" << m_mode;
+        done(QString());
+    });
+    connect(&m_proc, &QProcess::readyReadStandardOutput, this, &ClipboardReader::onReadyRead);
+    connect(&m_proc, &QProcess::finished, this, [this](int code, QProcess::ExitStatus status) {
+        onReadyRead();
+        // wl-paste/xclip exit non-zero for an empty selection: not an error.
+        done(status == QProcess::NormalExit && code == 0 ? QString::fromUtf8(m_data) : QString());
+    });
+    connect(&m_proc, &QProcess::errorOccurred, this, [this](QProcess::ProcessError e) {
+        if (e == QProcess::FailedToStart)
+            done(QString());
+    });
+}
+
+QString ClipboardReader::helperProgram()
+{
+    if (!qEnvironmentVariableIsEmpty("WAYLAND_DISPLAY")
+        && !QStandardPaths::findExecutable(QStringLiteral("wl-paste")).isEmpty())
+        return QStringLiteral("wl-paste");
+    for (const QString& p : {QStringLiteral("xclip"), QStringLiteral("xsel")})
+        if (!QStandardPaths::findExecutable(p).isEmpty())
+            return p;
+    return QString();
+}
+
+QStringList ClipboardReader::command() const
+{
+    const bool primary = m_mode == QClipboard::Selection;
+    const QString program = helperProgram();
+    if (program == QLatin1String("wl-paste")) {
+        QStringList cmd{program, QStringLiteral("--no-newline"),
+                        QStringLiteral("--type"), QStringLiteral("text")};
+        if (primary)
+            cmd << QStringLiteral("--primary");
+        return cmd;
+    }
+    if (program == QLatin1String("xclip"))
+        return {program, QStringLiteral("-o"), QStringLiteral("-selection"),
+                primary ? QStringLiteral("primary") : QStringLiteral("clipboard")};
+    if (program == QLatin1String("xsel"))
+        return {program, QStringLiteral("-o"), primary ? QStringLiteral("-p") : QStringLiteral("-b")};
+    return {};
+}
+
+void ClipboardReader::start(int timeoutMs, qint64 maxBytes)
+{
+    m_maxBytes = maxBytes;
+    QClipboard* clip = QApplication::clipboard();
+    const bool own = m_mode == QClipboard::Selection ? clip->ownsSelection()
+                                                     : clip->ownsClipboard();
+    const QStringList cmd = own ? QStringList() : command();
+    if (cmd.isEmpty()) {
+        // Our own data needs no round-trip; without a helper tool there is
+        // no other way than the blocking read.
+        if (!own)
+            qInfo() << "ClipboardReader: no wl-paste/xclip/xsel, reading synchronously";
+        const QString text = clip->text(m_mode);
+        QTimer::singleShot(0, this, [this, text] {
+            done(text.toUtf8().size() > m_maxBytes ? QString() : text);
+        });
+        return;
+    }
+    m_timeout.start(timeoutMs);
+    m_proc.setStandardInputFile(QProcess::nullDevice());
+    m_proc.start(cmd.first(), cmd.mid(1), QIODevice::ReadOnly);
+}
+
+void ClipboardReader::onReadyRead()
+{
+    if (m_done)
+        return;
+    m_data += m_proc.readAllStandardOutput();
+    if (m_data.size() > m_maxBytes) {
+        qWarning() << "ClipboardReader: content larger than" << m_maxBytes << "bytes, ignored";
+        done(QString());
+    }
+}
+
+void ClipboardReader::cancel()
+{
+    m_done = true;
+    m_timeout.stop();
+    if (m_proc.state() != QProcess::NotRunning)
+        m_proc.kill();
+    deleteLater();
+}
+
+void ClipboardReader::done(const QString& text)
+{
+    if (m_done)
+        return;
+    m_done = true;
+    m_timeout.stop();
+    if (m_proc.state() != QProcess::NotRunning)
+        m_proc.kill();
+    Q_EMIT finished(m_mode, text);
+    deleteLater();
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <QByteArray>
+#include <QClipboard>
+#include <QObject>
+#include <QProcess>
+#include <QTimer>
+
+/**
+ *  Reads the clipboard or the primary selection without blocking the GUI
+ *  thread: the transfer from the owner runs in a helper process (wl-paste,
+ *  xclip or xsel) that is killed after a timeout or when the content grows
+ *  beyond a size cap. Each reader is used once and deletes itself after
+ *  `finished`.
+ */
+class ClipboardReader : public QObject
+{
+Q_OBJECT
+public:
+    static constexpr int    kTimeoutMs = 300;
+    static constexpr qint64 kMaxBytes  = 1024 * 1024;
+
+    explicit ClipboardReader(QClipboard::Mode mode, QObject* parent = nullptr);
+
+    void start(int timeoutMs = kTimeoutMs, qint64 maxBytes = kMaxBytes);
+    void cancel();                  // no `finished` after this
+
+    // False when no helper tool is installed: start() then falls back to the
+    // blocking QClipboard read, which should only be paid when needed.
+    static bool readsInBackground() { return !helperProgram().isEmpty(); }
+
+    QClipboard::Mode mode() const { return m_mode; }
+
+Q_SIGNALS:
+    // Empty on timeout, error or overflow.
+    void finished(QClipboard::Mode mode, const QString& text);
+
+private:
+    void onReadyRead();
+    void done(const QString& text);
+    // Helper tool for this session type, empty if none is installed.
+    static QString helperProgram();
+    // Its command line for m_mode.
+    QStringList command() const;
+
+    QClipboard::Mode m_mode;
+    QProcess    m_proc;
+    QTimer      m_timeout;
+    QByteArray  m_data;
+    qint64      m_maxBytes = kMaxBytes;
+    bool        m_done = false;
+};
@@ -10,34 +10,59 @@ ConfigManager::ConfigManager(QObject *parent)
         : QObject(parent)
 {
     load();
+    publish();
 }
 
 /*----------- чтение ------------*/
 void ConfigManager::load()
 {
     KConfigGroup g(&m_cfg, G_GENERAL);
-    m_apiKey   = g.readEntry("ApiKey");
-    m_endpoint = g.readEntry("Endpoint",
+    m_draft.apiKey   = g.readEntry("ApiKey");
+    m_draft.endpoint = g.readEntry("Endpoint",
                              QStringLiteral("http://localhost:30000/v1/chat/completions"));
-    m_model    = g.readEntry("Model", QStringLiteral("localqwen"));
-    m_systemPrompt = g.readEntry("SystemPrompt",
+    m_draft.model    = g.readEntry("Model", QStringLiteral("localqwen"));
+    m_draft.systemPrompt = g.readEntry("SystemPrompt",
                                  i18n("You are an AI text editor. Strictly follow the instructions. "
                                       "Return ONLY the modified text—no explanations, pre-/post-amble."));
-    m_notificationsEnabled = g.readEntry("NotificationsEnabled", true);
+    m_draft.notificationsEnabled = g.readEntry("NotificationsEnabled", true);
+    m_draft.backend = g.readEntry("Backend", QStringLiteral("http")) == QLatin1String("llama")
+                ? Backend::Llama : Backend::Http;
+    m_draft.localModelPath   = g.readEntry("LocalModelPath");
+    m_draft.localThreads     = g.readEntry("LocalThreads", 0);
+    m_draft.localContextSize = g.readEntry("LocalContextSize", 4096);
+    m_draft.warmUpEnabled    = g.readEntry("WarmUp", true);
+    m_draft.keepAliveMinutes = g.readEntry("KeepAliveMinutes", 0);
+    m_draft.precomputePerHour = g.readEntry("PrecomputePerHour", 0);
 
-    m_actions.clear();
+    m_draft.actions.clear();
     const KConfigGroup a(&m_cfg, G_ACT);
     const int count = a.readEntry("Count", 0);
     for (int i = 0; i < count; ++i) {
         CustomAction ca;
         ca.name   = a.readEntry(QStringLiteral("Name%1").arg(i));
         ca.prompt = a.readEntry(QStringLiteral("Prompt%1").arg(i));
+        ca.localSpellCheck = a.readEntry(QStringLiteral("LocalSpell%1").arg(i), false);
+        ca.model           = a.readEntry(QStringLiteral("Model%1").arg(i));
+        ca.endpoint        = a.readEntry(QStringLiteral("Endpoint%1").arg(i));
+        ca.temperature     = a.readEntry(QStringLiteral("Temperature%1").arg(i), -1.0);
+        ca.maxTokens       = a.readEntry(QStringLiteral("MaxTokens%1").arg(i), 0);
+        ca.reasoningEffort = a.readEntry(QStringLiteral("ReasoningEffort%1").arg(i));
+        ca.predictOutput   = a.readEntry(QStringLiteral("PredictOutput%1").arg(i), false);
+        ca.patchOutput     = a.readEntry(QStringLiteral("PatchOutput%1").arg(i), false);
+        // "maxChars|model|endpoint" per rule
+        const QStringList routes = a.readEntry(QStringLiteral("Routes%1").arg(i), QStringList());
+        for (const QString& r : routes) {
+            const QStringList f = r.split(QLatin1Char('|'));
+            if (f.size() == 3)
+                ca.routes << RoutingRule{f[0].toInt(), f[1], f[2]};
+        }
         if (!ca.name.isEmpty() && !ca.prompt.isEmpty())
-            m_actions << ca;
+            m_draft.actions << ca;
     }
-    if (m_actions.isEmpty()) { // дефолты первой загрузки
-        m_actions = {
+    if (m_draft.actions.isEmpty()) { // дефолты первой загрузки
+        m_draft.actions = {
                 {i18n("Fix Grammar"),  i18n("Correct typos, punctuation, grammar and capitalization.")},
+                {i18n("Fix Spelling"), i18n("Correct misspelled words only; change nothing else."), true},
                 {i18n("Improve Style"), i18n("Improve clarity, word choice and readability.")},
                 {i18n("Simplify Text"), i18n("Rewrite in plain language suitable for a 6-grade student.")}
         };
@@ -48,21 +73,71 @@ void ConfigManager::load()
 void ConfigManager::sync()
 {
     KConfigGroup g(&m_cfg, G_GENERAL);
-    g.writeEntry("ApiKey",    m_apiKey);
-    g.writeEntry("Endpoint",  m_endpoint);
-    g.writeEntry("Model",     m_model);
-    g.writeEntry("SystemPrompt", m_systemPrompt);
-    g.writeEntry("NotificationsEnabled", m_notificationsEnabled);
+    g.writeEntry("ApiKey",    m_draft.apiKey);
+    g.writeEntry("Endpoint",  m_draft.endpoint);
+    g.writeEntry("Model",     m_draft.model);
+    g.writeEntry("SystemPrompt", m_draft.systemPrompt);
+    g.writeEntry("NotificationsEnabled", m_draft.notificationsEnabled);
+    g.writeEntry("Backend", m_draft.backend == Backend::Llama ? QStringLiteral("llama")
+                                                        : QStringLiteral("http"));
+    g.writeEntry("LocalModelPath",   m_draft.localModelPath);
+    g.writeEntry("LocalThreads",     m_draft.localThreads);
+    g.writeEntry("LocalContextSize", m_draft.localContextSize);
+    g.writeEntry("WarmUp",           m_draft.warmUpEnabled);
+    g.writeEntry("KeepAliveMinutes", m_draft.keepAliveMinutes);
+    g.writeEntry("PrecomputePerHour", m_draft.precomputePerHour);
 
     KConfigGroup a(&m_cfg, G_ACT);
     a.deleteGroup();                       // перезаписываем
-    a.writeEntry("Count", m_actions.size());
-    for (int i = 0; i < m_actions.size(); ++i) {
-        a.writeEntry(QStringLiteral("Name%1").arg(i),   m_actions[i].name);
-        a.writeEntry(QStringLiteral("Prompt%1").arg(i), m_actions[i].prompt);
+    a.writeEntry("Count", m_draft.actions.size());
+    for (int i = 0; i < m_draft.actions.size(); ++i) {
+        a.writeEntry(QStringLiteral("Name%1").arg(i),   m_draft.actions[i].name);
+        a.writeEntry(QStringLiteral("Prompt%1").arg(i), m_draft.actions[i].prompt);
+        const CustomAction& ca = m_draft.actions[i];
+        a.writeEntry(QStringLiteral("LocalSpell%1").arg(i), ca.localSpellCheck);
+        a.writeEntry(QStringLiteral("Model%1").arg(i),           ca.model);
+        a.writeEntry(QStringLiteral("Endpoint%1").arg(i),        ca.endpoint);
+        a.writeEntry(QStringLiteral("Temperature%1").arg(i),     ca.temperature);
+        a.writeEntry(QStringLiteral("MaxTokens%1").arg(i),       ca.maxTokens);
+        a.writeEntry(QStringLiteral("ReasoningEffort%1").arg(i), ca.reasoningEffort);
+        a.writeEntry(QStringLiteral("PredictOutput%1").arg(i),   ca.predictOutput);
+        a.writeEntry(QStringLiteral("PatchOutput%1").arg(i),     ca.patchOutput);
+        QStringList routes;
+        for (const auto& r : ca.routes)
+            routes << QStringLiteral("%1|%2|%3").arg(r.maxChars).arg(r.model, r.endpoint);
+        a.writeEntry(QStringLiteral("Routes%1").arg(i), routes);
     }
     m_cfg.sync();
-    Q_EMIT configChanged();
+    publish();
+}
+
+void ConfigManager::publish()
+{
+    auto next = QSharedPointer<ConfigSnapshot>::create(m_draft);
+    next->version = m_published ? m_published->version + 1 : 1;
+    const Fields changed = m_published ? diff(*m_published, *next) : Fields();
+    m_published = next;
+    if (changed)
+        Q_EMIT configChanged(changed);
+}
+
+ConfigManager::Fields ConfigManager::diff(const ConfigSnapshot &a, const ConfigSnapshot &b)
+{
+    Fields f;
+    if (a.apiKey != b.apiKey)                 f |= ApiKeyField;
+    if (a.endpoint != b.endpoint)             f |= EndpointField;
+    if (a.model != b.model)                   f |= ModelField;
+    if (a.systemPrompt != b.systemPrompt)     f |= SystemPromptField;
+    if (a.notificationsEnabled != b.notificationsEnabled) f |= NotificationsField;
+    if (a.backend != b.backend
+        || a.localModelPath != b.localModelPath
+        || a.localThreads != b.localThreads
+        || a.localContextSize != b.localContextSize) f |= BackendField;
+    if (a.warmUpEnabled != b.warmUpEnabled
+        || a.keepAliveMinutes != b.keepAliveMinutes) f |= WarmUpField;
+    if (a.precomputePerHour != b.precomputePerHour) f |= PrecomputeField;
+    if (a.actions != b.actions)               f |= ActionsField;
+    return f;
 }
 
 void ConfigManager::reset()
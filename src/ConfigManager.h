@@ -2,50 +2,151 @@
 #pragma once
 #include <QObject>
 #include <KConfig>
+#include <QSharedPointer>
 #include <QVector>
 
+/* -------- маршрутизация по размеру текста ---------- */
+struct RoutingRule {
+    int     maxChars = 0;               // inputs up to this size; 0 = any size
+    QString model;                      // empty = keep the action's
+    QString endpoint;
+
+    friend bool operator==(const RoutingRule &a, const RoutingRule &b)
+    {
+        return a.maxChars == b.maxChars && a.model == b.model && a.endpoint == b.endpoint;
+    }
+    friend bool operator!=(const RoutingRule &a, const RoutingRule &b) { return !(a == b); }
+};
+
 /* -------- пользовательские действия ---------- */
 struct CustomAction {
     QString name;
     QString prompt;
+    bool    localSpellCheck = false;    // spelling-only action: try SpellFastPath before the model
+
+    // Generation overrides; empty / default values use the global settings.
+    QString model;
+    QString endpoint;
+    double  temperature = -1;           // < 0 = server default
+    int     maxTokens = 0;              // 0 = no limit
+    QString reasoningEffort;            // "low", "medium", "high" or empty
+    bool    predictOutput = false;      // send the input as predicted output
+    bool    patchOutput = false;        // ask for a list of edits (EditPatch)
+    QVector<RoutingRule> routes;        // ascending maxChars, first match wins
+
+    friend bool operator==(const CustomAction &a, const CustomAction &b)
+    {
+        return a.name == b.name && a.prompt == b.prompt
+               && a.localSpellCheck == b.localSpellCheck
+               && a.model == b.model && a.endpoint == b.endpoint
+               && a.temperature == b.temperature && a.maxTokens == b.maxTokens
+               && a.reasoningEffort == b.reasoningEffort && a.predictOutput == b.predictOutput
+               && a.patchOutput == b.patchOutput
+               && a.routes == b.routes;
+    }
+    friend bool operator!=(const CustomAction &a, const CustomAction &b) { return !(a == b); }
+};
+
+/* -------- неизменяемый снимок настроек ---------- */
+struct ConfigSnapshot {
+    enum class Backend { Http, Llama };   // ApiClient / LlamaClient
+
+    quint64 version = 0;                  // grows with every published change
+
+    QString apiKey;
+    QString endpoint;
+    QString model;
+    QString systemPrompt;
+    bool    notificationsEnabled = true;
+    Backend backend = Backend::Http;
+    QString localModelPath;
+    int     localThreads = 0;             // 0 = auto
+    int     localContextSize = 4096;
+    bool    warmUpEnabled = true;
+    int     keepAliveMinutes = 0;         // 0 = off
+    int     precomputePerHour = 0;        // runs on stable selections, 0 = off
+    QVector<CustomAction> actions;
 };
+using ConfigSnapshotPtr = QSharedPointer<const ConfigSnapshot>;
 
+/**
+ *  Setters edit a draft (used by the settings dialog); `sync()` stores it and
+ *  publishes a new immutable snapshot. Readers keep a `ConfigSnapshotPtr`, so
+ *  work started with an older snapshot finishes with it.
+ */
 class ConfigManager : public QObject
 {
 Q_OBJECT
 public:
+    using Backend = ConfigSnapshot::Backend;
+
+    enum Field : quint32 {
+        ApiKeyField        = 1u << 0,
+        EndpointField      = 1u << 1,
+        ModelField         = 1u << 2,
+        SystemPromptField  = 1u << 3,
+        NotificationsField = 1u << 4,
+        BackendField       = 1u << 5,     // backend kind and local model settings
+        WarmUpField        = 1u << 6,     // warm-up and keep-alive
+        ActionsField       = 1u << 7,
+        PrecomputeField    = 1u << 8,
+    };
+    Q_DECLARE_FLAGS(Fields, Field)
+
+    // Changes that need a new backend (and thus new connections).
+    static Fields connectionFields() { return Fields(ApiKeyField) | EndpointField | BackendField; }
+
     explicit ConfigManager(QObject *parent = nullptr);
 
-    /*--- простые параметры ---*/
-    QString apiKey()      const { return m_apiKey; }
-    QString apiEndpoint() const { return m_endpoint; }
-    QString model()       const { return m_model;   }
-    QString systemPrompt() const { return m_systemPrompt; }
-    bool notificationsEnabled() const { return m_notificationsEnabled; }
+    /*--- опубликованное состояние ---*/
+    ConfigSnapshotPtr snapshot() const { return m_published; }
 
-    void setApiKey     (const QString &v) { m_apiKey = v; }
-    void setApiEndpoint(const QString &v) { m_endpoint = v; }
-    void setModel      (const QString &v) { m_model = v; }
-    void setSystemPrompt(const QString &v) { m_systemPrompt = v; }
-    void setNotificationsEnabled(bool v) { m_notificationsEnabled = v; }
+    /*--- простые параметры (черновик) ---*/
+    QString apiKey()      const { return m_draft.apiKey; }
+    QString apiEndpoint() const { return m_draft.endpoint; }
+    QString model()       const { return m_draft.model;   }
+    QString systemPrompt() const { return m_draft.systemPrompt; }
+    bool notificationsEnabled() const { return m_draft.notificationsEnabled; }
+    Backend backend()     const { return m_draft.backend; }
+    QString localModelPath() const { return m_draft.localModelPath; }
+    int localThreads()    const { return m_draft.localThreads; }     // 0 = auto
+    int localContextSize() const { return m_draft.localContextSize; }
+    bool warmUpEnabled()  const { return m_draft.warmUpEnabled; }
+    int keepAliveMinutes() const { return m_draft.keepAliveMinutes; } // 0 = off
+    int precomputePerHour() const { return m_draft.precomputePerHour; } // 0 = off
+
+    void setApiKey     (const QString &v) { m_draft.apiKey = v; }
+    void setApiEndpoint(const QString &v) { m_draft.endpoint = v; }
+    void setModel      (const QString &v) { m_draft.model = v; }
+    void setSystemPrompt(const QString &v) { m_draft.systemPrompt = v; }
+    void setNotificationsEnabled(bool v) { m_draft.notificationsEnabled = v; }
+    void setBackend    (Backend v) { m_draft.backend = v; }
+    void setLocalModelPath(const QString &v) { m_draft.localModelPath = v; }
+    void setLocalThreads(int v) { m_draft.localThreads = v; }
+    void setLocalContextSize(int v) { m_draft.localContextSize = v; }
+    void setWarmUpEnabled(bool v) { m_draft.warmUpEnabled = v; }
+    void setKeepAliveMinutes(int v) { m_draft.keepAliveMinutes = v; }
+    void setPrecomputePerHour(int v) { m_draft.precomputePerHour = v; }
 
     /*--- действия ---*/
-    QVector<CustomAction> actions() const { return m_actions; }
-    void setActions(const QVector<CustomAction>& v) { m_actions = v; }
+    const QVector<CustomAction>& actions() const { return m_draft.actions; }
+    void setActions(const QVector<CustomAction>& v) { m_draft.actions = v; }
 
-    void sync();                 // записать на диск
-    void load();                 // прочитать из диска
+    void sync();                 // записать на диск и опубликовать
+    void load();                 // прочитать из диска (в черновик)
     void reset();
 
+    static Fields diff(const ConfigSnapshot &a, const ConfigSnapshot &b);
+
 Q_SIGNALS:
-    void configChanged();
+    void configChanged(ConfigManager::Fields changed);
 
 private:
+    void publish();
+
     KConfig             m_cfg{ QStringLiteral("knowbridge") };
-    QString             m_apiKey;
-    QString             m_endpoint;
-    QString             m_model;
-    QString             m_systemPrompt;
-    bool                m_notificationsEnabled = true;
-    QVector<CustomAction> m_actions;
+    ConfigSnapshot      m_draft;
+    ConfigSnapshotPtr   m_published;
 };
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(ConfigManager::Fields)
@@ -0,0 +1,261 @@
+#include "EditJournal.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QtEndian>
+
+#include <cstring>
+
+namespace {
+
+constexpr char   kMagic[4]   = {'K', 'B', 'J', '1'};
+constexpr quint32 kVersion   = 1;
+constexpr qint64 kHeaderSize = 16;      // magic, version, end offset
+constexpr qint64 kFrameHead  = 8;       // payload length, checksum
+
+quint32 checksum(const uchar* data, qint64 len)
+{
+    quint32 h = 2166136261u;            // FNV-1a, 32 bit
+    for (qint64 i = 0; i < len; ++i) {
+        h ^= data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void putString(QByteArray& out, const QString& s)
+{
+    const QByteArray utf8 = s.toUtf8();
+    const quint32 len = qToLittleEndian(quint32(utf8.size()));
+    out.append(reinterpret_cast<const char*>(&len), sizeof len);
+    out.append(utf8);
+}
+
+template <typename T>
+void putValue(QByteArray& out, T v)
+{
+    v = qToLittleEndian(v);
+    out.append(reinterpret_cast<const char*>(&v), sizeof v);
+}
+
+// Bounds-checked reader over a frame payload.
+struct Reader {
+    const uchar* p;
+    qint64 left;
+    bool ok = true;
+
+    template <typename T> T value()
+    {
+        if (left < qint64(sizeof(T))) { ok = false; return T(); }
+        const T v = qFromLittleEndian<T>(p);
+        p += sizeof(T);
+        left -= sizeof(T);
+        return v;
+    }
+    QString string()
+    {
+        const quint32 len = value<quint32>();
+        if (!ok || left < qint64(len)) { ok = false; return QString(); }
+        const QString s = QString::fromUtf8(reinterpret_cast<const char*>(p), len);
+        p += len;
+        left -= len;
+        return s;
+    }
+};
+
+} // namespace
+
+EditJournal::EditJournal(qint64 capacity)
+        : m_capacity(qMax<qint64>(capacity, 64 * 1024))
+{
+}
+
+EditJournal::~EditJournal()
+{
+    if (m_map)
+        m_file.unmap(m_map);
+}
+
+QString EditJournal::defaultPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+           + QStringLiteral("/journal.bin");
+}
+
+quint64 EditJournal::hashText(const QString& text)
+{
+    quint64 h = 14695981039346656037ull; // FNV-1a, 64 bit, over UTF-16
+    for (const QChar c : text) {
+        h ^= c.unicode();
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+bool EditJournal::open(const QString& path)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        qWarning() << "EditJournal: cannot open" << path << m_file.errorString();
+        return false;
+    }
+    // The journal holds user text.
+    m_file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+
+    const bool fresh = m_file.size() < kHeaderSize;
+    if (m_file.size() != m_capacity && !m_file.resize(qMax(m_file.size(), m_capacity))) {
+        qWarning() << "EditJournal: cannot resize" << path;
+        return false;
+    }
+    m_capacity = m_file.size();
+    m_map = m_file.map(0, m_capacity);
+    if (!m_map) {
+        qWarning() << "EditJournal: cannot map" << path << m_file.errorString();
+        return false;
+    }
+
+    if (fresh || std::memcmp(m_map, kMagic, 4) != 0
+        || qFromLittleEndian<quint32>(m_map + 4) != kVersion) {
+        std::memcpy(m_map, kMagic, 4);
+        qToLittleEndian<quint32>(kVersion, m_map + 4);
+        m_end = kHeaderSize;
+        writeEnd();
+        return true;
+    }
+    return scan();
+}
+
+bool EditJournal::scan()
+{
+    const qint64 recorded = qFromLittleEndian<qint64>(m_map + 8);
+    const qint64 limit = qBound(kHeaderSize, recorded, m_capacity);
+    qint64 pos = kHeaderSize;
+    while (pos + kFrameHead <= limit) {
+        const qint64 len = qFromLittleEndian<quint32>(m_map + pos);
+        const quint32 sum = qFromLittleEndian<quint32>(m_map + pos + 4);
+        if (len == 0 || pos + kFrameHead + len > limit
+            || checksum(m_map + pos + kFrameHead, len) != sum)
+            break;                      // torn write: the journal ends here
+        const auto e = decode(m_map + pos + kFrameHead, len);
+        if (!e)
+            break;
+        m_byInput.insert(e->inputHash, int(m_frames.size()));
+        m_frames.append(pos);
+        pos += kFrameHead + len;
+    }
+    m_end = pos;
+    if (m_end != recorded) {
+        qWarning() << "EditJournal: dropped" << (recorded - m_end) << "damaged bytes";
+        writeEnd();
+    }
+    return true;
+}
+
+void EditJournal::writeEnd()
+{
+    qToLittleEndian<qint64>(m_end, m_map + 8);
+}
+
+QByteArray EditJournal::encode(const JournalEntry& e)
+{
+    QByteArray out;
+    out.reserve(int(32 + (e.app.size() + e.action.size() + e.original.size() + e.result.size()) * 2));
+    putValue<qint64>(out, e.timestamp);
+    putValue<quint64>(out, e.inputHash);
+    putValue<qint32>(out, e.offset);
+    putString(out, e.app);
+    putString(out, e.action);
+    putString(out, e.original);
+    putString(out, e.result);
+    return out;
+}
+
+std::optional<JournalEntry> EditJournal::decode(const uchar* data, qint64 len)
+{
+    Reader r{data, len};
+    JournalEntry e;
+    e.timestamp = r.value<qint64>();
+    e.inputHash = r.value<quint64>();
+    e.offset    = r.value<qint32>();
+    e.app       = r.string();
+    e.action    = r.string();
+    e.original  = r.string();
+    e.result    = r.string();
+    if (!r.ok)
+        return std::nullopt;
+    return e;
+}
+
+bool EditJournal::append(const JournalEntry& e)
+{
+    if (!m_map)
+        return false;
+    const QByteArray payload = encode(e);
+    const qint64 frame = kFrameHead + payload.size();
+    if (frame > (m_capacity - kHeaderSize) / 2) {
+        qWarning() << "EditJournal: entry of" << frame << "bytes is too large, not recorded";
+        return false;
+    }
+    if (m_end + frame > m_capacity)
+        compact(frame);
+
+    uchar* at = m_map + m_end;
+    const auto* bytes = reinterpret_cast<const uchar*>(payload.constData());
+    qToLittleEndian<quint32>(quint32(payload.size()), at);
+    qToLittleEndian<quint32>(checksum(bytes, payload.size()), at + 4);
+    std::memcpy(at + kFrameHead, bytes, payload.size());
+
+    m_byInput.insert(e.inputHash, int(m_frames.size()));
+    m_frames.append(m_end);
+    m_end += frame;
+    writeEnd();                         // last, so a torn frame is never counted
+    return true;
+}
+
+// Keeps the newest frames that fit into half of the file, moved to the front.
+void EditJournal::compact(qint64 needed)
+{
+    const qint64 budget = (m_capacity - kHeaderSize) / 2 - needed;
+    int first = int(m_frames.size());
+    while (first > 0 && m_end - m_frames[first - 1] <= budget)
+        --first;
+
+    const qint64 from = first < m_frames.size() ? m_frames[first] : m_end;
+    const qint64 kept = m_end - from;
+    std::memmove(m_map + kHeaderSize, m_map + from, size_t(kept));
+
+    const qint64 shift = from - kHeaderSize;
+    QVector<qint64> frames;
+    frames.reserve(m_frames.size() - first);
+    m_byInput.clear();
+    for (int i = first; i < m_frames.size(); ++i) {
+        const qint64 pos = m_frames[i] - shift;
+        const qint64 len = qFromLittleEndian<quint32>(m_map + pos);
+        if (const auto e = decode(m_map + pos + kFrameHead, len))
+            m_byInput.insert(e->inputHash, int(frames.size()));
+        frames.append(pos);
+    }
+    m_frames = frames;
+    m_end = kHeaderSize + kept;
+    writeEnd();
+    qDebug() << "EditJournal: compacted, kept" << m_frames.size() << "entries";
+}
+
+std::optional<JournalEntry> EditJournal::entry(int i) const
+{
+    if (!m_map || i < 0 || i >= m_frames.size())
+        return std::nullopt;
+    const qint64 pos = m_frames[i];
+    return decode(m_map + pos + kFrameHead, qFromLittleEndian<quint32>(m_map + pos));
+}
+
+std::optional<JournalEntry> EditJournal::findByInput(quint64 hash) const
+{
+    const auto it = m_byInput.constFind(hash);
+    if (it == m_byInput.cend())
+        return std::nullopt;
+    return entry(*it);
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include <optional>
+
+// One replacement made by Knowbridge.
+struct JournalEntry {
+    qint64  timestamp = 0;      // ms since epoch
+    QString app;
+    QString action;
+    quint64 inputHash = 0;      // EditJournal::hashText(original)
+    int     offset = -1;        // character offset of the replaced text, -1 = unknown
+    QString original;
+    QString result;
+};
+
+/**
+ *  Append-only journal of edits in a memory-mapped file of fixed size.
+ *
+ *  Layout: 16-byte header (magic, version, end of data), then frames of
+ *  [u32 payload length][u32 checksum][payload], little endian. On open the
+ *  frames are scanned and the first damaged one ends the journal. When the
+ *  file is full, the newest half is kept and the rest dropped.
+ */
+class EditJournal
+{
+public:
+    static constexpr qint64 kDefaultCapacity = 4 * 1024 * 1024;
+
+    explicit EditJournal(qint64 capacity = kDefaultCapacity);
+    ~EditJournal();
+
+    bool open(const QString& path = defaultPath());
+    bool isOpen() const { return m_map != nullptr; }
+
+    bool append(const JournalEntry& e);
+
+    int size() const { return int(m_frames.size()); }
+    std::optional<JournalEntry> entry(int i) const;        // 0 = oldest
+    std::optional<JournalEntry> last() const { return entry(size() - 1); }
+    // Newest entry whose original text had this hash.
+    std::optional<JournalEntry> findByInput(quint64 hash) const;
+
+    static quint64 hashText(const QString& text);
+    static QString defaultPath();
+
+private:
+    bool scan();
+    void compact(qint64 needed);
+    void writeEnd();
+    static QByteArray encode(const JournalEntry& e);
+    static std::optional<JournalEntry> decode(const uchar* data, qint64 len);
+
+    QFile   m_file;
+    uchar*  m_map = nullptr;
+    qint64  m_capacity;
+    qint64  m_end = 0;                  // end of the last valid frame
+    QVector<qint64>       m_frames;     // frame offsets, oldest first
+    QHash<quint64, int>   m_byInput;    // input hash -> index in m_frames
+};
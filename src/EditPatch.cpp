@@ -0,0 +1,76 @@
+#include "EditPatch.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QVector>
+
+#include <algorithm>
+
+namespace EditPatch {
+
+QString prompt(const QString& userPrompt)
+{
+    return userPrompt + QStringLiteral(
+            "\n\nDo NOT return the whole text. Return ONLY a JSON array of edits, "
+            "each an object {\"find\": \"...\", \"replace\": \"...\"} where \"find\" is copied "
+            "exactly from the input and \"replace\" is its new text. "
+            "Make every \"find\" just long enough to occur only once in the input, "
+            "and do not let edits overlap. Return [] if nothing needs to change. "
+            "No code fences or comments.");
+}
+
+std::optional<QString> apply(const QString& text, const QString& reply)
+{
+    // Same tolerance as BatchPrompt::unpack: fences and chatter around the array.
+    const qsizetype from = reply.indexOf(QLatin1Char('['));
+    const qsizetype to   = reply.lastIndexOf(QLatin1Char(']'));
+    if (from < 0 || to <= from)
+        return std::nullopt;
+
+    QJsonParseError err{};
+    const auto doc = QJsonDocument::fromJson(reply.mid(from, to - from + 1).toUtf8(), &err);
+    if (err.error != QJsonParseError::NoError || !doc.isArray())
+        return std::nullopt;
+
+    struct Edit {
+        qsizetype pos;
+        qsizetype len;
+        QString   replace;
+    };
+    QVector<Edit> edits;
+    const QJsonArray arr = doc.array();
+    edits.reserve(arr.size());
+    for (const auto& v : arr) {
+        const QJsonObject o = v.toObject();
+        const QJsonValue find    = o.value(QStringLiteral("find"));
+        const QJsonValue replace = o.value(QStringLiteral("replace"));
+        if (!find.isString() || !replace.isString())
+            return std::nullopt;
+        const QString f = find.toString();
+        if (f.isEmpty())
+            return std::nullopt;
+        // Exactly one occurrence, else the model guessed or was lazy.
+        const qsizetype pos = text.indexOf(f);
+        if (pos < 0 || text.indexOf(f, pos + 1) >= 0)
+            return std::nullopt;
+        edits << Edit{pos, f.size(), replace.toString()};
+    }
+
+    std::sort(edits.begin(), edits.end(),
+              [](const Edit& a, const Edit& b) { return a.pos < b.pos; });
+    QString out;
+    out.reserve(text.size());
+    qsizetype at = 0;
+    for (const Edit& e : std::as_const(edits)) {
+        if (e.pos < at)
+            return std::nullopt;        // overlaps the previous edit
+        out += QStringView(text).mid(at, e.pos - at);
+        out += e.replace;
+        at = e.pos + e.len;
+    }
+    out += QStringView(text).mid(at);
+    return out;
+}
+
+} // namespace EditPatch
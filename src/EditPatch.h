@@ -0,0 +1,21 @@
+#pragma once
+#include <QString>
+
+#include <optional>
+
+/**
+ *  Edits instead of the whole text.
+ *  The model answers with a JSON array of {"find", "replace"} pairs, which
+ *  are applied here, so the reply grows with the number of changes rather
+ *  than with the length of the input.
+ */
+namespace EditPatch {
+
+// User prompt extended with the output contract for a list of edits.
+QString prompt(const QString& userPrompt);
+
+// `text` with the edits of `reply` applied; empty if the reply is not a
+// valid edit list for `text` (a "find" missing, ambiguous or overlapping).
+std::optional<QString> apply(const QString& text, const QString& reply);
+
+} // namespace EditPatch
@@ -0,0 +1,403 @@
+#include "LlamaClient.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QHash>
+#include <QScopeGuard>
+#include <QThread>
+#include <QTimer>
+#include <QWeakPointer>
+#include <KLocalizedString>
+
+#ifdef HAVE_LLAMA
+#include <llama.h>
+
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#endif
+
+/*---------------------------------------------------------------------------
+ *  Loaded model, shared by all clients which use the same GGUF file.
+ *-------------------------------------------------------------------------*/
+struct LlamaModel
+{
+    QString path;
+    QMutex  loadMutex;
+    bool    loadAttempted = false;
+    QString loadError;
+#ifdef HAVE_LLAMA
+    llama_model* model = nullptr;
+
+    ~LlamaModel()
+    {
+        if (model)
+            llama_model_free(model);
+    }
+#endif
+};
+
+namespace {
+
+QMutex registryMutex;
+QHash<QString, QWeakPointer<LlamaModel>> registry;
+
+QSharedPointer<LlamaModel> sharedModel(const QString& path)
+{
+    QMutexLocker lock(&registryMutex);
+    if (auto existing = registry.value(path).toStrongRef())
+        return existing;
+
+    QSharedPointer<LlamaModel> m(new LlamaModel);
+    m->path = path;
+    registry.insert(path, m);
+    return m;
+}
+
+#ifdef HAVE_LLAMA
+// Length of the longest prefix of `s` that does not end inside a UTF-8 sequence.
+size_t completeUtf8Prefix(const std::string& s)
+{
+    size_t i = s.size();
+    for (size_t back = 0; back < 4 && i > 0; ++back) {
+        const unsigned char c = static_cast<unsigned char>(s[i - 1]);
+        if ((c & 0xC0) == 0x80) { --i; continue; }       // continuation byte
+        size_t need = 1;
+        if ((c & 0xE0) == 0xC0)      need = 2;
+        else if ((c & 0xF0) == 0xE0) need = 3;
+        else if ((c & 0xF8) == 0xF0) need = 4;
+        return (s.size() - (i - 1) >= need) ? s.size() : i - 1;
+    }
+    return s.size();
+}
+
+bool ensureLoaded(LlamaModel* m)
+{
+    QMutexLocker lock(&m->loadMutex);
+    if (m->loadAttempted)
+        return m->model != nullptr;
+    m->loadAttempted = true;
+
+    static std::once_flag backendOnce;
+    std::call_once(backendOnce, []{ llama_backend_init(); });
+
+    QElapsedTimer t; t.start();
+    llama_model_params mp = llama_model_default_params();
+    mp.n_gpu_layers = 0;        // CPU path
+    mp.use_mmap     = true;     // weights stay in the page cache between requests
+    m->model = llama_model_load_from_file(m->path.toLocal8Bit().constData(), mp);
+    if (!m->model) {
+        m->loadError = i18n("Cannot load model file %1.", m->path);
+        return false;
+    }
+    qInfo() << "llama.cpp: loaded" << m->path << "in" << t.elapsed() << "ms";
+    return true;
+}
+#endif
+
+} // namespace
+
+LlamaClient::LlamaClient(const QString& modelPath,
+                         const QString& systemPrompt,
+                         int threads,
+                         int contextSize,
+                         QObject* parent)
+        : TextBackend(parent)
+        , m_modelPath(modelPath)
+        , m_systemPrompt(systemPrompt)
+        , m_threads(threads > 0 ? threads : QThread::idealThreadCount())
+        , m_contextSize(contextSize > 0 ? contextSize : 4096)
+        , m_model(sharedModel(modelPath))
+{
+    // One sequence at a time: llama.cpp already spreads a decode over m_threads.
+    m_pool.setMaxThreadCount(1);
+    m_pool.setExpiryTimeout(-1);
+}
+
+LlamaClient::~LlamaClient()
+{
+    // Drop queued jobs: each would load the model before it could notice
+    // m_stopping, and waitForDone() blocks the GUI thread until they end.
+    m_stopping = true;
+    m_pool.clear();
+    m_pool.waitForDone();
+#ifdef HAVE_LLAMA
+    for (llama_context* ctx : std::as_const(m_idleContexts))
+        llama_free(ctx);
+#endif
+}
+
+bool LlamaClient::isAvailable()
+{
+#ifdef HAVE_LLAMA
+    return true;
+#else
+    return false;
+#endif
+}
+
+quint64 LlamaClient::processText(const QString& text, const QString& userPrompt,
+                                 const RequestOptions& options)
+{
+    const quint64 id = startRequest();
+#ifdef HAVE_LLAMA
+    const QString user = userMessage(text, userPrompt);
+    const QString sys  = m_systemPrompt.isEmpty() ? defaultSystemPrompt() : m_systemPrompt;
+    {
+        QMutexLocker lock(&m_cancelMutex);
+        m_live.insert(id);
+    }
+    m_pool.start([this, id, user, sys, options]{ generate(id, user, sys, options); });
+#else
+    Q_UNUSED(text);
+    Q_UNUSED(userPrompt);
+    Q_UNUSED(options);
+    QTimer::singleShot(0, this, [this, id]{
+        failRequest(id, i18n("Knowbridge was built without llama.cpp support."));
+    });
+#endif
+    return id;
+}
+
+void LlamaClient::cancel(quint64 requestId)
+{
+    QMutexLocker lock(&m_cancelMutex);
+    if (m_live.contains(requestId))     // ids of ended requests would pile up
+        m_cancelled.insert(requestId);
+}
+
+bool LlamaClient::takeCancelled(quint64 requestId)
+{
+    QMutexLocker lock(&m_cancelMutex);
+    return m_cancelled.remove(requestId);
+}
+
+void LlamaClient::setGenerationSettings(const QString& model, const QString& systemPrompt)
+{
+    Q_UNUSED(model);            // the model is the GGUF file, a backend setting
+    m_systemPrompt = systemPrompt;
+}
+
+// Loads the weights and prepares a context, so the first edit only pays for
+// prompt processing.
+quint64 LlamaClient::warmUp()
+{
+    const quint64 id = startRequest();
+    m_pool.start([this, id]{
+        if (m_stopping)
+            return;             // nobody is left to report to
+        QString error;
+        llama_context* ctx = acquireContext(&error);
+        if (ctx)
+            releaseContext(ctx);
+        QMetaObject::invokeMethod(this, [this, id, ok = ctx != nullptr, error]{
+            if (ok)
+                finishRequest(id, QString());
+            else
+                failRequest(id, error.isEmpty()
+                        ? i18n("Knowbridge was built without llama.cpp support.") : error);
+        }, Qt::QueuedConnection);
+    });
+    return id;
+}
+
+llama_context* LlamaClient::acquireContext(QString* error)
+{
+#ifdef HAVE_LLAMA
+    {
+        QMutexLocker lock(&m_ctxMutex);
+        if (!m_idleContexts.isEmpty())
+            return m_idleContexts.takeLast();
+    }
+    if (!ensureLoaded(m_model.data())) {
+        *error = m_model->loadError;
+        return nullptr;
+    }
+    llama_context_params cp = llama_context_default_params();
+    cp.n_ctx           = static_cast<uint32_t>(m_contextSize);
+    cp.n_batch         = static_cast<uint32_t>(m_contextSize);
+    cp.n_threads       = m_threads;
+    cp.n_threads_batch = m_threads;
+    cp.no_perf         = true;
+    llama_context* ctx = llama_init_from_model(m_model->model, cp);
+    if (!ctx)
+        *error = i18n("Cannot create llama.cpp context.");
+    return ctx;
+#else
+    Q_UNUSED(error);
+    return nullptr;
+#endif
+}
+
+void LlamaClient::releaseContext(llama_context* ctx)
+{
+#ifdef HAVE_LLAMA
+    llama_memory_clear(llama_get_memory(ctx), true);
+    QMutexLocker lock(&m_ctxMutex);
+    m_idleContexts << ctx;
+#else
+    Q_UNUSED(ctx);
+#endif
+}
+
+// Runs on a pool thread. Results are posted back to the GUI thread; the
+// destructor waits for the pool, so `this` outlives every queued call here.
+void LlamaClient::generate(quint64 requestId, const QString& userText,
+                           const QString& systemPrompt, const RequestOptions& options)
+{
+#ifdef HAVE_LLAMA
+    QElapsedTimer elapsed;
+    elapsed.start();
+    const auto ended = qScopeGuard([this, requestId]{
+        QMutexLocker lock(&m_cancelMutex);
+        m_live.remove(requestId);
+        m_cancelled.remove(requestId);
+    });
+    auto fail = [this, requestId](const QString& msg) {
+        QMetaObject::invokeMethod(this, [this, requestId, msg]{
+            failRequest(requestId, msg);
+        }, Qt::QueuedConnection);
+    };
+
+    if (m_stopping || takeCancelled(requestId)) {   // cancelled while queued
+        fail(i18n("Request cancelled."));
+        return;
+    }
+    QString error;
+    llama_context* ctx = acquireContext(&error);
+    if (!ctx) {
+        fail(error);
+        return;
+    }
+    const llama_vocab* vocab = llama_model_get_vocab(m_model->model);
+
+    /* --- chat template ---------------------------------------------------- */
+    const QByteArray sys  = systemPrompt.toUtf8();
+    const QByteArray user = userText.toUtf8();
+    const llama_chat_message msgs[] = {
+            {"system", sys.constData()},
+            {"user",   user.constData()},
+    };
+    const char* tmpl = llama_model_chat_template(m_model->model, nullptr);
+    if (!tmpl)
+        tmpl = "chatml";
+    std::vector<char> formatted(static_cast<size_t>(sys.size() + user.size()) * 2 + 256);
+    int32_t len = llama_chat_apply_template(tmpl, msgs, 2, true,
+                                            formatted.data(), int32_t(formatted.size()));
+    if (len > int32_t(formatted.size())) {
+        formatted.resize(size_t(len));
+        len = llama_chat_apply_template(tmpl, msgs, 2, true,
+                                        formatted.data(), int32_t(formatted.size()));
+    }
+    if (len < 0) {
+        releaseContext(ctx);
+        fail(i18n("Cannot apply the model chat template."));
+        return;
+    }
+
+    /* --- tokenize ---------------------------------------------------------- */
+    const int32_t nPrompt = -llama_tokenize(vocab, formatted.data(), len, nullptr, 0, true, true);
+    std::vector<llama_token> tokens(size_t(qMax(nPrompt, 0)));
+    if (nPrompt <= 0
+        || llama_tokenize(vocab, formatted.data(), len, tokens.data(), nPrompt, true, true) < 0) {
+        releaseContext(ctx);
+        fail(i18n("Cannot tokenize the prompt."));
+        return;
+    }
+    const int nCtx = int(llama_n_ctx(ctx));
+    if (nPrompt >= nCtx) {
+        releaseContext(ctx);
+        fail(i18n("Text is too long for the model context (%1 tokens).", nCtx));
+        return;
+    }
+
+    /* --- decode loop ------------------------------------------------------- */
+    llama_sampler* smpl = llama_sampler_chain_init(llama_sampler_chain_default_params());
+    if (options.temperature > 0) {
+        llama_sampler_chain_add(smpl, llama_sampler_init_temp(float(options.temperature)));
+        llama_sampler_chain_add(smpl, llama_sampler_init_dist(LLAMA_DEFAULT_SEED));
+    } else {
+        llama_sampler_chain_add(smpl, llama_sampler_init_greedy());
+    }
+    const int maxPos = options.maxTokens > 0 ? qMin(nCtx, nPrompt + options.maxTokens) : nCtx;
+
+    std::string pending;        // bytes not yet forwarded (may hold a partial UTF-8 char)
+    QString     result;
+    bool        ok = true;
+    bool        cancelled = false;
+    llama_batch batch = llama_batch_get_one(tokens.data(), nPrompt);
+    llama_token tok = 0;
+    int         generated = 0;
+    qint64      ttftMs = -1;
+
+    for (int pos = nPrompt; pos < maxPos && !m_stopping; ++pos) {
+        if (llama_decode(ctx, batch) != 0) {
+            ok = false;
+            break;
+        }
+        tok = llama_sampler_sample(smpl, ctx, -1);
+        if (llama_vocab_is_eog(vocab, tok))
+            break;
+        if (takeCancelled(requestId)) {
+            cancelled = true;
+            break;
+        }
+        if (generated++ == 0)
+            ttftMs = elapsed.elapsed();
+
+        char piece[256];
+        const int32_t n = llama_token_to_piece(vocab, tok, piece, sizeof piece, 0, true);
+        if (n > 0)
+            pending.append(piece, size_t(n));
+
+        const size_t ready = completeUtf8Prefix(pending);
+        if (ready > 0) {
+            const QString delta = QString::fromUtf8(pending.data(), qsizetype(ready));
+            pending.erase(0, ready);
+            result += delta;
+            QMetaObject::invokeMethod(this, [this, requestId, delta]{
+                Q_EMIT partialResult(requestId, delta);
+            }, Qt::QueuedConnection);
+        }
+        batch = llama_batch_get_one(&tok, 1);
+    }
+    llama_sampler_free(smpl);
+    releaseContext(ctx);
+
+    if (m_stopping)
+        return;
+    if (cancelled) {
+        fail(i18n("Request cancelled."));
+        return;
+    }
+    if (!ok) {
+        fail(i18n("llama.cpp failed to decode."));
+        return;
+    }
+    result += QString::fromUtf8(pending.data(), qsizetype(pending.size()));
+    result = result.trimmed();
+    if (result.isEmpty()) {
+        fail(i18n("Empty content in reply."));
+        return;
+    }
+    RequestMetrics metrics;
+    metrics.endpoint         = m_modelPath;
+    metrics.model            = QFileInfo(m_modelPath).completeBaseName();
+    metrics.label            = options.label;
+    metrics.promptTokens     = nPrompt;
+    metrics.completionTokens = generated;
+    metrics.ttftMs           = ttftMs;
+    metrics.totalMs          = elapsed.elapsed();
+    QMetaObject::invokeMethod(this, [this, requestId, result, metrics]{
+        Q_EMIT requestMetrics(requestId, metrics);
+        finishRequest(requestId, result);
+    }, Qt::QueuedConnection);
+#else
+    Q_UNUSED(requestId);
+    Q_UNUSED(userText);
+    Q_UNUSED(systemPrompt);
+    Q_UNUSED(options);
+#endif
+}
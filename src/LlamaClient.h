@@ -0,0 +1,63 @@
+#pragma once
+#include <QMutex>
+#include <QSet>
+#include <QSharedPointer>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+
+#include <atomic>
+
+#include "TextBackend.h"
+
+struct LlamaModel;
+struct llama_context;
+
+/**
+ *  In-process backend: runs a GGUF model through llama.cpp.
+ *  The model is mmapped once and shared between client instances with the
+ *  same file, so re-creating the client after a config change stays warm.
+ *  Generation runs on a private thread pool; tokens are streamed back through
+ *  `partialResult` on the GUI thread.
+ */
+class LlamaClient : public TextBackend
+{
+Q_OBJECT
+public:
+    explicit LlamaClient(const QString& modelPath,
+                         const QString& systemPrompt,
+                         int threads,
+                         int contextSize,
+                         QObject* parent = nullptr);
+    ~LlamaClient() override;
+
+    // Of the options, temperature and maxTokens apply; the model is the file.
+    quint64 processText(const QString& text, const QString& userPrompt,
+                        const RequestOptions& options = {}) override;
+    quint64 warmUp() override;
+    void setGenerationSettings(const QString& model, const QString& systemPrompt) override;
+    void cancel(quint64 requestId) override;
+
+    static bool isAvailable();          // built with llama.cpp support?
+
+private:
+    void generate(quint64 requestId, const QString& userText, const QString& systemPrompt,
+                  const RequestOptions& options);
+    bool takeCancelled(quint64 requestId);     // any thread
+    llama_context* acquireContext(QString* error);
+    void releaseContext(llama_context* ctx);
+
+    QString m_modelPath;
+    QString m_systemPrompt;
+    int     m_threads;
+    int     m_contextSize;
+
+    QSharedPointer<LlamaModel> m_model;         // shared, keeps weights warm
+    QThreadPool                m_pool;          // generation workers
+    QMutex                     m_ctxMutex;
+    QVector<llama_context*>    m_idleContexts;  // reused KV caches
+    std::atomic_bool           m_stopping{false};
+    QMutex                     m_cancelMutex;
+    QSet<quint64>              m_live;          // queued or generating
+    QSet<quint64>              m_cancelled;     // requests to stop, a subset of m_live
+};
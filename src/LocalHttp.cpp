@@ -0,0 +1,349 @@
+#include "LocalHttp.h"
+
+#include <QDebug>
+#include <QLocalSocket>
+#include <QUrl>
+#include <QUrlQuery>
+
+namespace {
+constexpr qsizetype kMaxHeaderBytes = 64 * 1024;
+}
+
+/*---------------------------------------------------------------------------
+ *  LocalHttpReply
+ *-------------------------------------------------------------------------*/
+LocalHttpReply::LocalHttpReply(LocalHttpClient* client, QString socketPath, QByteArray request)
+        : QObject(client)
+        , m_client(client)
+        , m_socketPath(std::move(socketPath))
+        , m_request(std::move(request))
+{
+}
+
+LocalHttpReply::~LocalHttpReply()
+{
+    if (m_socket)
+        detachSocket(false);
+}
+
+void LocalHttpReply::start(QLocalSocket* socket, bool reused)
+{
+    m_socket = socket;
+    m_reused = reused;
+    m_state = State::Connecting;
+    connect(m_socket, &QLocalSocket::readyRead,    this, &LocalHttpReply::onReadyRead);
+    connect(m_socket, &QLocalSocket::disconnected, this, &LocalHttpReply::onDisconnected);
+    connect(m_socket, &QLocalSocket::errorOccurred, this, [this] {
+        // A closed peer is handled in onDisconnected.
+        if (m_socket && m_socket->error() != QLocalSocket::PeerClosedError)
+            onDisconnected();
+    });
+    if (m_socket->state() == QLocalSocket::ConnectedState) {
+        onConnected();
+    } else {
+        connect(m_socket, &QLocalSocket::connected, this, &LocalHttpReply::onConnected);
+        m_socket->connectToServer(m_socketPath);
+    }
+}
+
+void LocalHttpReply::onConnected()
+{
+    m_state = State::Headers;
+    m_socket->write(m_request);
+}
+
+void LocalHttpReply::onReadyRead()
+{
+    if (!m_socket || m_state == State::Done)
+        return;
+    m_buf += m_socket->readAll();
+    m_gotData = true;
+    parse();
+}
+
+void LocalHttpReply::onDisconnected()
+{
+    if (!m_socket || m_state == State::Done)
+        return;
+    m_buf += m_socket->readAll();
+    if (!m_buf.isEmpty())
+        parse();
+    if (m_state == State::Done)
+        return;
+    if (m_state == State::UntilClose) {
+        detachSocket(false);
+        finish(NoError);
+        return;
+    }
+    // The server dropped an idle keep-alive connection just as we reused it.
+    if (m_reused && !m_gotData && !m_retried && m_client) {
+        m_retried = true;
+        detachSocket(false);
+        bool reused = false;
+        start(m_client->takeSocket(m_socketPath, &reused), false);
+        return;
+    }
+    const QString why = m_socket->errorString();
+    detachSocket(false);
+    finish(ConnectionError, why);
+}
+
+bool LocalHttpReply::parseHeaders(const QByteArray& head)
+{
+    const QList<QByteArray> lines = head.split('\n');
+    const QList<QByteArray> status = lines.value(0).trimmed().split(' ');
+    if (status.size() < 2 || !status[0].startsWith("HTTP/1."))
+        return false;
+    bool ok = false;
+    m_status = status[1].toInt(&ok);
+    if (!ok)
+        return false;
+    m_closeAfter = status[0] == "HTTP/1.0";
+
+    qint64 length = -1;
+    bool chunked = false;
+    for (qsizetype i = 1; i < lines.size(); ++i) {
+        const QByteArray line = lines[i].trimmed();
+        const qsizetype colon = line.indexOf(':');
+        if (colon <= 0)
+            continue;
+        const QByteArray name  = line.left(colon).trimmed().toLower();
+        const QByteArray value = line.mid(colon + 1).trimmed().toLower();
+        if (name == "content-length")
+            length = value.toLongLong();
+        else if (name == "transfer-encoding")
+            chunked = value.contains("chunked");
+        else if (name == "connection")
+            m_closeAfter = value.contains("close") || (m_closeAfter && !value.contains("keep-alive"));
+    }
+
+    if (m_status / 100 == 1) {             // 100 Continue: the real head follows
+        m_state = State::Headers;
+    } else if (m_status == 204 || m_status == 304) {
+        m_state = State::Done;
+    } else if (chunked) {
+        m_state = State::ChunkSize;
+    } else if (length >= 0) {
+        m_remaining = length;
+        m_state = length > 0 ? State::Body : State::Done;
+    } else {
+        m_state = State::UntilClose;
+        m_closeAfter = true;
+    }
+    return true;
+}
+
+void LocalHttpReply::parse()
+{
+    const qsizetype bodyBefore = m_body.size();
+    bool progress = true;
+    while (progress && m_state != State::Done) {
+        progress = false;
+        switch (m_state) {
+        case State::Connecting:
+            return;
+        case State::Headers: {
+            const qsizetype end = m_buf.indexOf("\r\n\r\n");
+            if (end < 0) {
+                if (m_buf.size() > kMaxHeaderBytes) {
+                    finish(ProtocolError, QStringLiteral("Response header too large"));
+                    return;
+                }
+                break;
+            }
+            if (!parseHeaders(m_buf.left(end))) {
+                finish(ProtocolError, QStringLiteral("Malformed HTTP response"));
+                return;
+            }
+            m_buf.remove(0, end + 4);
+            progress = true;
+            break;
+        }
+        case State::Body:
+        case State::ChunkData: {
+            const qint64 n = qMin<qint64>(m_remaining, m_buf.size());
+            if (n == 0)
+                break;
+            m_body += m_buf.left(n);
+            m_buf.remove(0, n);
+            m_remaining -= n;
+            if (m_remaining == 0)
+                m_state = m_state == State::Body ? State::Done : State::ChunkEnd;
+            progress = true;
+            break;
+        }
+        case State::ChunkSize: {
+            const qsizetype eol = m_buf.indexOf("\r\n");
+            if (eol < 0)
+                break;
+            QByteArray size = m_buf.left(eol);
+            if (const qsizetype ext = size.indexOf(';'); ext >= 0)
+                size.truncate(ext);
+            bool ok = false;
+            m_remaining = size.trimmed().toLongLong(&ok, 16);
+            if (!ok || m_remaining < 0) {
+                finish(ProtocolError, QStringLiteral("Bad chunk size"));
+                return;
+            }
+            m_buf.remove(0, eol + 2);
+            m_state = m_remaining == 0 ? State::Trailers : State::ChunkData;
+            progress = true;
+            break;
+        }
+        case State::ChunkEnd:
+            if (m_buf.size() < 2)
+                break;
+            m_buf.remove(0, 2);
+            m_state = State::ChunkSize;
+            progress = true;
+            break;
+        case State::Trailers: {
+            const qsizetype eol = m_buf.indexOf("\r\n");
+            if (eol < 0)
+                break;
+            m_buf.remove(0, eol + 2);
+            if (eol == 0)
+                m_state = State::Done;
+            progress = true;
+            break;
+        }
+        case State::UntilClose:
+            m_body += m_buf;
+            m_buf.clear();
+            break;
+        case State::Done:
+            break;
+        }
+    }
+    if (m_body.size() > bodyBefore)
+        Q_EMIT readyRead();
+    if (m_state == State::Done && m_socket) {
+        detachSocket(!m_closeAfter && m_buf.isEmpty());
+        finish(NoError);
+    }
+}
+
+QByteArray LocalHttpReply::readAll()
+{
+    QByteArray out;
+    out.swap(m_body);
+    return out;
+}
+
+void LocalHttpReply::abort()
+{
+    if (m_state == State::Done)
+        return;
+    detachSocket(false);
+    finish(OperationCanceled, QStringLiteral("Operation canceled"));
+}
+
+void LocalHttpReply::detachSocket(bool keepAlive)
+{
+    QLocalSocket* s = m_socket;
+    m_socket = nullptr;
+    if (!s)
+        return;
+    s->disconnect(this);
+    if (m_client)
+        m_client->releaseSocket(m_socketPath, s, keepAlive);
+    else
+        s->deleteLater();
+}
+
+void LocalHttpReply::finish(Error error, const QString& message)
+{
+    if (m_socket)
+        detachSocket(false);
+    m_state = State::Done;
+    m_error = error;
+    m_errorString = message;
+    // Queued: post() may not have returned yet, so nobody would be connected.
+    QMetaObject::invokeMethod(this, [this] { Q_EMIT finished(); }, Qt::QueuedConnection);
+}
+
+/*---------------------------------------------------------------------------
+ *  LocalHttpClient
+ *-------------------------------------------------------------------------*/
+LocalHttpClient::LocalHttpClient(QObject* parent)
+        : QObject(parent)
+{
+}
+
+LocalHttpClient::~LocalHttpClient()
+{
+    // Sockets of replies still running are our children as well and may be
+    // older than the reply: let go of them while both are alive.
+    const auto replies = findChildren<LocalHttpReply*>(Qt::FindDirectChildrenOnly);
+    for (LocalHttpReply* r : replies) {
+        r->m_client = nullptr;
+        r->detachSocket(false);
+    }
+    for (const auto& list : std::as_const(m_idle))
+        qDeleteAll(list);
+}
+
+bool LocalHttpClient::isLocalUrl(const QUrl& url)
+{
+    return url.scheme() == QLatin1String("unix");
+}
+
+LocalHttpReply* LocalHttpClient::post(const QUrl& url,
+                                      const QList<QPair<QByteArray, QByteArray>>& headers,
+                                      const QByteArray& body)
+{
+    const QString socketPath = url.path();
+    QString path = QUrlQuery(url).queryItemValue(QStringLiteral("path"), QUrl::FullyDecoded);
+    if (path.isEmpty())
+        path = QStringLiteral("/v1/chat/completions");
+
+    QByteArray req;
+    req.reserve(body.size() + 256);
+    req += "POST " + path.toUtf8() + " HTTP/1.1\r\n"
+           "Host: localhost\r\n"
+           "Connection: keep-alive\r\n"
+           "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    for (const auto& h : headers)
+        req += h.first + ": " + h.second + "\r\n";
+    req += "\r\n";
+    req += body;
+
+    auto* reply = new LocalHttpReply(this, socketPath, req);
+    bool reused = false;
+    QLocalSocket* socket = takeSocket(socketPath, &reused);
+    reply->start(socket, reused);
+    return reply;
+}
+
+QLocalSocket* LocalHttpClient::takeSocket(const QString& path, bool* reused)
+{
+    auto& idle = m_idle[path];
+    while (!idle.isEmpty()) {
+        QLocalSocket* s = idle.takeLast();
+        s->disconnect(this);
+        if (s->state() == QLocalSocket::ConnectedState) {
+            *reused = true;
+            return s;
+        }
+        s->deleteLater();
+    }
+    *reused = false;
+    return new QLocalSocket(this);
+}
+
+void LocalHttpClient::releaseSocket(const QString& path, QLocalSocket* socket, bool keepAlive)
+{
+    auto& idle = m_idle[path];
+    if (!keepAlive || socket->state() != QLocalSocket::ConnectedState
+        || idle.size() >= kMaxIdlePerPath) {
+        socket->abort();
+        socket->deleteLater();
+        return;
+    }
+    // Forget connections the server closes while they are idle.
+    connect(socket, &QLocalSocket::disconnected, this, [this, path, socket] {
+        m_idle[path].removeOne(socket);
+        socket->deleteLater();
+    });
+    idle << socket;
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPair>
+#include <QPointer>
+#include <QString>
+
+class QLocalSocket;
+class QUrl;
+class LocalHttpClient;
+
+/**
+ *  One HTTP/1.1 exchange over a Unix domain socket. The body is delivered
+ *  as it arrives (Content-Length, chunked or until close), so streamed
+ *  replies can be consumed before `finished`. Delete with deleteLater()
+ *  after `finished`, like a QNetworkReply. `finished` always comes from the
+ *  event loop, never from post() or abort() themselves: QLocalSocket
+ *  reports a missing or refusing server synchronously.
+ */
+class LocalHttpReply : public QObject
+{
+Q_OBJECT
+public:
+    enum Error { NoError, ConnectionError, ProtocolError, OperationCanceled };
+
+    ~LocalHttpReply() override;
+
+    int        statusCode() const { return m_status; }
+    Error      error() const { return m_error; }
+    QString    errorString() const { return m_errorString; }
+    bool       isFinished() const { return m_state == State::Done; }
+    QByteArray readAll();                   // body received since the last call
+    void       abort();
+
+Q_SIGNALS:
+    void readyRead();
+    void finished();
+
+private:
+    friend class LocalHttpClient;
+    enum class State { Connecting, Headers, Body, ChunkSize, ChunkData, ChunkEnd,
+                       Trailers, UntilClose, Done };
+
+    LocalHttpReply(LocalHttpClient* client, QString socketPath, QByteArray request);
+    void start(QLocalSocket* socket, bool reused);
+    void onConnected();
+    void onReadyRead();
+    void onDisconnected();
+    void parse();
+    bool parseHeaders(const QByteArray& head);
+    void finish(Error error, const QString& message = QString());
+    void detachSocket(bool keepAlive);
+
+    QPointer<LocalHttpClient> m_client;
+    QString      m_socketPath;
+    QByteArray   m_request;
+    QPointer<QLocalSocket> m_socket;        // a child of the client, like us
+    bool         m_reused = false;
+    bool         m_retried = false;
+    bool         m_gotData = false;
+
+    State        m_state = State::Connecting;
+    QByteArray   m_buf;                     // unparsed bytes
+    QByteArray   m_body;                    // body bytes not read yet
+    qint64       m_remaining = 0;           // of the body or the current chunk
+    bool         m_closeAfter = false;      // "Connection: close"
+    int          m_status = 0;
+    Error        m_error = NoError;
+    QString      m_errorString;
+};
+
+/**
+ *  Minimal HTTP/1.1 client for `unix:` URLs with a pool of keep-alive
+ *  connections per socket. Endpoint form:
+ *      unix:///run/llama.sock?path=/v1/chat/completions
+ *  (the request path defaults to /v1/chat/completions).
+ */
+class LocalHttpClient : public QObject
+{
+Q_OBJECT
+public:
+    explicit LocalHttpClient(QObject* parent = nullptr);
+    ~LocalHttpClient() override;
+
+    static bool isLocalUrl(const QUrl& url);
+
+    LocalHttpReply* post(const QUrl& url,
+                         const QList<QPair<QByteArray, QByteArray>>& headers,
+                         const QByteArray& body);
+
+private:
+    friend class LocalHttpReply;
+    QLocalSocket* takeSocket(const QString& path, bool* reused);
+    void releaseSocket(const QString& path, QLocalSocket* socket, bool keepAlive);
+
+    QHash<QString, QList<QLocalSocket*>> m_idle;    // per socket path
+    static constexpr int kMaxIdlePerPath = 4;
+};
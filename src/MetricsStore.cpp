@@ -0,0 +1,267 @@
+#include "MetricsStore.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <tuple>
+
+static constexpr int kSaveDelayMs = 5000;
+
+namespace {
+
+QByteArray label(const QString& s)
+{
+    QByteArray v = s.toUtf8();
+    v.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+    return v;
+}
+
+QByteArray number(double v)
+{
+    return QByteArray::number(v, 'g', 12);
+}
+
+} // namespace
+
+MetricsStore::MetricsStore(QObject* parent)
+        : QObject(parent)
+{
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(kSaveDelayMs);
+    connect(&m_saveTimer, &QTimer::timeout, this, &MetricsStore::save);
+}
+
+MetricsStore::~MetricsStore()
+{
+    if (m_saveTimer.isActive())
+        save();
+}
+
+QString MetricsStore::defaultPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+           + QStringLiteral("/metrics.json");
+}
+
+QString MetricsStore::exportPath() const
+{
+    const QFileInfo fi(m_path);
+    return fi.absolutePath() + QLatin1Char('/') + fi.completeBaseName() + QStringLiteral(".prom");
+}
+
+bool MetricsStore::load(const QString& path)
+{
+    m_path = path;
+    m_totals.clear();
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly))
+        return !f.exists();                 // nothing recorded yet
+    const QJsonArray entries = QJsonDocument::fromJson(f.readAll())
+            .object().value(QStringLiteral("entries")).toArray();
+    for (const QJsonValue& v : entries) {
+        const QJsonObject o = v.toObject();
+        const Key key{o.value(QStringLiteral("endpoint")).toString(),
+                      o.value(QStringLiteral("model")).toString(),
+                      o.value(QStringLiteral("action")).toString()};
+        auto u64 = [&o](const char* name) { return quint64(o.value(QLatin1String(name)).toDouble()); };
+        auto i64 = [&o](const char* name) { return qint64(o.value(QLatin1String(name)).toDouble()); };
+        Totals& t = m_totals[key];
+        t.requests         = u64("requests");
+        t.promptTokens     = u64("prompt_tokens");
+        t.completionTokens = u64("completion_tokens");
+        t.totalMs          = i64("total_ms");
+        t.maxMs            = i64("max_ms");
+        t.ttftCount        = u64("ttft_count");
+        t.ttftMs           = i64("ttft_ms");
+        t.decodeTokens     = u64("decode_tokens");
+        t.decodeMs         = i64("decode_ms");
+        t.predicted          = u64("predicted");
+        t.acceptedPrediction = u64("accepted_prediction_tokens");
+        t.rejectedPrediction = u64("rejected_prediction_tokens");
+        t.predictedTokens    = u64("predicted_tokens");
+        t.predictedMs        = i64("predicted_ms");
+        t.plainTokens        = u64("plain_tokens");
+        t.plainMs            = i64("plain_ms");
+    }
+    return true;
+}
+
+void MetricsStore::record(const RequestMetrics& m)
+{
+    Totals& t = m_totals[Key{m.endpoint, m.model, m.label}];
+    ++t.requests;
+    if (m.promptTokens > 0)
+        t.promptTokens += quint64(m.promptTokens);
+    if (m.completionTokens > 0)
+        t.completionTokens += quint64(m.completionTokens);
+    t.totalMs += m.totalMs;
+    t.maxMs = qMax(t.maxMs, m.totalMs);
+    if (m.ttftMs >= 0) {
+        ++t.ttftCount;
+        t.ttftMs += m.ttftMs;
+    }
+    if (m.decodeTokensPerSec() > 0) {
+        t.decodeTokens += quint64(m.completionTokens - 1);
+        t.decodeMs     += m.totalMs - m.ttftMs;
+    }
+    if (m.predicted) {
+        ++t.predicted;
+        if (m.acceptedPredictionTokens > 0)
+            t.acceptedPrediction += quint64(m.acceptedPredictionTokens);
+        if (m.rejectedPredictionTokens > 0)
+            t.rejectedPrediction += quint64(m.rejectedPredictionTokens);
+    }
+    // Rejected prediction tokens are billed as completion tokens but are
+    // not part of the output.
+    const int outputTokens = m.completionTokens - qMax(0, m.rejectedPredictionTokens);
+    if (outputTokens > 0) {
+        if (m.predicted) {
+            t.predictedTokens += quint64(outputTokens);
+            t.predictedMs     += m.totalMs;
+        } else {
+            t.plainTokens += quint64(outputTokens);
+            t.plainMs     += m.totalMs;
+        }
+    }
+    if (!m_path.isEmpty() && !m_saveTimer.isActive())
+        m_saveTimer.start();
+    Q_EMIT changed();
+}
+
+void MetricsStore::reset()
+{
+    m_totals.clear();
+    if (!m_path.isEmpty())
+        save();
+    Q_EMIT changed();
+}
+
+QVector<QPair<MetricsStore::Key, MetricsStore::Totals>> MetricsStore::rows() const
+{
+    QVector<QPair<Key, Totals>> out;
+    out.reserve(m_totals.size());
+    for (auto it = m_totals.cbegin(); it != m_totals.cend(); ++it)
+        out.append({it.key(), it.value()});
+    std::sort(out.begin(), out.end(), [](const auto& a, const auto& b) {
+        return std::tie(a.first.endpoint, a.first.model, a.first.action)
+               < std::tie(b.first.endpoint, b.first.model, b.first.action);
+    });
+    return out;
+}
+
+QByteArray MetricsStore::openMetrics() const
+{
+    const auto all = rows();
+    QByteArray out;
+    auto family = [&](const char* name, const char* type, const char* help,
+                      const auto& sample) {
+        out += QByteArray("# TYPE ") + name + ' ' + type + '\n'
+               + "# HELP " + name + ' ' + help + '\n';
+        for (const auto& [key, t] : all) {
+            const QByteArray labels = "{endpoint=\"" + label(key.endpoint)
+                                      + "\",model=\"" + label(key.model)
+                                      + "\",action=\"" + label(key.action) + "\"}";
+            sample(name, labels, t);
+        }
+    };
+    family("knowbridge_requests", "counter", "Successful requests.",
+           [&](const char* n, const QByteArray& l, const Totals& t) {
+               out += n + QByteArray("_total") + l + ' ' + QByteArray::number(t.requests) + '\n';
+           });
+    family("knowbridge_prompt_tokens", "counter", "Prompt tokens reported by the backend.",
+           [&](const char* n, const QByteArray& l, const Totals& t) {
+               out += n + QByteArray("_total") + l + ' ' + QByteArray::number(t.promptTokens) + '\n';
+           });
+    family("knowbridge_completion_tokens", "counter", "Completion tokens reported by the backend.",
+           [&](const char* n, const QByteArray& l, const Totals& t) {
+               out += n + QByteArray("_total") + l + ' ' + QByteArray::number(t.completionTokens) + '\n';
+           });
+    family("knowbridge_request_duration_seconds", "summary", "Time from sending to the last token.",
+           [&](const char* n, const QByteArray& l, const Totals& t) {
+               out += n + QByteArray("_count") + l + ' ' + QByteArray::number(t.requests) + '\n';
+               out += n + QByteArray("_sum") + l + ' ' + number(t.totalMs / 1000.0) + '\n';
+           });
+    family("knowbridge_time_to_first_token_seconds", "summary", "Time to the first streamed token.",
+           [&](const char* n, const QByteArray& l, const Totals& t) {
+               out += n + QByteArray("_count") + l + ' ' + QByteArray::number(t.ttftCount) + '\n';
+               out += n + QByteArray("_sum") + l + ' ' + number(t.ttftMs / 1000.0) + '\n';
+           });
+    family("knowbridge_decode_tokens_per_second", "gauge", "Average generation speed after the first token.",
+           [&](const char* n, const QByteArray& l, const Totals& t) {
+               out += n + l + ' ' + number(t.decodeTokensPerSec()) + '\n';
+           });
+    family("knowbridge_predicted_requests", "counter", "Requests sent with a predicted output.",
+           [&](const char* n, const QByteArray& l, const Totals& t) {
+               out += n + QByteArray("_total") + l + ' ' + QByteArray::number(t.predicted) + '\n';
+           });
+    family("knowbridge_prediction_accepted_tokens", "counter", "Predicted tokens the server kept.",
+           [&](const char* n, const QByteArray& l, const Totals& t) {
+               out += n + QByteArray("_total") + l + ' ' + QByteArray::number(t.acceptedPrediction) + '\n';
+           });
+    family("knowbridge_prediction_rejected_tokens", "counter", "Predicted tokens the server discarded.",
+           [&](const char* n, const QByteArray& l, const Totals& t) {
+               out += n + QByteArray("_total") + l + ' ' + QByteArray::number(t.rejectedPrediction) + '\n';
+           });
+    family("knowbridge_prediction_speedup", "gauge", "Time per output token without a prediction over that with one (0 = unknown).",
+           [&](const char* n, const QByteArray& l, const Totals& t) {
+               out += n + l + ' ' + number(t.predictionSpeedup()) + '\n';
+           });
+    out += "# EOF\n";
+    return out;
+}
+
+bool MetricsStore::save()
+{
+    m_saveTimer.stop();
+    QDir().mkpath(QFileInfo(m_path).absolutePath());
+
+    QJsonArray entries;
+    for (const auto& [key, t] : rows()) {
+        entries.append(QJsonObject{
+                {QStringLiteral("endpoint"),          key.endpoint},
+                {QStringLiteral("model"),             key.model},
+                {QStringLiteral("action"),            key.action},
+                {QStringLiteral("requests"),          double(t.requests)},
+                {QStringLiteral("prompt_tokens"),     double(t.promptTokens)},
+                {QStringLiteral("completion_tokens"), double(t.completionTokens)},
+                {QStringLiteral("total_ms"),          double(t.totalMs)},
+                {QStringLiteral("max_ms"),            double(t.maxMs)},
+                {QStringLiteral("ttft_count"),        double(t.ttftCount)},
+                {QStringLiteral("ttft_ms"),           double(t.ttftMs)},
+                {QStringLiteral("decode_tokens"),     double(t.decodeTokens)},
+                {QStringLiteral("decode_ms"),         double(t.decodeMs)},
+                {QStringLiteral("predicted"),         double(t.predicted)},
+                {QStringLiteral("accepted_prediction_tokens"), double(t.acceptedPrediction)},
+                {QStringLiteral("rejected_prediction_tokens"), double(t.rejectedPrediction)},
+                {QStringLiteral("predicted_tokens"),  double(t.predictedTokens)},
+                {QStringLiteral("predicted_ms"),      double(t.predictedMs)},
+                {QStringLiteral("plain_tokens"),      double(t.plainTokens)},
+                {QStringLiteral("plain_ms"),          double(t.plainMs)},
+        });
+    }
+    QSaveFile json(m_path);
+    if (!json.open(QIODevice::WriteOnly)) {
+        qWarning() << "MetricsStore: cannot write" << m_path;
+        return false;
+    }
+    json.write(QJsonDocument(QJsonObject{{QStringLiteral("version"), 1},
+                                         {QStringLiteral("entries"), entries}}).toJson());
+    if (!json.commit())
+        return false;
+
+    QSaveFile prom(exportPath());
+    if (!prom.open(QIODevice::WriteOnly)) {
+        qWarning() << "MetricsStore: cannot write" << exportPath();
+        return false;
+    }
+    prom.write(openMetrics());
+    return prom.commit();
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+
+#include "TextBackend.h"
+
+/**
+ *  Token usage and speed of finished requests, summed per endpoint, model
+ *  and action. Unlike SessionStats the totals are kept across sessions in
+ *  a small JSON file; every save also writes them in OpenMetrics text
+ *  format (metrics.prom next to it) for a textfile scraper.
+ */
+class MetricsStore : public QObject
+{
+Q_OBJECT
+public:
+    struct Key {
+        QString endpoint;
+        QString model;
+        QString action;
+
+        friend bool operator==(const Key& a, const Key& b)
+        {
+            return a.endpoint == b.endpoint && a.model == b.model && a.action == b.action;
+        }
+        friend size_t qHash(const Key& k, size_t seed = 0)
+        {
+            return qHashMulti(seed, k.endpoint, k.model, k.action);
+        }
+    };
+
+    struct Totals {
+        quint64 requests = 0;
+        quint64 promptTokens = 0;       // of requests that reported usage
+        quint64 completionTokens = 0;
+        qint64  totalMs = 0;
+        qint64  maxMs = 0;
+        quint64 ttftCount = 0;          // streamed requests
+        qint64  ttftMs = 0;
+        quint64 decodeTokens = 0;       // tokens after the first one ...
+        qint64  decodeMs = 0;           // ... and the time they took
+
+        // Predicted outputs (RequestOptions::predictInput)
+        quint64 predicted = 0;          // requests sent with a prediction
+        quint64 acceptedPrediction = 0; // tokens, as reported by the server
+        quint64 rejectedPrediction = 0;
+        // Output tokens and time, with and without a prediction, for the speed-up.
+        quint64 predictedTokens = 0;
+        qint64  predictedMs = 0;
+        quint64 plainTokens = 0;
+        qint64  plainMs = 0;
+
+        qint64 avgMs() const     { return requests ? totalMs / qint64(requests) : 0; }
+        qint64 avgTtftMs() const { return ttftCount ? ttftMs / qint64(ttftCount) : -1; }
+        double decodeTokensPerSec() const { return decodeMs > 0 ? decodeTokens * 1000.0 / double(decodeMs) : 0; }
+        // Share of predicted tokens the server kept, -1 if never reported.
+        double acceptedPredictionRatio() const
+        {
+            const quint64 all = acceptedPrediction + rejectedPrediction;
+            return all ? double(acceptedPrediction) / double(all) : -1;
+        }
+        // Time per output token without a prediction over that with one; 0 if unknown.
+        double predictionSpeedup() const
+        {
+            if (!predictedTokens || !plainTokens || predictedMs <= 0)
+                return 0;
+            return (double(plainMs) / double(plainTokens)) / (double(predictedMs) / double(predictedTokens));
+        }
+    };
+
+    explicit MetricsStore(QObject* parent = nullptr);
+    ~MetricsStore() override;
+
+    bool load(const QString& path = defaultPath());
+    void record(const RequestMetrics& m);
+    void reset();
+
+    // Sorted by endpoint, model, action.
+    QVector<QPair<Key, Totals>> rows() const;
+
+    QByteArray openMetrics() const;
+    QString path() const { return m_path; }
+    QString exportPath() const;
+    static QString defaultPath();
+
+Q_SIGNALS:
+    void changed();
+
+private:
+    bool save();
+
+    QHash<Key, Totals> m_totals;
+    QString m_path;
+    QTimer  m_saveTimer;                // batches writes
+};
@@ -0,0 +1,189 @@
+#include "NearDuplicateCache.h"
+
+#include <QStringView>
+#include <QtAlgorithms>
+
+#include <algorithm>
+#include <array>
+
+namespace {
+
+// Hamming distance of every fingerprint to `fp`, plus 0x100 where the
+// action key differs, so a plain minimum finds the nearest entry of the
+// same action (distances are at most 64). No branches and no state carried
+// between iterations, so the loop vectorizes; x86-64 builds with GCC get
+// VPOPCNTQ (AVX-512, Ice Lake and later), POPCNT and baseline clones,
+// picked at load time. AVX2 has no 64-bit popcount, so it gets no clone.
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+__attribute__((target_clones("arch=icelake-client", "popcnt", "default")))
+#endif
+void distances(const quint64* __restrict fps, const quint64* __restrict keys, int n,
+               quint64 fp, quint64 key, quint32* __restrict out)
+{
+    for (int i = 0; i < n; ++i)
+        out[i] = quint32(qPopulationCount(fps[i] ^ fp)) | (keys[i] == key ? 0u : 0x100u);
+}
+
+quint32 minimum(const quint32* d, int n)
+{
+    quint32 m = ~0u;
+    for (int i = 0; i < n; ++i)
+        m = d[i] < m ? d[i] : m;
+    return m;
+}
+
+quint64 fnv1a(QStringView s, quint64 h = 14695981039346656037ull)
+{
+    for (const QChar c : s) {
+        h ^= c.toLower().unicode();
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// 64-bit mixer (splitmix64 finalizer): FNV alone leaves the high bits of
+// short inputs poorly spread, which would bias the SimHash.
+quint64 mix(quint64 x)
+{
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27; x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+} // namespace
+
+NearDuplicateCache::NearDuplicateCache(int capacity, int maxDistance)
+        : m_capacity(qMax(1, capacity))
+        , m_maxDistance(maxDistance)
+{
+}
+
+quint64 NearDuplicateCache::actionKey(const QString& prompt, const QString& model,
+                                      const QString& systemPrompt)
+{
+    quint64 h = fnv1a(prompt);
+    h = fnv1a(model, mix(h));
+    return fnv1a(systemPrompt, mix(h));
+}
+
+quint64 NearDuplicateCache::simhash(const QString& text)
+{
+    // Word bigrams: a changed word flips the votes of two shingles only.
+    std::array<int, 64> votes{};
+    QStringView prev;
+    qsizetype i = 0;
+    const qsizetype n = text.size();
+    while (i < n) {
+        while (i < n && !text[i].isLetterOrNumber()) ++i;
+        const qsizetype start = i;
+        while (i < n && text[i].isLetterOrNumber()) ++i;
+        if (start == i)
+            break;
+        const QStringView word = QStringView(text).mid(start, i - start);
+        const quint64 h = mix(fnv1a(word, prev.isNull() ? 14695981039346656037ull
+                                                        : mix(fnv1a(prev))));
+        for (int b = 0; b < 64; ++b)
+            votes[b] += (h >> b) & 1 ? 1 : -1;
+        prev = word;
+    }
+    quint64 fp = 0;
+    for (int b = 0; b < 64; ++b)
+        if (votes[b] > 0)
+            fp |= quint64(1) << b;
+    return fp;
+}
+
+int NearDuplicateCache::nearest(const quint64* fps, const quint64* keys, int n,
+                                quint64 fp, quint64 key, int maxDistance)
+{
+    // Distances first, then the minimum: two loops without branches instead
+    // of one arg-min loop that does not vectorize. Blocks keep them in L1.
+    constexpr int kBlock = 256;
+    std::array<quint32, kBlock> d;
+    int best = -1;
+    quint32 bestDistance = quint32(maxDistance) + 1;
+    for (int base = 0; base < n; base += kBlock) {
+        const int m = qMin(kBlock, n - base);
+        distances(fps + base, keys + base, m, fp, key, d.data());
+        const quint32 low = minimum(d.data(), m);
+        if (low < bestDistance) {
+            bestDistance = low;
+            best = base + int(std::find(d.cbegin(), d.cbegin() + m, low) - d.cbegin());
+        }
+    }
+    return best;
+}
+
+std::optional<NearDuplicateCache::Plan> NearDuplicateCache::plan(quint64 key, const QString& text)
+{
+    ++m_stats.lookups;
+    const int i = nearest(m_fps.constData(), m_keys.constData(), int(m_fps.size()),
+                          simhash(text), key, m_maxDistance);
+    if (i < 0)
+        return std::nullopt;
+    const Entry& e = m_entries[i];
+
+    const auto split = Paragraphs::split(text);
+    Plan p;
+    p.parts = split.parts;
+    p.separators = split.separators;
+    if (e.input == text) {
+        ++m_stats.exact;
+        p.outputs = QStringList{e.output};
+        p.parts = QStringList{text};
+        p.separators.clear();
+        return p;
+    }
+    if (e.byParagraph.isEmpty())
+        return std::nullopt;
+
+    p.outputs.reserve(p.parts.size());
+    for (int k = 0; k < p.parts.size(); ++k) {
+        const auto it = e.byParagraph.constFind(p.parts[k]);
+        if (it != e.byParagraph.cend()) {
+            p.outputs << *it;
+        } else {
+            p.outputs << QString();
+            p.missing << k;
+        }
+    }
+    // Mostly rewritten text: one full request costs about the same and keeps
+    // the style of the output consistent.
+    if (p.missing.size() == p.parts.size() || p.missing.size() * 2 > p.parts.size() + 1)
+        return std::nullopt;
+    ++m_stats.partial;
+    m_stats.reusedParts += int(p.parts.size() - p.missing.size());
+    m_stats.sentParts += int(p.missing.size());
+    return p;
+}
+
+void NearDuplicateCache::insert(quint64 key, const QString& input, const QString& output)
+{
+    Entry e;
+    e.input = input;
+    e.output = output;
+    const auto in = Paragraphs::split(input);
+    const auto out = Paragraphs::split(output);
+    // Paragraph-level reuse needs the model to have kept the paragraph structure.
+    if (in.parts.size() > 1 && in.parts.size() == out.parts.size()) {
+        for (int k = 0; k < in.parts.size(); ++k)
+            e.byParagraph.insert(in.parts[k], out.parts[k]);
+    }
+
+    const quint64 fp = simhash(input);
+    const int same = nearest(m_fps.constData(), m_keys.constData(), int(m_fps.size()), fp, key, 0);
+    if (same >= 0 && m_entries[same].input == input) {
+        m_entries[same] = e;                // newer result for the same input
+        return;
+    }
+    if (m_fps.size() < m_capacity) {
+        m_fps << fp;
+        m_keys << key;
+        m_entries << e;
+        return;
+    }
+    m_fps[m_next] = fp;
+    m_keys[m_next] = key;
+    m_entries[m_next] = e;
+    m_next = (m_next + 1) % m_capacity;
+}
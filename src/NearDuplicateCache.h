@@ -0,0 +1,65 @@
+#pragma once
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "Paragraphs.h"
+
+#include <optional>
+
+/**
+ *  Results of earlier requests, found again for text that changed a little.
+ *
+ *  Every input gets a 64-bit SimHash over word shingles; fingerprints and
+ *  action keys live in two flat arrays, so a lookup is one linear
+ *  XOR + popcount pass. The nearest entry for the same action is then
+ *  compared paragraph by paragraph: unchanged paragraphs reuse the cached
+ *  output, only the others have to be sent.
+ */
+class NearDuplicateCache
+{
+public:
+    using Plan = Paragraphs::Plan;
+    struct Stats {
+        int lookups = 0;
+        int exact = 0;              // whole output reused
+        int partial = 0;            // some paragraphs reused
+        int reusedParts = 0;
+        int sentParts = 0;
+    };
+
+    explicit NearDuplicateCache(int capacity = 256, int maxDistance = 12);
+
+    // Identifies the action and generation settings a result belongs to.
+    static quint64 actionKey(const QString& prompt, const QString& model,
+                             const QString& systemPrompt);
+    static quint64 simhash(const QString& text);
+
+    // Reuse plan for `text`, or nothing if no entry is close enough to help.
+    std::optional<Plan> plan(quint64 key, const QString& text);
+    void insert(quint64 key, const QString& input, const QString& output);
+
+    // Index of the nearest fingerprint with the same key, -1 if none is
+    // within `maxDistance` bits.
+    static int nearest(const quint64* fps, const quint64* keys, int n,
+                       quint64 fp, quint64 key, int maxDistance);
+
+    const Stats& stats() const { return m_stats; }
+    int size() const { return int(m_fps.size()); }
+
+private:
+    struct Entry {
+        QString input;
+        QString output;
+        QHash<QString, QString> byParagraph;    // empty if outputs did not align
+    };
+
+    int             m_capacity;
+    int             m_maxDistance;
+    int             m_next = 0;                 // slot to overwrite when full
+    QVector<quint64> m_fps;                     // SimHash per slot
+    QVector<quint64> m_keys;                    // action key per slot
+    QVector<Entry>  m_entries;
+    Stats           m_stats;
+};
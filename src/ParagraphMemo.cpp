@@ -0,0 +1,73 @@
+#include "ParagraphMemo.h"
+
+ParagraphMemo::ParagraphMemo(int maxChars)
+        : m_cache(maxChars)
+{
+}
+
+quint64 ParagraphMemo::key(quint64 actionKey, const QString& paragraph)
+{
+    quint64 h = 14695981039346656037ull ^ actionKey;    // FNV-1a, seeded
+    for (const QChar c : paragraph) {
+        h ^= c.unicode();
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+const QString* ParagraphMemo::find(quint64 actionKey, const QString& paragraph)
+{
+    const Memo* m = m_cache.object(key(actionKey, paragraph));     // also bumps LRU order
+    return m && m->input == paragraph ? &m->output : nullptr;
+}
+
+void ParagraphMemo::store(quint64 actionKey, const QString& paragraph, const QString& output)
+{
+    const qsizetype cost = paragraph.size() + output.size() + 1;
+    m_cache.insert(key(actionKey, paragraph), new Memo{paragraph, output}, cost);
+}
+
+std::optional<Paragraphs::Plan> ParagraphMemo::plan(quint64 actionKey, const QString& text)
+{
+    const auto split = Paragraphs::split(text);
+    if (split.parts.size() < 2)
+        return std::nullopt;
+    ++m_stats.lookups;
+
+    Paragraphs::Plan p;
+    p.parts = split.parts;
+    p.separators = split.separators;
+    p.outputs.reserve(p.parts.size());
+    for (int k = 0; k < p.parts.size(); ++k) {
+        const QString& part = p.parts[k];
+        if (part.trimmed().isEmpty()) {
+            p.outputs << part;              // nothing to process
+        } else if (const QString* out = find(actionKey, part)) {
+            p.outputs << *out;
+        } else {
+            p.outputs << QString();
+            p.missing << k;
+        }
+    }
+    if (p.missing.size() == p.parts.size())
+        return std::nullopt;
+    ++m_stats.hits;
+    m_stats.reusedParts += int(p.parts.size() - p.missing.size());
+    m_stats.sentParts += int(p.missing.size());
+    return p;
+}
+
+void ParagraphMemo::insert(quint64 actionKey, const QString& input, const QString& output)
+{
+    const auto in = Paragraphs::split(input);
+    const auto out = Paragraphs::split(output);
+    if (in.parts.size() != out.parts.size())
+        return;                             // paragraphs were merged or split
+    for (int k = 0; k < in.parts.size(); ++k) {
+        if (in.parts[k].trimmed().isEmpty())
+            continue;
+        store(actionKey, in.parts[k], out.parts[k]);
+        if (out.parts[k] != in.parts[k])
+            store(actionKey, out.parts[k], out.parts[k]);
+    }
+}
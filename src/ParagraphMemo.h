@@ -0,0 +1,48 @@
+#pragma once
+#include <QCache>
+#include <QString>
+
+#include <optional>
+
+#include "Paragraphs.h"
+
+/**
+ *  Results of single paragraphs, keyed by hash of paragraph text and action
+ *  key (action, model, system prompt), in an LRU bounded by characters.
+ *
+ *  A paragraph the action produced is stored as its own result too: running
+ *  the same action again over already processed text sends only what was
+ *  edited since.
+ */
+class ParagraphMemo
+{
+public:
+    struct Stats {
+        int lookups = 0;            // multi-paragraph inputs looked up
+        int hits = 0;               // ... that reused at least one paragraph
+        int reusedParts = 0;
+        int sentParts = 0;
+    };
+
+    explicit ParagraphMemo(int maxChars = 2 * 1024 * 1024);
+
+    // Plan for `text`, or nothing for a single paragraph or no reuse at all.
+    std::optional<Paragraphs::Plan> plan(quint64 actionKey, const QString& text);
+
+    // Stores paragraph results if input and output have the same structure.
+    void insert(quint64 actionKey, const QString& input, const QString& output);
+
+    const Stats& stats() const { return m_stats; }
+
+private:
+    struct Memo {
+        QString input;              // guards against hash collisions
+        QString output;
+    };
+    static quint64 key(quint64 actionKey, const QString& paragraph);
+    const QString* find(quint64 actionKey, const QString& paragraph);
+    void store(quint64 actionKey, const QString& paragraph, const QString& output);
+
+    QCache<quint64, Memo> m_cache;
+    Stats m_stats;
+};
@@ -0,0 +1,43 @@
+#include "Paragraphs.h"
+
+#include <QRegularExpression>
+
+namespace Paragraphs {
+
+Split split(const QString& text)
+{
+    // A blank line, possibly with spaces, and any further blank lines.
+    static const QRegularExpression blank(QStringLiteral("\\n[ \\t]*\\n\\s*"));
+    Split s;
+    qsizetype from = 0;
+    auto it = blank.globalMatch(text);
+    while (it.hasNext()) {
+        const auto m = it.next();
+        s.parts << text.mid(from, m.capturedStart() - from);
+        s.separators << m.captured();
+        from = m.capturedEnd();
+    }
+    s.parts << text.mid(from);
+    return s;
+}
+
+QString join(const QStringList& parts, const QStringList& separators)
+{
+    QString out;
+    for (qsizetype i = 0; i < parts.size(); ++i) {
+        out += parts[i];
+        if (i < separators.size())
+            out += separators[i];
+    }
+    return out;
+}
+
+QString stitch(const Plan& plan, const QStringList& fresh)
+{
+    QStringList outputs = plan.outputs;
+    for (qsizetype k = 0; k < plan.missing.size() && k < fresh.size(); ++k)
+        outputs[plan.missing[k]] = fresh[k];
+    return join(outputs, plan.separators);
+}
+
+} // namespace Paragraphs
@@ -0,0 +1,31 @@
+#pragma once
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ *  Splitting text at blank lines and putting it back together unchanged.
+ *  Used to reuse results for the paragraphs that did not change.
+ */
+namespace Paragraphs {
+
+struct Split {
+    QStringList parts;              // paragraphs, never empty for non-empty text
+    QStringList separators;         // separators[i] follows parts[i]; one less than parts
+};
+
+// Which paragraphs of an input already have a result.
+struct Plan {
+    QStringList parts;              // paragraphs of the new input
+    QStringList separators;
+    QStringList outputs;            // reused output, null where missing
+    QVector<int> missing;           // indices of parts to send
+};
+
+Split split(const QString& text);
+QString join(const QStringList& parts, const QStringList& separators);
+
+// The output of a plan with `fresh` filled in for its missing parts.
+QString stitch(const Plan& plan, const QStringList& fresh);
+
+} // namespace Paragraphs
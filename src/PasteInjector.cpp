@@ -0,0 +1,88 @@
+#include "PasteInjector.h"
+#include "ClipboardReader.h"
+
+#include <QApplication>
+#include <QClipboard>
+#include <QDebug>
+#include <QTimer>
+
+PasteInjector::PasteInjector(AccessibilityHelper* a11y, QObject* parent)
+        : QObject(parent)
+        , m_a11y(a11y)
+{
+}
+
+void PasteInjector::start(const ElementInfo& target, const QString& text)
+{
+    m_busy = true;
+    m_target = target;
+    m_text = text;
+    m_previous.clear();
+    m_checks = 0;
+    m_focusLost = false;
+    m_timer.start();
+    // AT-SPI counts characters (code points).
+    m_expectedLength = target.textLength - (target.selectionEnd - target.selectionStart)
+                       + int(text.toUcs4().size());
+
+    // Read without blocking: the clipboard owner may be slow.
+    m_reader = new ClipboardReader(QClipboard::Clipboard, this);
+    connect(m_reader, &ClipboardReader::finished,
+            this, [this](QClipboard::Mode, const QString& previous) { onClipboardSaved(previous); });
+    m_reader->start();
+}
+
+void PasteInjector::onClipboardSaved(const QString& previous)
+{
+    m_previous = previous;
+    QApplication::clipboard()->setText(m_text);
+    // The request took a while: the user may have moved on to another window,
+    // which would get the paste.
+    if (!m_a11y->hasFocus(m_target)) {
+        qInfo() << "PasteInjector: target lost the focus, not pasting";
+        m_focusLost = true;
+        done(false);
+        return;
+    }
+    if (!m_a11y->selectRange(m_target, m_target.selectionStart, m_target.selectionEnd)) {
+        qWarning() << "PasteInjector: could not select the target range";
+        done(false);
+        return;
+    }
+    if (!m_a11y->synthesizePaste()) {
+        done(false);
+        return;
+    }
+    QTimer::singleShot(kSettleMs, this, &PasteInjector::check);
+}
+
+// The application reads the clipboard on its own schedule; big pastes
+// take a while.
+void PasteInjector::check()
+{
+    const int length = m_a11y->characterCount(m_target);
+    if (length == m_expectedLength) {
+        done(true);
+        return;
+    }
+    if (++m_checks < kChecks) {
+        QTimer::singleShot(kSettleMs, this, &PasteInjector::check);
+        return;
+    }
+    qWarning() << "PasteInjector: field has" << length << "characters, expected" << m_expectedLength;
+    done(false);
+}
+
+void PasteInjector::done(bool ok)
+{
+    if (!m_focusLost)                       // says nothing about pasting
+        m_a11y->recordPaste(m_target.process, m_timer.elapsed(), ok);
+    // Non-text content cannot be restored this way; the result stays then.
+    if (ok && !m_previous.isEmpty())
+        QApplication::clipboard()->setText(m_previous);
+    m_busy = false;
+    m_target = ElementInfo();               // drops the accessible reference
+    m_text.clear();
+    m_previous.clear();
+    Q_EMIT finished(ok);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <QElapsedTimer>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+
+#include "AccessibilityHelper.h"
+
+class ClipboardReader;
+
+/**
+ *  Puts a result back by pasting: the target range is selected over
+ *  AT-SPI, the result goes to the clipboard and Ctrl+V is synthesized.
+ *  Many toolkits take a large paste much faster than a long
+ *  EditableText insert, and it also works in fields without EditableText.
+ *  The previous (text) clipboard content is restored once the new length
+ *  of the field shows that the paste has landed.
+ */
+class PasteInjector : public QObject
+{
+Q_OBJECT
+public:
+    static constexpr int kSettleMs = 250;       // between checks of the field
+    static constexpr int kChecks   = 4;
+
+    explicit PasteInjector(AccessibilityHelper* a11y, QObject* parent = nullptr);
+
+    bool isBusy() const { return m_busy; }
+    // Replaces [selectionStart, selectionEnd) of `target` with `text`.
+    void start(const ElementInfo& target, const QString& text);
+
+Q_SIGNALS:
+    // On failure the result is left in the clipboard.
+    void finished(bool ok);
+
+public:
+    // During `finished(false)`: the target was no longer focused, so no
+    // paste was attempted.
+    bool focusLost() const { return m_focusLost; }
+
+private:
+    void onClipboardSaved(const QString& previous);
+    void check();
+    void done(bool ok);
+
+    AccessibilityHelper* m_a11y;
+    QPointer<ClipboardReader> m_reader;
+    ElementInfo   m_target;
+    QString       m_text;
+    QString       m_previous;
+    int           m_expectedLength = -1;
+    int           m_checks = 0;
+    bool          m_busy = false;
+    bool          m_focusLost = false;
+    QElapsedTimer m_timer;
+};
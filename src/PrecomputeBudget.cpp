@@ -0,0 +1,63 @@
+#include "PrecomputeBudget.h"
+
+#include <QHash>
+#include <KLocalizedString>
+
+static constexpr qint64 kWindowMs = 60 * 60 * 1000;
+
+bool PrecomputeBudget::spend()
+{
+    if (m_perHour <= 0)
+        return false;
+    if (!m_clock.isValid())
+        m_clock.start();
+    const qint64 now = m_clock.elapsed();
+    while (!m_spent.isEmpty() && now - m_spent.first() >= kWindowMs)
+        m_spent.removeFirst();
+    if (m_spent.size() >= m_perHour) {
+        ++m_overBudget;
+        return false;
+    }
+    m_spent.append(now);
+    return true;
+}
+
+void PrecomputeBudget::started(quint64 actionKey, const QString& text)
+{
+    if (m_open)
+        ++m_wasted;
+    ++m_runs;
+    m_open = true;
+    m_key = actionKey;
+    m_textHash = qHash(text);
+}
+
+void PrecomputeBudget::discard()
+{
+    if (!m_open)
+        return;
+    m_open = false;
+    ++m_wasted;
+}
+
+bool PrecomputeBudget::claim(quint64 actionKey, const QString& text)
+{
+    if (!covers(actionKey, text))
+        return false;
+    m_open = false;
+    ++m_hits;
+    return true;
+}
+
+bool PrecomputeBudget::covers(quint64 actionKey, const QString& text) const
+{
+    return m_open && m_key == actionKey && m_textHash == qHash(text);
+}
+
+QString PrecomputeBudget::summary() const
+{
+    if (!m_runs && !m_overBudget)
+        return QString();
+    return i18n("Precomputed results: %1 used, %2 wasted of %3 runs (%4 skipped over the budget of %5/hour)",
+                m_hits, m_wasted, m_runs, m_overBudget, m_perHour);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <QElapsedTimer>
+#include <QString>
+#include <QVector>
+
+/**
+ *  Bookkeeping of the runs started on a stable selection before the
+ *  shortcut (this session only): an hourly budget, and whether each result
+ *  was used, so the budget can be tuned from the hit rate.
+ *  Only the latest run is tracked; starting the next one writes it off.
+ */
+class PrecomputeBudget
+{
+public:
+    void setPerHour(int runs) { m_perHour = runs; }     // 0 = off
+    int perHour() const { return m_perHour; }
+
+    // Takes one run out of the last hour's budget; false when it is used up.
+    bool spend();
+
+    void started(quint64 actionKey, const QString& text);
+    void discard();                 // the run was cancelled or failed
+    // The user ran `actionKey` on `text`: true if the latest run covers it.
+    bool claim(quint64 actionKey, const QString& text);
+    bool covers(quint64 actionKey, const QString& text) const;
+
+    QString summary() const;        // empty until something was started
+
+private:
+    int             m_perHour = 0;
+    QElapsedTimer   m_clock;
+    QVector<qint64> m_spent;        // m_clock times of the runs in the last hour
+
+    bool    m_open = false;         // latest run not claimed or written off yet
+    quint64 m_key = 0;
+    size_t  m_textHash = 0;
+
+    int m_runs = 0;
+    int m_hits = 0;
+    int m_wasted = 0;
+    int m_overBudget = 0;
+};
@@ -0,0 +1,161 @@
+#include "RequestCoalescer.h"
+#include "BatchPrompt.h"
+
+#include <QDebug>
+#include <QTimer>
+#include <KLocalizedString>
+
+RequestCoalescer::RequestCoalescer(QObject* parent)
+        : QObject(parent)
+{
+}
+
+quint64 RequestCoalescer::submit(TextBackend* backend,
+                                 const QStringList& segments,
+                                 const QString& userPrompt,
+                                 const RequestOptions& options)
+{
+    const quint64 jobId = ++m_lastJobId;
+    Job& job = m_jobs[jobId];
+    job.backend  = backend;
+    job.prompt   = userPrompt;
+    job.options  = options;
+    job.segments = segments;
+    job.results.resize(segments.size());
+    m_stats.segments += segments.size();
+
+    if (segments.isEmpty()) {
+        QTimer::singleShot(0, this, [this, jobId]{ requestDone(jobId); });
+        return jobId;
+    }
+
+    connect(backend, &TextBackend::processingFinished,
+            this, &RequestCoalescer::onFinished, Qt::UniqueConnection);
+    connect(backend, &TextBackend::processingError,
+            this, &RequestCoalescer::onError, Qt::UniqueConnection);
+
+    // Greedy packing in input order; a segment larger than the limit goes alone.
+    QVector<int> pack;
+    int packChars = 0;
+    for (int i = 0; i < segments.size(); ++i) {
+        const int len = int(segments[i].size());
+        if (!pack.isEmpty()
+            && (packChars + len > m_maxBatchChars || pack.size() >= m_maxBatchSegments)) {
+            send(jobId, pack);
+            pack.clear();
+            packChars = 0;
+        }
+        pack << i;
+        packChars += len;
+    }
+    send(jobId, pack);
+    return jobId;
+}
+
+void RequestCoalescer::send(quint64 jobId, const QVector<int>& indices)
+{
+    Job& job = m_jobs[jobId];
+    if (!job.backend) {
+        qWarning() << "RequestCoalescer: backend went away, dropping job" << jobId;
+        job.dropped = true;
+        return;
+    }
+
+    quint64 requestId = 0;
+    if (indices.size() == 1) {
+        requestId = job.backend->processText(job.segments[indices.first()], job.prompt, job.options);
+    } else {
+        QStringList segs;
+        segs.reserve(indices.size());
+        for (int i : indices)
+            segs << job.segments[i];
+        RequestOptions options = job.options;
+        if (options.maxTokens > 0)
+            options.maxTokens *= int(segs.size());     // the limit is per segment
+        requestId = job.backend->processText(BatchPrompt::pack(segs),
+                                             BatchPrompt::prompt(job.prompt, segs.size()),
+                                             options);
+    }
+    m_pending.insert(requestId, Pending{jobId, indices});
+    ++job.open;
+    ++m_stats.requests;
+}
+
+void RequestCoalescer::onFinished(quint64 requestId, const QString& text)
+{
+    const auto it = m_pending.constFind(requestId);
+    if (it == m_pending.cend())
+        return;                             // not ours
+    const Pending p = *it;
+    m_pending.erase(it);
+    if (!m_jobs.contains(p.jobId))
+        return;                             // job already failed
+    Job& job = m_jobs[p.jobId];
+    --job.open;
+
+    if (p.indices.size() == 1) {
+        job.results[p.indices.first()] = text;
+    } else {
+        const auto parts = BatchPrompt::unpack(text, p.indices.size());
+        for (int k = 0; k < p.indices.size(); ++k) {
+            const int idx = p.indices[k];
+            if (parts && plausible(job.segments[idx], parts->at(k))) {
+                job.results[idx] = parts->at(k);
+            } else {
+                ++m_stats.fallbacks;
+                send(p.jobId, {idx});
+            }
+        }
+    }
+    requestDone(p.jobId);
+}
+
+void RequestCoalescer::onError(quint64 requestId, const QString& errorMsg)
+{
+    const auto it = m_pending.constFind(requestId);
+    if (it == m_pending.cend())
+        return;
+    const Pending p = *it;
+    m_pending.erase(it);
+    if (!m_jobs.contains(p.jobId))
+        return;
+    Job& job = m_jobs[p.jobId];
+    --job.open;
+
+    if (p.indices.size() > 1) {
+        // The batch may have been too long for the model: try one by one.
+        m_stats.fallbacks += p.indices.size();
+        for (int idx : p.indices)
+            send(p.jobId, {idx});
+        requestDone(p.jobId);
+        return;
+    }
+    m_jobs.remove(p.jobId);                 // late replies of the job are ignored
+    Q_EMIT failed(p.jobId, errorMsg);
+}
+
+void RequestCoalescer::requestDone(quint64 jobId)
+{
+    const auto it = m_jobs.find(jobId);
+    if (it == m_jobs.end() || it->open > 0)
+        return;
+    const QStringList results = it->results;
+    const bool lostBackend = it->dropped;
+    m_jobs.erase(it);
+    if (lostBackend)
+        Q_EMIT failed(jobId, i18n("The backend was replaced before the request finished."));
+    else
+        Q_EMIT finished(jobId, results);
+}
+
+// Cheap sanity check of one element of a batch reply.
+bool RequestCoalescer::plausible(const QString& input, const QString& output)
+{
+    const QString out = output.trimmed();
+    if (out.isEmpty())
+        return input.trimmed().isEmpty();
+    if (out.startsWith(QLatin1Char('[')) && !input.trimmed().startsWith(QLatin1Char('[')))
+        return false;                       // nested array: contract not followed
+    // Much longer than its input usually means neighbouring items were merged.
+    return out.size() <= input.size() * 4 + 200;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+#include <QVector>
+
+#include "TextBackend.h"
+
+/**
+ *  Sits in front of a TextBackend and runs one instruction over many small
+ *  segments with as few requests as possible: segments are packed into
+ *  BatchPrompt requests up to a size limit, replies are validated and split,
+ *  and segments whose output does not validate are retried one by one.
+ */
+class RequestCoalescer : public QObject
+{
+Q_OBJECT
+public:
+    struct Stats {
+        int segments = 0;           // segments submitted
+        int requests = 0;           // backend requests sent
+        int fallbacks = 0;          // segments retried individually
+    };
+
+    explicit RequestCoalescer(QObject* parent = nullptr);
+
+    // Results arrive through `finished` in the order of `segments`.
+    quint64 submit(TextBackend* backend, const QStringList& segments, const QString& userPrompt,
+                   const RequestOptions& options = {});
+
+    void setMaxBatchChars(int chars)   { m_maxBatchChars = chars; }
+    void setMaxBatchSegments(int n)    { m_maxBatchSegments = n; }
+    const Stats& stats() const         { return m_stats; }
+
+Q_SIGNALS:
+    void finished(quint64 jobId, const QStringList& results);
+    void failed  (quint64 jobId, const QString& errorMsg);
+
+private:
+    struct Job {
+        QPointer<TextBackend> backend;
+        QString     prompt;
+        RequestOptions options;
+        QStringList segments;
+        QStringList results;
+        int         open = 0;       // requests still running
+        bool        dropped = false; // a request could not be sent
+    };
+    struct Pending {
+        quint64      jobId = 0;
+        QVector<int> indices;       // segments carried by the request
+    };
+
+    void send(quint64 jobId, const QVector<int>& indices);
+    void onFinished(quint64 requestId, const QString& text);
+    void onError   (quint64 requestId, const QString& errorMsg);
+    void requestDone(quint64 jobId);
+    static bool plausible(const QString& input, const QString& output);
+
+    QHash<quint64, Job>     m_jobs;
+    QHash<quint64, Pending> m_pending;      // by backend request id
+    quint64 m_lastJobId = 0;
+    int     m_maxBatchChars = 6000;
+    int     m_maxBatchSegments = 32;
+    Stats   m_stats;
+};
@@ -0,0 +1,213 @@
+#include "RequestScheduler.h"
+
+#include <QStringList>
+#include <KLocalizedString>
+
+RequestScheduler::RequestScheduler(TextBackend* inner, int maxConcurrent, QObject* parent)
+        : TextBackend(parent)
+        , m_inner(inner)
+        , m_maxConcurrent(qMax(1, maxConcurrent))
+{
+    m_inner->setParent(this);
+    connect(m_inner, &TextBackend::processingFinished, this, &RequestScheduler::onInnerFinished);
+    connect(m_inner, &TextBackend::processingError,    this, &RequestScheduler::onInnerError);
+    connect(m_inner, &TextBackend::partialResult,      this, &RequestScheduler::onInnerPartial);
+    connect(m_inner, &TextBackend::requestMetrics,     this, &RequestScheduler::onInnerMetrics);
+}
+
+QString RequestScheduler::className(Priority p)
+{
+    switch (p) {
+    case Priority::Interactive: return i18n("interactive");
+    case Priority::Bulk:        return i18n("bulk");
+    case Priority::Speculative: return i18n("speculative");
+    case Priority::Background:  return i18n("background");
+    }
+    return QString();
+}
+
+quint64 RequestScheduler::processText(const QString& text, const QString& userPrompt,
+                                      const RequestOptions& options)
+{
+    Job job;
+    job.id = startRequest();
+    job.text = text;
+    job.prompt = userPrompt;
+    job.options = options;
+    job.queued.start();
+
+    const int c = int(options.priority);
+    m_queues[c].enqueue(job);
+    m_stats[c].depth = int(m_queues[c].size());
+    m_stats[c].maxDepth = qMax(m_stats[c].maxDepth, m_stats[c].depth);
+    if (options.priority == Priority::Interactive)
+        preemptFor(options.priority);
+    dispatch();
+    return job.id;
+}
+
+quint64 RequestScheduler::warmUp()
+{
+    Job job;
+    job.id = startRequest();
+    job.warmUp = true;
+    job.options.priority = Priority::Background;
+    job.queued.start();
+    const int c = int(Priority::Background);
+    m_queues[c].enqueue(job);
+    m_stats[c].depth = int(m_queues[c].size());
+    m_stats[c].maxDepth = qMax(m_stats[c].maxDepth, m_stats[c].depth);
+    dispatch();
+    return job.id;
+}
+
+void RequestScheduler::setGenerationSettings(const QString& model, const QString& systemPrompt)
+{
+    m_inner->setGenerationSettings(model, systemPrompt);
+}
+
+void RequestScheduler::cancel(quint64 requestId)
+{
+    for (int c = 0; c < kClasses; ++c) {
+        auto& q = m_queues[c];
+        for (int i = 0; i < q.size(); ++i) {
+            if (q[i].id != requestId)
+                continue;
+            q.removeAt(i);
+            m_stats[c].depth = int(q.size());
+            failRequest(requestId, i18n("Request cancelled."));
+            return;
+        }
+    }
+    for (auto it = m_running.cbegin(); it != m_running.cend(); ++it) {
+        if (it->id == requestId) {
+            m_inner->cancel(it.key());
+            return;
+        }
+    }
+}
+
+void RequestScheduler::setPriority(quint64 requestId, Priority priority)
+{
+    for (auto it = m_running.begin(); it != m_running.end(); ++it) {
+        if (it->id == requestId) {
+            it->priority = priority;        // no longer a preemption victim, say
+            return;
+        }
+    }
+    for (int c = 0; c < kClasses; ++c) {
+        auto& q = m_queues[c];
+        for (int i = 0; i < q.size(); ++i) {
+            if (q[i].id != requestId)
+                continue;
+            if (c == int(priority))
+                return;
+            Job job = q.takeAt(i);
+            m_stats[c].depth = int(q.size());
+            job.options.priority = priority;
+            const int n = int(priority);
+            m_queues[n].enqueue(job);
+            m_stats[n].depth = int(m_queues[n].size());
+            m_stats[n].maxDepth = qMax(m_stats[n].maxDepth, m_stats[n].depth);
+            if (priority == Priority::Interactive)
+                preemptFor(priority);
+            dispatch();
+            return;
+        }
+    }
+}
+
+// Interactive work waits for nobody: if every slot it may use (the spare one
+// included) is taken, running speculative requests are cancelled (their
+// results are disposable).
+void RequestScheduler::preemptFor(Priority p)
+{
+    Q_UNUSED(p);
+    if (m_running.size() < interactiveLimit())
+        return;                 // it starts right away
+    // cancel() may end the request synchronously, so collect first.
+    QList<quint64> victims;
+    for (auto it = m_running.cbegin(); it != m_running.cend(); ++it)
+        if (it->priority == Priority::Speculative)
+            victims << it.key();
+    for (quint64 innerId : std::as_const(victims)) {
+        ++m_stats[int(Priority::Speculative)].preempted;
+        m_inner->cancel(innerId);
+    }
+}
+
+void RequestScheduler::dispatch()
+{
+    for (int c = 0; c < kClasses; ++c) {
+        auto& q = m_queues[c];
+        while (!q.isEmpty()) {
+            // One slot above the limit is kept for interactive requests.
+            const bool interactive = c == int(Priority::Interactive);
+            const int limit = interactive ? interactiveLimit() : m_maxConcurrent;
+            if (m_running.size() >= limit)
+                break;
+            Job job = q.dequeue();
+            m_stats[c].depth = int(q.size());
+            m_stats[c].wait.add(job.queued.elapsed());
+
+            const quint64 innerId = job.warmUp
+                    ? m_inner->warmUp()
+                    : m_inner->processText(job.text, job.prompt, job.options);
+            m_running.insert(innerId, Running{job.id, job.options.priority});
+        }
+        // Lower classes only get what is left after the limit.
+        if (!q.isEmpty())
+            return;
+    }
+}
+
+void RequestScheduler::onInnerPartial(quint64 innerId, const QString& delta)
+{
+    const auto it = m_running.constFind(innerId);
+    if (it != m_running.cend())
+        Q_EMIT partialResult(it->id, delta);
+}
+
+void RequestScheduler::onInnerMetrics(quint64 innerId, const RequestMetrics& metrics)
+{
+    const auto it = m_running.constFind(innerId);
+    if (it != m_running.cend())
+        Q_EMIT requestMetrics(it->id, metrics);
+}
+
+void RequestScheduler::onInnerFinished(quint64 innerId, const QString& text)
+{
+    const auto it = m_running.find(innerId);
+    if (it == m_running.end())
+        return;
+    const quint64 id = it->id;
+    m_running.erase(it);
+    dispatch();                         // start the next one before notifying
+    finishRequest(id, text);
+}
+
+void RequestScheduler::onInnerError(quint64 innerId, const QString& err)
+{
+    const auto it = m_running.find(innerId);
+    if (it == m_running.end())
+        return;
+    const quint64 id = it->id;
+    m_running.erase(it);
+    dispatch();
+    failRequest(id, err);
+}
+
+QString RequestScheduler::summary() const
+{
+    QStringList lines;
+    for (int c = 0; c < kClasses; ++c) {
+        const ClassStats& s = m_stats[c];
+        if (!s.wait.count && !s.depth)
+            continue;
+        lines << i18n("Queue %1: %2 started, wait avg %3 ms / max %4 ms, "
+                      "depth %5 (max %6), %7 preempted",
+                      className(Priority(c)), s.wait.count, s.wait.avgMs(), s.wait.maxMs,
+                      s.depth, s.maxDepth, s.preempted);
+    }
+    return lines.join(QLatin1Char('\n'));
+}
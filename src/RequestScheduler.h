@@ -0,0 +1,89 @@
+#pragma once
+#include <QElapsedTimer>
+#include <QHash>
+#include <QQueue>
+#include <array>
+
+#include "SessionStats.h"
+#include "TextBackend.h"
+
+/**
+ *  A TextBackend in front of another one (one scheduler per endpoint) that
+ *  decides when requests are passed on:
+ *   - at most `maxConcurrent` requests run at once, plus a spare slot kept
+ *     for interactive work when the backend can really run one more;
+ *   - queued requests start by priority class, FIFO within a class;
+ *   - an interactive request that has to wait cancels running speculative
+ *     ones; bulk and background work is only held back, not cancelled.
+ *  Bulk is the class of chunked jobs (RequestCoalescer, ActionChain): their
+ *  queued chunks start after any waiting interactive request, and with a
+ *  spare slot an interactive request does not wait for a running chunk.
+ *  Without one (LlamaClient generates one sequence at a time) it waits for
+ *  the running chunk only. Running chunks are left alone; cancelling one
+ *  would throw its tokens away and fail the whole job.
+ *  Queue depth and wait time are tracked per class.
+ */
+class RequestScheduler : public TextBackend
+{
+Q_OBJECT
+public:
+    using Priority = RequestOptions::Priority;
+    static constexpr int kClasses = 4;
+
+    struct ClassStats {
+        int depth = 0;              // waiting now
+        int maxDepth = 0;
+        int preempted = 0;          // cancelled to make room
+        SessionStats::Latency wait; // time spent queued
+    };
+
+    // Takes ownership of `inner`.
+    explicit RequestScheduler(TextBackend* inner, int maxConcurrent, QObject* parent = nullptr);
+
+    quint64 processText(const QString& text, const QString& userPrompt,
+                        const RequestOptions& options = {}) override;
+    quint64 warmUp() override;          // runs as background work
+    void setGenerationSettings(const QString& model, const QString& systemPrompt) override;
+    void cancel(quint64 requestId) override;
+    // Moves a queued or running request to another class, e.g. speculative
+    // work the user is now waiting for. Unknown ids are ignored.
+    void setPriority(quint64 requestId, Priority priority);
+
+    void setMaxConcurrent(int n) { m_maxConcurrent = qMax(1, n); dispatch(); }
+    // Off for backends that cannot run more than `maxConcurrent` at once:
+    // the extra request would only queue inside the backend.
+    void setSpareInteractiveSlot(bool on) { m_spareSlot = on; dispatch(); }
+    const ClassStats& stats(Priority p) const { return m_stats[int(p)]; }
+    QString summary() const;
+
+    static QString className(Priority p);
+
+private:
+    struct Job {
+        quint64 id = 0;             // our id
+        bool    warmUp = false;
+        QString text;
+        QString prompt;
+        RequestOptions options;
+        QElapsedTimer queued;
+    };
+    struct Running {
+        quint64  id = 0;
+        Priority priority = Priority::Interactive;
+    };
+
+    void dispatch();
+    int interactiveLimit() const { return m_maxConcurrent + (m_spareSlot ? 1 : 0); }
+    void preemptFor(Priority p);
+    void onInnerFinished(quint64 innerId, const QString& text);
+    void onInnerError(quint64 innerId, const QString& err);
+    void onInnerPartial(quint64 innerId, const QString& delta);
+    void onInnerMetrics(quint64 innerId, const RequestMetrics& metrics);
+
+    TextBackend* m_inner;
+    int          m_maxConcurrent;
+    bool         m_spareSlot = true;
+    std::array<QQueue<Job>, kClasses> m_queues;
+    QHash<quint64, Running> m_running;      // by inner id
+    std::array<ClassStats, kClasses> m_stats;
+};
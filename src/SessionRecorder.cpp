@@ -0,0 +1,94 @@
+#include "SessionRecorder.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+bool SessionRecorder::openFromEnvironment()
+{
+    const QString path = qEnvironmentVariable("KNOWBRIDGE_RECORD_SESSION");
+    return !path.isEmpty() && open(path);
+}
+
+bool SessionRecorder::open(const QString& path)
+{
+    m_file.close();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "SessionRecorder: cannot open" << path << m_file.errorString();
+        return false;
+    }
+    m_clock.start();
+    write(QJsonObject{
+            {QStringLiteral("type"),    QStringLiteral("session")},
+            {QStringLiteral("version"), kVersion},
+            {QStringLiteral("started"), QDateTime::currentDateTimeUtc().toString(Qt::ISODate)},
+    });
+    qInfo() << "Recording session to" << path;
+    return true;
+}
+
+void SessionRecorder::begin(const QString& action, int chars, int ranges, int promptChars, int steps)
+{
+    if (!isOpen())
+        return;
+    m_active = true;
+    m_startedMs = m_clock.elapsed();
+    m_requests = QJsonArray();
+    // The name is the user's own text too; a hash still groups by action.
+    m_action = QJsonObject{
+            {QStringLiteral("type"),        QStringLiteral("action")},
+            {QStringLiteral("t"),           m_startedMs},
+            {QStringLiteral("action"),      QString::number(qHash(action, 0), 16)},
+            {QStringLiteral("chars"),       chars},
+            {QStringLiteral("ranges"),      ranges},
+            {QStringLiteral("promptChars"), promptChars},
+            {QStringLiteral("steps"),       steps},
+    };
+}
+
+void SessionRecorder::setSegments(const QVector<int>& chars)
+{
+    if (!m_active)
+        return;
+    QJsonArray a;
+    for (int c : chars)
+        a.append(c);
+    m_action.insert(QStringLiteral("segments"), a);
+}
+
+void SessionRecorder::request(const RequestMetrics& metrics)
+{
+    if (!m_active)
+        return;
+    m_requests.append(QJsonObject{
+            {QStringLiteral("promptTokens"),     metrics.promptTokens},
+            {QStringLiteral("completionTokens"), metrics.completionTokens},
+            {QStringLiteral("ttftMs"),           metrics.ttftMs},
+            {QStringLiteral("totalMs"),          metrics.totalMs},
+    });
+}
+
+void SessionRecorder::finish(const QString& path, int outputChars, bool ok)
+{
+    if (!m_active)
+        return;
+    m_active = false;
+    m_action.insert(QStringLiteral("path"), path);
+    m_action.insert(QStringLiteral("ms"), m_clock.elapsed() - m_startedMs);
+    m_action.insert(QStringLiteral("outputChars"), outputChars);
+    m_action.insert(QStringLiteral("ok"), ok);
+    m_action.insert(QStringLiteral("requests"), m_requests);
+    write(m_action);
+    m_requests = QJsonArray();
+}
+
+void SessionRecorder::write(const QJsonObject& obj)
+{
+    m_file.write(QJsonDocument(obj).toJson(QJsonDocument::Compact) + '\n');
+    m_file.flush();
+}
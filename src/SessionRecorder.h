@@ -0,0 +1,48 @@
+#pragma once
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+
+#include "TextBackend.h"
+
+/**
+ *  Opt-in recording of the traffic shape of a session, for replay against
+ *  a stand-in server (bench/replay_session). Enabled by setting
+ *  KNOWBRIDGE_RECORD_SESSION to a file name.
+ *
+ *  Nothing typed by the user is written: per action only its size, the
+ *  sizes of the segments sent to the model, the number of chain steps,
+ *  a hash of the action, the timings and the token usage of its requests.
+ *  One JSON object per line.
+ */
+class SessionRecorder
+{
+public:
+    static constexpr int kVersion = 1;
+
+    // Opens the file named by KNOWBRIDGE_RECORD_SESSION, if set.
+    bool openFromEnvironment();
+    bool open(const QString& path);
+    bool isOpen() const { return m_file.isOpen(); }
+
+    // An action was chosen for `chars` characters of input.
+    void begin(const QString& action, int chars, int ranges, int promptChars, int steps);
+    // What actually went to the model (nothing for local or cached results).
+    void setSegments(const QVector<int>& chars);
+    void request(const RequestMetrics& metrics);
+    // `path`: "model", "spell" or "cache".
+    void finish(const QString& path, int outputChars, bool ok);
+
+private:
+    void write(const QJsonObject& obj);
+
+    QFile         m_file;
+    QElapsedTimer m_clock;              // session time of every record
+    bool          m_active = false;
+    QJsonObject   m_action;
+    QJsonArray    m_requests;
+    qint64        m_startedMs = 0;
+};
@@ -0,0 +1,29 @@
+#include "SessionStats.h"
+#include <QStringList>
+#include <KLocalizedString>
+
+namespace {
+QString line(const QString& label, const SessionStats::Latency& l)
+{
+    if (!l.count)
+        return i18n("%1: none", label);
+    return i18n("%1: %2 (avg %3 ms, max %4 ms)", label, l.count, l.avgMs(), l.maxMs);
+}
+} // namespace
+
+QString SessionStats::summary() const
+{
+    QStringList lines;
+    lines << line(i18n("Warm requests"), m_warm)
+          << line(i18n("Cold requests"), m_cold)
+          << line(i18n("Warm-ups"),      m_warmUp)
+          << line(i18n("Local spelling fixes"), m_local);
+    if (m_localTried)
+        lines << i18n("Local hit rate: %1% of %2",
+                      m_local.count * 100 / m_localTried, m_localTried);
+    if (m_patchApplied || m_patchRejected)
+        lines << i18n("Edit lists: %1 applied, %2 replaced by a full rewrite",
+                      m_patchApplied, m_patchRejected);
+    lines << i18n("Errors: %1", m_errors);
+    return lines.join(QLatin1Char('\n'));
+}
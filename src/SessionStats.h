@@ -0,0 +1,41 @@
+#pragma once
+#include <QString>
+
+/**
+ *  Счётчики текущей сессии (не сохраняются на диск).
+ *  Cold requests — the first request after start, a backend change or a long
+ *  idle period — are kept apart, so model load stalls do not hide in averages.
+ */
+class SessionStats
+{
+public:
+    struct Latency {
+        int    count = 0;
+        qint64 totalMs = 0;
+        qint64 maxMs = 0;
+
+        void add(qint64 ms) { ++count; totalMs += ms; if (ms > maxMs) maxMs = ms; }
+        qint64 avgMs() const { return count ? totalMs / count : 0; }
+    };
+
+    void recordRequest(qint64 ms, bool cold) { (cold ? m_cold : m_warm).add(ms); }
+    void recordWarmUp(qint64 ms)             { m_warmUp.add(ms); }
+    void recordError()                       { ++m_errors; }
+    // Requests of actions with the spelling fast path enabled.
+    void recordLocalHit(qint64 ms)           { ++m_localTried; m_local.add(ms); }
+    void recordLocalMiss()                   { ++m_localTried; }
+    // Replies of actions that ask for a list of edits (EditPatch).
+    void recordPatch(bool applied)           { ++(applied ? m_patchApplied : m_patchRejected); }
+
+    QString summary() const;
+
+private:
+    Latency m_warm;
+    Latency m_cold;
+    Latency m_warmUp;
+    Latency m_local;
+    int     m_localTried = 0;
+    int     m_patchApplied = 0;
+    int     m_patchRejected = 0;        // the whole text was requested instead
+    int     m_errors = 0;
+};
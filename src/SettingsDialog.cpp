@@ -1,24 +1,34 @@
 // File: src/SettingsDialog.cpp
 #include "SettingsDialog.h"
+#include "AccessibilityLatency.h"
 #include "ActionEditorDialog.h"
 #include "ApiClient.h"
+#include "LlamaClient.h"
+#include "MetricsStore.h"
+#include <QComboBox>
+#include <QFileDialog>
 #include <QFormLayout>
 #include <QHBoxLayout>
 #include <QListWidget>
 #include <QPushButton>
 #include <QRegularExpression>
 #include <QRegularExpressionValidator>
+#include <QSpinBox>
+#include <QStandardItemModel>
 #include <QTabWidget>
+#include <QTableWidget>
+#include <QHeaderView>
 #include <QDialogButtonBox>
 #include <QLabel>
 #include <KPasswordLineEdit>
 #include <KLocalizedString>
 #include <QCheckBox>
 
-static const QRegularExpression urlRx(QStringLiteral(R"(https?://.+)"));
+static const QRegularExpression urlRx(QStringLiteral(R"((https?://.+)|(unix:///.+))"));
 
-SettingsDialog::SettingsDialog(QWidget *parent, ConfigManager *cfg)
-        : QDialog(parent), m_cfg(cfg)
+SettingsDialog::SettingsDialog(QWidget *parent, ConfigManager *cfg, MetricsStore *metrics,
+                               const AccessibilityLatency *a11yLatency)
+        : QDialog(parent), m_cfg(cfg), m_metrics(metrics), m_a11yLatency(a11yLatency)
 {
     setWindowTitle(i18nc("@title:window","Settings"));
     resize(520, 400);
@@ -61,11 +71,61 @@ SettingsDialog::SettingsDialog(QWidget *parent, ConfigManager *cfg)
     // New notifications checkbox
     m_notificationsCb = new QCheckBox(i18n("Enable notifications"), gen);
 
+    m_backend = new QComboBox(gen);
+    m_backend->addItem(i18n("OpenAI-compatible API"),
+                       QVariant::fromValue(int(ConfigManager::Backend::Http)));
+    m_backend->addItem(i18n("Built-in llama.cpp (GGUF file)"),
+                       QVariant::fromValue(int(ConfigManager::Backend::Llama)));
+    if (!LlamaClient::isAvailable()) {
+        // keep the entry visible, but explain why it cannot be picked
+        if (auto *model = qobject_cast<QStandardItemModel*>(m_backend->model()))
+            model->item(1)->setEnabled(false);
+        m_backend->setItemData(1, i18n("Knowbridge was built without llama.cpp support."),
+                               Qt::ToolTipRole);
+    }
+    connect(m_backend, &QComboBox::currentIndexChanged, this, &SettingsDialog::updateBackendFields);
+
+    m_localModel = new QLineEdit(gen);
+    m_localModel->setClearButtonEnabled(true);
+    m_localModel->setPlaceholderText(i18n("Path to a .gguf model"));
+    m_localModelBtn = new QPushButton(QIcon::fromTheme(QStringLiteral("document-open")),
+                                      i18n("Browse…"), gen);
+    connect(m_localModelBtn, &QPushButton::clicked, this, &SettingsDialog::browseModelFile);
+    auto *modelBox = new QHBoxLayout;
+    modelBox->addWidget(m_localModel);
+    modelBox->addWidget(m_localModelBtn);
+
+    m_localThreads = new QSpinBox(gen);
+    m_localThreads->setRange(0, 256);
+    m_localThreads->setSpecialValueText(i18n("Automatic"));
+
+    m_warmUpCb = new QCheckBox(i18n("Load the model at startup and after settings change"), gen);
+    m_keepAlive = new QSpinBox(gen);
+    m_keepAlive->setRange(0, 120);
+    m_keepAlive->setSuffix(i18n(" min"));
+    m_keepAlive->setSpecialValueText(i18n("Off"));
+    m_keepAlive->setToolTip(i18n("Ping the backend when it has been idle this long, "
+                                 "so the model is not unloaded between edits."));
+    m_precompute = new QSpinBox(gen);
+    m_precompute->setRange(0, 600);
+    m_precompute->setSuffix(i18n(" per hour"));
+    m_precompute->setSpecialValueText(i18n("Off"));
+    m_precompute->setToolTip(i18n("When a selection stays unchanged for a moment, run the first "
+                                  "action on it in the background, so its result is ready when "
+                                  "the shortcut is pressed. Costs requests whose results may not "
+                                  "be used; the statistics show how many were."));
+
+    gLay->addRow(i18n("Backend:"),    m_backend);
     gLay->addRow(i18n("API key:"),    apiBox);
     gLay->addRow(i18n("API endpoint:"), m_endpoint);
     gLay->addRow(QString(), m_endpointWarn);
     gLay->addRow(i18n("Model:"),      m_model);
+    gLay->addRow(i18n("Model file:"), modelBox);
+    gLay->addRow(i18n("CPU threads:"), m_localThreads);
     gLay->addRow(i18n("System prompt:"), m_systemPrompt);
+    gLay->addRow(i18n("Warm-up:"),    m_warmUpCb);
+    gLay->addRow(i18n("Keep-alive:"), m_keepAlive);
+    gLay->addRow(i18n("Precompute:"), m_precompute);
     gLay->addRow(QString(), m_notificationsCb);
 
     m_tabs->addTab(gen, i18n("General"));
@@ -100,6 +160,53 @@ SettingsDialog::SettingsDialog(QWidget *parent, ConfigManager *cfg)
 
     m_tabs->addTab(act, i18n("Actions"));
 
+    /* ---------------- Statistics tab ---------------- */
+    if (m_metrics || m_a11yLatency) {
+        auto *st = new QWidget(this);
+        auto *sLay = new QVBoxLayout(st);
+        m_tabs->addTab(st, i18n("Statistics"));
+        if (m_metrics) {
+            m_metricsTable = new QTableWidget(0, 11, st);
+            m_metricsTable->setHorizontalHeaderLabels({
+                    i18n("Endpoint"), i18n("Model"), i18n("Action"), i18n("Requests"),
+                    i18n("Prompt tokens"), i18n("Completion tokens"), i18n("Avg. latency"),
+                    i18n("Avg. first token"), i18n("Tokens/s"), i18n("Prediction accepted"),
+                    i18n("Prediction speed-up")});
+            m_metricsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+            m_metricsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+            m_metricsTable->verticalHeader()->hide();
+            m_metricsTable->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+            sLay->addWidget(m_metricsTable);
+
+            auto *exportLbl = new QLabel(i18n("OpenMetrics export: %1", m_metrics->exportPath()), st);
+            exportLbl->setTextInteractionFlags(Qt::TextSelectableByMouse);
+            exportLbl->setWordWrap(true);
+            auto *resetBtn = new QPushButton(QIcon::fromTheme(QStringLiteral("edit-clear-history")),
+                                             i18n("Reset"), st);
+            connect(resetBtn, &QPushButton::clicked, m_metrics, &MetricsStore::reset);
+            auto *sRow = new QHBoxLayout;
+            sRow->addWidget(exportLbl, 1);
+            sRow->addWidget(resetBtn);
+            sLay->addLayout(sRow);
+
+            connect(m_metrics, &MetricsStore::changed, this, &SettingsDialog::loadMetrics);
+        }
+
+        // For troubleshooting: applications marked slow get the clipboard path.
+        if (m_a11yLatency) {
+            sLay->addWidget(new QLabel(i18n("Accessibility (AT-SPI) response by application, this session:"), st));
+            m_a11yTable = new QTableWidget(0, 7, st);
+            m_a11yTable->setHorizontalHeaderLabels({
+                    i18n("Application"), i18n("Calls"), i18n("Timeouts"), i18n("Avg. latency"),
+                    i18n("Max. latency"), i18n("Text access"), i18n("Large results")});
+            m_a11yTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+            m_a11yTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+            m_a11yTable->verticalHeader()->hide();
+            m_a11yTable->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+            sLay->addWidget(m_a11yTable);
+        }
+    }
+
     /* ---------------- Dialog buttons ---------------- */
     auto *bb = new QDialogButtonBox(QDialogButtonBox::RestoreDefaults
                                     |QDialogButtonBox::Ok
@@ -108,11 +215,7 @@ SettingsDialog::SettingsDialog(QWidget *parent, ConfigManager *cfg)
     connect(bb->button(QDialogButtonBox::RestoreDefaults), &QAbstractButton::clicked,
             this, [this]{
                 m_cfg->reset();
-                m_apiKey->setPassword(m_cfg->apiKey());
-                m_endpoint->setText(m_cfg->apiEndpoint());
-                m_model->setText(m_cfg->model());
-                m_systemPrompt->setPlainText(m_cfg->systemPrompt());
-                m_notificationsCb->setChecked(m_cfg->notificationsEnabled());
+                loadGeneral();
                 loadActions();
             });
     connect(bb, &QDialogButtonBox::accepted, this, &SettingsDialog::store);
@@ -123,14 +226,104 @@ SettingsDialog::SettingsDialog(QWidget *parent, ConfigManager *cfg)
     lay->addWidget(bb);
 
     /* Fill from cfg */
+    loadGeneral();
+    loadActions();
+    loadMetrics();
+    loadA11yLatency();
+    validateEndpoint();
+}
+
+void SettingsDialog::loadMetrics()
+{
+    if (!m_metricsTable)
+        return;
+    const auto rows = m_metrics->rows();
+    m_metricsTable->setRowCount(rows.size());
+    auto ms = [](qint64 v) { return v < 0 ? QStringLiteral("–") : i18n("%1 ms", v); };
+    for (int r = 0; r < rows.size(); ++r) {
+        const auto &[key, t] = rows[r];
+        const QStringList cells{
+                key.endpoint, key.model, key.action,
+                QString::number(t.requests),
+                QString::number(t.promptTokens),
+                QString::number(t.completionTokens),
+                ms(t.avgMs()),
+                ms(t.avgTtftMs()),
+                t.decodeTokensPerSec() > 0 ? QString::number(t.decodeTokensPerSec(), 'f', 1)
+                                           : QStringLiteral("–"),
+                t.acceptedPredictionRatio() >= 0 ? i18n("%1%", qRound(t.acceptedPredictionRatio() * 100))
+                                                 : QStringLiteral("–"),
+                t.predictionSpeedup() > 0 ? i18nc("speed-up factor", "%1×", QString::number(t.predictionSpeedup(), 'f', 2))
+                                          : QStringLiteral("–")};
+        for (int c = 0; c < cells.size(); ++c) {
+            auto *item = new QTableWidgetItem(cells[c]);
+            if (c >= 3)
+                item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            m_metricsTable->setItem(r, c, item);
+        }
+    }
+}
+
+void SettingsDialog::loadA11yLatency()
+{
+    if (!m_a11yTable)
+        return;
+    const auto rows = m_a11yLatency->rows();
+    m_a11yTable->setRowCount(rows.size());
+    for (int r = 0; r < rows.size(); ++r) {
+        const auto &a = rows[r];
+        const QStringList cells{
+                a.name,
+                QString::number(a.calls),
+                QString::number(a.timeouts),
+                i18n("%1 ms", a.avgMs()),
+                i18n("%1 ms", a.maxMs),
+                m_a11yLatency->isSlow(a.name) ? i18n("Clipboard (slow)") : i18n("AT-SPI"),
+                m_a11yLatency->preferPaste(a.name, 10 * AccessibilityLatency::kPasteMinChars)
+                        ? i18n("Paste") : i18n("Insert")};
+        for (int c = 0; c < cells.size(); ++c) {
+            auto *item = new QTableWidgetItem(cells[c]);
+            if (c >= 1 && c <= 4)
+                item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            m_a11yTable->setItem(r, c, item);
+        }
+    }
+}
+
+void SettingsDialog::loadGeneral()
+{
     m_apiKey ->setPassword(m_cfg->apiKey());
     m_endpoint->setText(m_cfg->apiEndpoint());
     m_model   ->setText(m_cfg->model());
     m_systemPrompt->setPlainText(m_cfg->systemPrompt());
     m_notificationsCb->setChecked(m_cfg->notificationsEnabled());
+    m_backend->setCurrentIndex(m_backend->findData(int(m_cfg->backend())));
+    m_localModel->setText(m_cfg->localModelPath());
+    m_localThreads->setValue(m_cfg->localThreads());
+    m_warmUpCb->setChecked(m_cfg->warmUpEnabled());
+    m_keepAlive->setValue(m_cfg->keepAliveMinutes());
+    m_precompute->setValue(m_cfg->precomputePerHour());
+    updateBackendFields();
+}
 
-    loadActions();
-    validateEndpoint();
+void SettingsDialog::updateBackendFields()
+{
+    const bool local = m_backend->currentData().toInt() == int(ConfigManager::Backend::Llama);
+    m_apiKey->setEnabled(!local);
+    m_endpoint->setEnabled(!local);
+    m_model->setEnabled(!local);
+    m_localModel->setEnabled(local);
+    m_localModelBtn->setEnabled(local);
+    m_localThreads->setEnabled(local);
+}
+
+void SettingsDialog::browseModelFile()
+{
+    const QString path = QFileDialog::getOpenFileName(this, i18n("Select model"),
+                                                      m_localModel->text(),
+                                                      i18n("GGUF models (*.gguf)"));
+    if (!path.isEmpty())
+        m_localModel->setText(path);
 }
 
 void SettingsDialog::validateEndpoint()
@@ -226,28 +419,40 @@ void SettingsDialog::moveDown()
 
 void SettingsDialog::testApiKey()
 {
-    if (m_apiKey->password().trimmed().isEmpty()) {
-        QMessageBox::warning(this, i18n("Missing key"),
-                             i18n("Enter an API key first."));
-        return;
+    const bool local = m_backend->currentData().toInt() == int(ConfigManager::Backend::Llama);
+    TextBackend *client = nullptr;
+    if (local) {
+        client = new LlamaClient(m_localModel->text().trimmed(),
+                                 m_systemPrompt->toPlainText().trimmed(),
+                                 m_localThreads->value(),
+                                 m_cfg->localContextSize(),
+                                 this);
+    } else {
+        if (m_apiKey->password().trimmed().isEmpty()) {
+            QMessageBox::warning(this, i18n("Missing key"),
+                                 i18n("Enter an API key first."));
+            return;
+        }
+        client = new ApiClient(m_apiKey->password().trimmed(),
+                               m_endpoint->text().trimmed(),
+                               m_model->text().trimmed(),
+                               m_systemPrompt->toPlainText().trimmed(),
+                               this);
     }
-    auto apiClient = new ApiClient(m_apiKey->password().trimmed(),
-                                   m_endpoint->text().trimmed(),
-                                   m_model->text().trimmed(),
-                                   m_systemPrompt->toPlainText().trimmed(),
-                                   this);
-    connect(apiClient, &ApiClient::processingFinished,
-            this, [this](const QString &resultText) {
+    connect(client, &TextBackend::processingFinished,
+            this, [this, client](quint64, const QString &resultText) {
+                client->deleteLater();
                 QMessageBox::information(this, i18n("Test result"),
                                          i18n("API key is valid. Result:\n%1", resultText));
             });
-    connect(apiClient, &ApiClient::processingError,
-            this, [this](const QString &errorMsg) {
+    connect(client, &TextBackend::processingError,
+            this, [this, client](quint64, const QString &errorMsg) {
+                client->deleteLater();
                 QMessageBox::warning(this, i18n("Test result"),
                                      i18n("API key is invalid.\n%1", errorMsg));
             });
-    apiClient->processText(QStringLiteral("Hello world!"),
-                           QStringLiteral("Translate to Russian:"));
+    client->processText(QStringLiteral("Hello world!"),
+                        QStringLiteral("Translate to Russian:"));
 }
 
 void SettingsDialog::store()
@@ -260,6 +465,12 @@ void SettingsDialog::store()
     m_cfg->setModel(m_model->text().trimmed());
     m_cfg->setSystemPrompt(m_systemPrompt->toPlainText().trimmed());
     m_cfg->setNotificationsEnabled(m_notificationsCb->isChecked());
+    m_cfg->setBackend(ConfigManager::Backend(m_backend->currentData().toInt()));
+    m_cfg->setLocalModelPath(m_localModel->text().trimmed());
+    m_cfg->setLocalThreads(m_localThreads->value());
+    m_cfg->setWarmUpEnabled(m_warmUpCb->isChecked());
+    m_cfg->setKeepAliveMinutes(m_keepAlive->value());
+    m_cfg->setPrecomputePerHour(m_precompute->value());
     m_cfg->sync();
     accept();
 }
@@ -267,10 +478,6 @@ void SettingsDialog::store()
 void SettingsDialog::cancel()
 {
     m_cfg->load();
-    m_apiKey->setPassword(m_cfg->apiKey());
-    m_endpoint->setText(m_cfg->apiEndpoint());
-    m_model->setText(m_cfg->model());
-    m_systemPrompt->setPlainText(m_cfg->systemPrompt());
-    m_notificationsCb->setChecked(m_cfg->notificationsEnabled());
+    loadGeneral();
     reject();
 }
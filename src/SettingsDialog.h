@@ -7,16 +7,23 @@
 #include <QTextEdit>
 #include <QCheckBox>
 
+class QComboBox;
 class QListWidget;
 class QLineEdit;
+class QSpinBox;
 class QTabWidget;
 class QLabel;
+class QTableWidget;
+class MetricsStore;
+class AccessibilityLatency;
 
 class SettingsDialog : public QDialog
 {
 Q_OBJECT
 public:
-    SettingsDialog(QWidget *parent, ConfigManager *cfg);
+    // `metrics` and `a11yLatency` (optional) fill the Statistics tab.
+    SettingsDialog(QWidget *parent, ConfigManager *cfg, MetricsStore *metrics = nullptr,
+                   const AccessibilityLatency *a11yLatency = nullptr);
 
 private Q_SLOTS:
     void addAction();
@@ -27,14 +34,21 @@ private Q_SLOTS:
 
     void testApiKey();
     void validateEndpoint();
+    void updateBackendFields();
+    void browseModelFile();
     void store();
     void cancel();
 
 private:
     void loadActions();
     void updateButtons();
+    void loadGeneral();
+    void loadMetrics();
+    void loadA11yLatency();
 
     ConfigManager *m_cfg;
+    MetricsStore  *m_metrics;
+    const AccessibilityLatency *m_a11yLatency;
     QTabWidget *m_tabs;
 
     /* General tab */
@@ -44,6 +58,13 @@ private:
     QLabel            *m_endpointWarn;
     QTextEdit         *m_systemPrompt;
     QCheckBox         *m_notificationsCb;
+    QComboBox         *m_backend;
+    QLineEdit         *m_localModel;
+    QPushButton       *m_localModelBtn;
+    QSpinBox          *m_localThreads;
+    QCheckBox         *m_warmUpCb;
+    QSpinBox          *m_keepAlive;
+    QSpinBox          *m_precompute;
 
     /* Actions tab */
     QListWidget *m_list;
@@ -54,4 +75,8 @@ private:
     QPushButton *m_removeBtn;
     QPushButton *m_upBtn;
     QPushButton *m_downBtn;
+
+    /* Statistics tab */
+    QTableWidget *m_metricsTable{nullptr};
+    QTableWidget *m_a11yTable{nullptr};
 };
@@ -0,0 +1,132 @@
+#include "SpellFastPath.h"
+
+#include <QDebug>
+#include <QTextBoundaryFinder>
+#include <QVector>
+
+#include <algorithm>
+
+#ifdef HAVE_SONNET
+#include <Sonnet/Speller>
+#endif
+
+namespace {
+
+// Optimal string alignment distance (Damerau–Levenshtein without
+// repeated edits of a substring); words here are short.
+int editDistance(const QString& a, const QString& b)
+{
+    const int n = int(a.size()), m = int(b.size());
+    QVector<QVector<int>> d(n + 1, QVector<int>(m + 1));
+    for (int i = 0; i <= n; ++i) d[i][0] = i;
+    for (int j = 0; j <= m; ++j) d[0][j] = j;
+    for (int i = 1; i <= n; ++i) {
+        for (int j = 1; j <= m; ++j) {
+            const int cost = a[i - 1] == b[j - 1] ? 0 : 1;
+            d[i][j] = std::min({d[i - 1][j] + 1, d[i][j - 1] + 1, d[i - 1][j - 1] + cost});
+            if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1])
+                d[i][j] = std::min(d[i][j], d[i - 2][j - 2] + 1);
+        }
+    }
+    return d[n][m];
+}
+
+// Acronyms, identifiers, words with digits: not ours to touch.
+bool isPlainWord(const QString& w)
+{
+    if (w.isEmpty() || !w.front().isLetter())
+        return false;
+    for (qsizetype i = 0; i < w.size(); ++i) {
+        const QChar c = w[i];
+        if (c.isUpper()) {
+            if (i > 0) return false;
+        } else if (!c.isLetter() && c != QLatin1Char('\'') && c != QChar(0x2019)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QString matchCase(const QString& original, QString replacement)
+{
+    if (!original.isEmpty() && original.front().isUpper() && !replacement.isEmpty())
+        replacement[0] = replacement.front().toUpper();
+    return replacement;
+}
+
+} // namespace
+
+SpellFastPath::SpellFastPath() = default;
+SpellFastPath::~SpellFastPath() = default;
+
+bool SpellFastPath::isAvailable()
+{
+#ifdef HAVE_SONNET
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::optional<QString> SpellFastPath::tryCorrect(const QString& text)
+{
+#ifdef HAVE_SONNET
+    if (text.size() > kMaxChars || text.trimmed().isEmpty())
+        return std::nullopt;
+    if (!m_speller) {
+        m_speller = std::make_unique<Sonnet::Speller>();    // default language
+        if (!m_speller->isValid())
+            qWarning() << "SpellFastPath: no dictionary for" << m_speller->language();
+    }
+    if (!m_speller->isValid())
+        return std::nullopt;
+
+    struct Fix { qsizetype pos; qsizetype len; QString word; };
+    QVector<Fix> fixes;
+    int words = 0;
+
+    QTextBoundaryFinder bf(QTextBoundaryFinder::Word, text);
+    qsizetype start = 0;
+    while (bf.toNextBoundary() >= 0) {
+        const qsizetype end = bf.position();
+        if (bf.boundaryReasons() & QTextBoundaryFinder::EndOfItem) {
+            const QString word = text.mid(start, end - start);
+            if (word.front().isLetter())
+                ++words;
+            if (isPlainWord(word) && m_speller->isMisspelled(word)) {
+                const QStringList suggestions = m_speller->suggest(word);
+                if (suggestions.isEmpty())
+                    return std::nullopt;
+                // hunspell orders by likelihood; take the first one only when
+                // it is a single edit away, or clearly the best of longer ones.
+                const QString best = suggestions.first();
+                const int dist = editDistance(word.toLower(), best.toLower());
+                bool confident = dist == 1;
+                if (dist == 2 && word.size() >= 6) {
+                    confident = std::none_of(suggestions.cbegin() + 1, suggestions.cend(),
+                                             [&](const QString& s) {
+                                                 return editDistance(word.toLower(), s.toLower()) <= 2;
+                                             });
+                }
+                if (!confident || best.contains(QLatin1Char(' ')))
+                    return std::nullopt;            // split words and guesses go to the model
+                fixes.append({start, end - start, matchCase(word, best)});
+            }
+        }
+        start = end;
+    }
+
+    // Nothing found: the problem is not spelling. Too many: likely another
+    // language than the dictionary.
+    if (fixes.isEmpty() || fixes.size() > qMax(2, words / 4))
+        return std::nullopt;
+
+    QString out = text;
+    for (auto it = fixes.crbegin(); it != fixes.crend(); ++it)
+        out.replace(it->pos, it->len, it->word);
+    return out;
+#else
+    Q_UNUSED(text);
+    return std::nullopt;
+#endif
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <QString>
+#include <memory>
+#include <optional>
+
+namespace Sonnet { class Speller; }
+
+/**
+ *  Local pre-pass for mechanical corrections (Sonnet, usually hunspell).
+ *  `tryCorrect` returns the corrected text when every misspelling it finds
+ *  has a confident replacement; otherwise, or when nothing was found, it
+ *  returns nothing and the request goes to the model.
+ *  The checker only sees spelling, not grammar or punctuation, so its
+ *  result is a complete answer only for spelling-only actions
+ *  (CustomAction::localSpellCheck).
+ */
+class SpellFastPath
+{
+public:
+    SpellFastPath();
+    ~SpellFastPath();
+
+    static bool isAvailable();
+
+    std::optional<QString> tryCorrect(const QString& text);
+
+    // Longer selections rarely contain only typos; they always escalate.
+    static constexpr int kMaxChars = 400;
+
+private:
+#ifdef HAVE_SONNET
+    std::unique_ptr<Sonnet::Speller> m_speller;     // loaded on first use
+#endif
+};
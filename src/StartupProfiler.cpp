@@ -0,0 +1,56 @@
+#include "StartupProfiler.h"
+
+#include <QByteArray>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+
+#include <unistd.h>
+
+namespace {
+
+QElapsedTimer sinceStart;
+qint64 lastMarkMs = 0;
+bool   finished = false;
+
+// Resident set size in KiB from /proc/self/statm (second field, in pages).
+qint64 residentKiB()
+{
+    QFile f(QStringLiteral("/proc/self/statm"));
+    if (!f.open(QIODevice::ReadOnly))
+        return -1;
+    const QList<QByteArray> fields = f.readAll().split(' ');
+    if (fields.size() < 2)
+        return -1;
+    return fields[1].toLongLong() * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+} // namespace
+
+namespace StartupProfiler {
+
+void start()
+{
+    sinceStart.start();
+    lastMarkMs = 0;
+    finished = false;
+}
+
+void mark(const char* phase)
+{
+    if (finished || !sinceStart.isValid())
+        return;
+    const qint64 now = sinceStart.elapsed();
+    qInfo().nospace() << "startup: " << phase
+                      << " +" << (now - lastMarkMs) << " ms (t=" << now << " ms"
+                      << ", RSS " << residentKiB() / 1024 << " MiB)";
+    lastMarkMs = now;
+}
+
+void finish(const char* phase)
+{
+    mark(phase);
+    finished = true;
+}
+
+} // namespace StartupProfiler
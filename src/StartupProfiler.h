@@ -0,0 +1,13 @@
+#pragma once
+
+/**
+ *  Замер фаз запуска: время от старта процесса и RSS после каждой фазы.
+ *  Output goes to the log as "startup: <phase> ..." lines.
+ */
+namespace StartupProfiler {
+
+void start();                       // call first thing in main()
+void mark(const char* phase);       // no-op once startup has finished
+void finish(const char* phase);     // last mark, disables further ones
+
+} // namespace StartupProfiler
@@ -0,0 +1,121 @@
+#pragma once
+#include <QObject>
+#include <QString>
+
+// Per-request generation settings; empty values keep the backend's own.
+struct RequestOptions {
+    // Scheduling class, most urgent first (see RequestScheduler).
+    enum class Priority { Interactive, Bulk, Speculative, Background };
+    Priority priority = Priority::Interactive;
+
+    QString model;                  // model name of an HTTP backend
+    double  temperature = -1;       // < 0: server default
+    int     maxTokens = 0;          // 0: no limit
+    QString reasoningEffort;        // "low", "medium", "high" or empty
+    QString label;                  // action name, for accounting
+    bool    predictInput = false;   // the input text is the predicted output
+};
+
+// Usage and timing of one successful request (see MetricsStore).
+struct RequestMetrics {
+    QString endpoint;               // URL, or the model file of a local backend
+    QString model;
+    QString label;                  // RequestOptions::label
+    int     promptTokens = -1;      // -1: not reported
+    int     completionTokens = -1;
+    qint64  ttftMs = -1;            // time to first token; -1: not streamed
+    qint64  totalMs = 0;
+    bool    predicted = false;      // sent with a predicted output
+    int     acceptedPredictionTokens = -1;  // -1: not reported
+    int     rejectedPredictionTokens = -1;
+
+    // Generation speed after the first token.
+    double decodeTokensPerSec() const
+    {
+        if (completionTokens < 2 || ttftMs < 0 || totalMs <= ttftMs)
+            return 0;
+        return (completionTokens - 1) * 1000.0 / double(totalMs - ttftMs);
+    }
+};
+
+/**
+ *  Common interface of the text generation backends
+ *  (ApiClient over HTTP, LlamaClient in-process).
+ *  Every request gets a non-zero id which is carried back by the signals,
+ *  so several requests can be in flight on the same backend.
+ */
+class TextBackend : public QObject
+{
+Q_OBJECT
+public:
+    explicit TextBackend(QObject* parent = nullptr) : QObject(parent) {}
+    ~TextBackend() override = default;
+
+    virtual quint64 processText(const QString& text, const QString& userPrompt,
+                                const RequestOptions& options = {}) = 0;
+
+    // Makes the backend load the model (and cache the system prompt) without
+    // doing real work. Finishes with an empty result.
+    virtual quint64 warmUp() = 0;
+
+    // Settings that do not need a new connection. Requests already sent keep
+    // the values they were started with.
+    virtual void setGenerationSettings(const QString& model, const QString& systemPrompt) = 0;
+
+    // Stops a request in flight; it still ends, with processingError.
+    // Best effort: a request that is about to finish may finish normally.
+    virtual void cancel(quint64 requestId) { Q_UNUSED(requestId); }
+
+    int requestsInFlight() const { return m_inFlight; }
+
+Q_SIGNALS:
+    void partialResult     (quint64 requestId, const QString& delta);
+    void processingFinished(quint64 requestId, const QString& resultText);
+    void processingError   (quint64 requestId, const QString& errorMsg);
+    // Sent right before processingFinished (not for warm-ups).
+    void requestMetrics    (quint64 requestId, const RequestMetrics& metrics);
+    void idle();                    // the last request in flight has ended
+
+protected:
+    // Ids are unique across all backends, so results of a retired backend
+    // cannot be mistaken for those of its replacement. GUI thread only.
+    quint64 startRequest()
+    {
+        ++m_inFlight;
+        return ++s_lastRequestId;
+    }
+
+    // Every started request ends with exactly one of these two.
+    void finishRequest(quint64 requestId, const QString& resultText)
+    {
+        Q_EMIT processingFinished(requestId, resultText);
+        endRequest();
+    }
+    void failRequest(quint64 requestId, const QString& errorMsg)
+    {
+        Q_EMIT processingError(requestId, errorMsg);
+        endRequest();
+    }
+
+    static QString userMessage(const QString& text, const QString& userPrompt)
+    {
+        return userPrompt + QStringLiteral("\n\n") + text;
+    }
+
+    static QString defaultSystemPrompt()    // keeps the old literal
+    {
+        return QStringLiteral("You are an AI text editor. "
+                              "Strictly follow the instructions. "
+                              "Return ONLY the modified text—no explanations, pre-/post-amble.");
+    }
+
+private:
+    void endRequest()
+    {
+        if (--m_inFlight == 0)
+            Q_EMIT idle();
+    }
+
+    static inline quint64 s_lastRequestId = 0;
+    int m_inFlight = 0;
+};
@@ -3,6 +3,8 @@
 #include <QMenu>
 #include <QKeySequence>
 #include <QIcon>
+#include <QMessageBox>
+#include <QTimer>
 
 #include <KAboutData>
 #include <KLocalizedString>
@@ -12,10 +14,13 @@
 #include "ConfigManager.h"
 #include "BackgroundProcessor.h"
 #include "SettingsDialog.h"
+#include "StartupProfiler.h"
 
 int main(int argc, char* argv[])
 {
+    StartupProfiler::start();
     QApplication app(argc, argv);
+    StartupProfiler::mark("QApplication");
     KLocalizedString::setApplicationDomain("knowbridge");
     app.setQuitOnLastWindowClosed(false);
     app.setApplicationName(QStringLiteral("knowbridge"));
@@ -30,21 +35,54 @@ int main(int argc, char* argv[])
     KAboutData::setApplicationData(about);
 
     ConfigManager cfg;
-    BackgroundProcessor proc(&cfg);
+    StartupProfiler::mark("config");
 
     /* --- Tray icon ------------------------------------------------------ */
+    // Shown before anything else is built: time-to-tray is what users notice.
     QSystemTrayIcon tray(QIcon::fromTheme(QStringLiteral("accessories-text-editor")));
     QMenu trayMenu;
+    QAction* actUndo     = trayMenu.addAction(i18n("Undo Last Edit"));
+    QMenu*   reapplyMenu = trayMenu.addMenu(i18n("Re-apply Result"));
+    trayMenu.addSeparator();
     QAction* actSettings = trayMenu.addAction(i18n("Settings…"));
+    QAction* actStats    = trayMenu.addAction(i18n("Statistics…"));
     trayMenu.addSeparator();
     QAction* actQuit     = trayMenu.addAction(i18n("Quit"));
     tray.setContextMenu(&trayMenu);
     tray.show();
+    StartupProfiler::mark("tray");
+
+    // AT-SPI, the backend and the action menu come up later (see initialize()).
+    BackgroundProcessor proc(&cfg);
 
     QObject::connect(actSettings, &QAction::triggered, [&]{
-        auto* dlg = new SettingsDialog(nullptr, &cfg);
+        auto* dlg = new SettingsDialog(nullptr, &cfg, &proc.metrics(),
+                                      &proc.accessibilityLatency());
+        dlg->setAttribute(Qt::WA_DeleteOnClose);
         dlg->show();
     });
+    QObject::connect(actUndo, &QAction::triggered,
+                     &proc, &BackgroundProcessor::undoLastEdit);
+    // Recent journal entries, newest first; built when the menu opens.
+    QObject::connect(reapplyMenu, &QMenu::aboutToShow, [&]{
+        reapplyMenu->clear();
+        const EditJournal& journal = proc.journal();
+        for (int i = journal.size() - 1; i >= 0 && i >= journal.size() - 10; --i) {
+            const auto e = journal.entry(i);
+            if (!e)
+                continue;
+            QString preview = e->original.simplified();
+            if (preview.size() > 40)
+                preview = preview.left(40) + QStringLiteral("…");
+            QAction* a = reapplyMenu->addAction(i18nc("action: text", "%1: %2", e->action, preview));
+            QObject::connect(a, &QAction::triggered, &proc, [&proc, i]{ proc.reapplyEntry(i); });
+        }
+        if (reapplyMenu->isEmpty())
+            reapplyMenu->addAction(i18n("No edits yet"))->setEnabled(false);
+    });
+    QObject::connect(actStats, &QAction::triggered, [&]{
+        QMessageBox::information(nullptr, i18n("Statistics"), proc.statsSummary());
+    });
     QObject::connect(actQuit, &QAction::triggered,
                      &app, &QApplication::quit);
 
@@ -58,5 +96,21 @@ int main(int argc, char* argv[])
     KGlobalAccel::self()->setShortcut(act,
                                       { QKeySequence(Qt::CTRL | Qt::ALT | Qt::Key_Space) });
 
+    QAction* undo = ac.addAction(QStringLiteral("undo_last_edit"));
+    undo->setText(i18n("Undo Last Knowbridge Edit"));
+    QObject::connect(undo, &QAction::triggered,
+                     &proc, &BackgroundProcessor::undoLastEdit);
+    KGlobalAccel::self()->setShortcut(undo,
+                                      { QKeySequence(Qt::CTRL | Qt::ALT | Qt::Key_Z) });
+
+    QAction* reapply = ac.addAction(QStringLiteral("reapply_result"));
+    reapply->setText(i18n("Re-apply Knowbridge Result to Selection"));
+    QObject::connect(reapply, &QAction::triggered,
+                     &proc, &BackgroundProcessor::reapplyForSelection);
+    KGlobalAccel::self()->setShortcut(reapply,
+                                      { QKeySequence(Qt::CTRL | Qt::ALT | Qt::Key_R) });
+    StartupProfiler::mark("global shortcut");
+    QTimer::singleShot(0, &app, []{ StartupProfiler::mark("event loop running"); });
+
     return app.exec();
 }